@@ -0,0 +1,267 @@
+#include "AssetLoader.h"
+#include "model.h"
+#include "GLState.h"
+
+#include <stdio.h>
+#include <iostream>
+
+#include <SOIL.h>
+
+typedef chrono::steady_clock LoadClock;
+
+AssetLoader::AssetLoader(unsigned int numThreads)
+	: nextTicket(1), outstanding(0)
+{
+	if (numThreads == 0)
+		numThreads = 1;
+
+	for (unsigned int i = 0; i < numThreads; ++i)
+		workers.push_back(std::thread(&AssetLoader::workerLoop, this, i));
+}
+
+AssetLoader::~AssetLoader()
+{
+	workAvailable.shutdown();
+	for (size_t i = 0; i < workers.size(); ++i)
+		workers[i].join();
+
+	// the workers are gone, so nothing else touches the queues now
+	for (size_t i = 0; i < pending.size(); ++i)
+		release(pending[i]);
+	for (size_t i = 0; i < ready.size(); ++i)
+		release(ready[i]);
+	pending.clear();
+	ready.clear();
+}
+
+unsigned AssetLoader::loadModel(Model* model, const string& path)
+{
+	Request* request = new Request();
+	request->type = REQUEST_MODEL;
+	request->path = path;
+	request->failed = false;
+	request->model = model;
+	request->meshCount = 0;
+	request->texture = 0;
+	request->flags = 0;
+	request->compressed = false;
+	request->pixels = NULL;
+	request->width = request->height = 0;
+
+	OVR::Mutex::Locker locker(&lock);
+	request->ticket = nextTicket++;
+	pending.push_back(request);
+	outstanding++;
+	workAvailable.post();
+	return request->ticket;
+}
+
+GLuint AssetLoader::loadTexture(const string& path, unsigned flags)
+{
+	// the name is handed out now, a single grey texel stands in until the image is decoded
+	const unsigned char grey[4] = { 128, 128, 128, 255 };
+	GLuint texture = TextureCache::createTexture(flags | TEXTURE_NO_MIPMAPS);
+	TextureCache::uploadImage(texture, grey, 1, 1, flags | TEXTURE_NO_MIPMAPS);
+	// the real image brings its own mip chain
+	if (!(flags & TEXTURE_NO_MIPMAPS))
+	{
+		GLState::bindTexture(0, GL_TEXTURE_2D, texture);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		GLState::bindTexture(0, GL_TEXTURE_2D, 0);
+	}
+
+	Request* request = new Request();
+	request->type = REQUEST_TEXTURE;
+	request->path = path;
+	request->failed = false;
+	request->model = NULL;
+	request->meshCount = 0;
+	request->texture = texture;
+	request->flags = flags;
+	// GL has to be asked here, the workers don't have a context
+	request->compressed = DDSCache::isSupported();
+	request->pixels = NULL;
+	request->width = request->height = 0;
+
+	OVR::Mutex::Locker locker(&lock);
+	request->ticket = nextTicket++;
+	pending.push_back(request);
+	outstanding++;
+	workAvailable.post();
+	return texture;
+}
+
+void AssetLoader::cancel(unsigned ticket)
+{
+	OVR::Mutex::Locker locker(&lock);
+
+	deque<Request*>* queues[] = { &pending, &ready };
+	for (int q = 0; q < 2; ++q)
+	{
+		for (size_t i = 0; i < queues[q]->size(); ++i)
+		{
+			Request* request = (*queues[q])[i];
+			if (request->ticket == ticket)
+			{
+				queues[q]->erase(queues[q]->begin() + i);
+				if (q == 0)
+					workAvailable.take();
+				release(request);
+				outstanding--;
+				return;
+			}
+		}
+	}
+
+	// not queued anywhere, so a worker has it right now
+	cancelled.insert(ticket);
+}
+
+void AssetLoader::processUploads(double budgetMs)
+{
+	LoadClock::time_point start = LoadClock::now();
+	for (;;)
+	{
+		// only the render thread takes from ready, so the front stays ours after unlocking
+		Request* request;
+		{
+			OVR::Mutex::Locker locker(&lock);
+			if (ready.empty())
+				return;
+			request = ready.front();
+		}
+
+		if (!upload(request, budgetMs, start))
+			return;
+
+		{
+			OVR::Mutex::Locker locker(&lock);
+			ready.pop_front();
+			outstanding--;
+		}
+		release(request);
+
+		if (chrono::duration<double, std::milli>(LoadClock::now() - start).count() >= budgetMs)
+			return;
+	}
+}
+
+void AssetLoader::finish()
+{
+	while (outstanding.load() > 0)
+	{
+		processUploads(1e9);
+		if (outstanding.load() > 0)
+			std::this_thread::sleep_for(chrono::milliseconds(1));
+	}
+}
+
+void AssetLoader::workerLoop(unsigned int index)
+{
+	char name[32];
+	snprintf(name, sizeof(name), "AssetLoader%u", index);
+	OVR::Thread::SetCurrentThreadName(name);
+
+	while (workAvailable.wait())
+	{
+		Request* request = popPending();
+		// another worker got to it first
+		if (!request)
+			continue;
+
+		read(request);
+
+		OVR::Mutex::Locker locker(&lock);
+		if (cancelled.erase(request->ticket))
+		{
+			release(request);
+			outstanding--;
+		}
+		else
+		{
+			ready.push_back(request);
+		}
+	}
+}
+
+AssetLoader::Request* AssetLoader::popPending()
+{
+	OVR::Mutex::Locker locker(&lock);
+	if (pending.empty())
+		return NULL;
+
+	// oldest first, models are usually requested in the order they're needed
+	Request* request = pending.front();
+	pending.pop_front();
+	workAvailable.take();
+	return request;
+}
+
+void AssetLoader::read(Request* request)
+{
+	if (request->type == REQUEST_MODEL)
+	{
+		request->failed = !Model::readMeshes(request->path, request->cache, request->meshData, request->nodes);
+		request->meshCount = request->cache.isOpen() ? request->cache.getMeshCount() : (unsigned)request->meshData.size();
+	}
+	else if (request->compressed)
+	{
+		// cooks the texture right here on a miss, compressing takes a while
+		request->failed = !request->dds.load(request->path, request->flags);
+	}
+	else
+	{
+		int channels = request->flags & TEXTURE_ALPHA ? SOIL_LOAD_RGBA : SOIL_LOAD_RGB;
+		request->pixels = SOIL_load_image(request->path.c_str(), &request->width, &request->height, 0, channels);
+		request->failed = request->pixels == NULL;
+	}
+
+	if (request->failed)
+		cerr << "ERROR::ASSET_LOADER::Failed to load " << request->path << endl;
+}
+
+bool AssetLoader::upload(Request* request, double budgetMs, LoadClock::time_point start)
+{
+	if (request->type == REQUEST_MODEL)
+	{
+		// one mesh at a time, checking the budget in between. A model that failed to load
+		// just keeps drawing its placeholder.
+		while (!request->failed && request->meshes.size() < request->meshCount)
+		{
+			request->meshes.push_back(Model::createMesh(request->cache, request->meshData, (unsigned)request->meshes.size()));
+			if (request->meshes.size() < request->meshCount &&
+				chrono::duration<double, std::milli>(LoadClock::now() - start).count() >= budgetMs)
+				return false;
+		}
+
+		Model* model = request->model;
+		if (!request->failed)
+		{
+			model->meshes.swap(request->meshes);
+			model->buildTransforms(request->nodes);
+			model->resident = true;
+		}
+		model->loadTicket = 0;
+		return true;
+	}
+
+	// the owner may have deleted the texture while it was loading
+	size_t bytes = 0;
+	if (!request->failed && glIsTexture(request->texture))
+	{
+		if (request->compressed)
+			bytes = request->dds.upload(request->texture, request->flags);
+		else
+			bytes = TextureCache::uploadImage(request->texture, request->pixels, request->width, request->height, request->flags);
+	}
+	TextureCache::finishLoading(request->texture, bytes);
+	return true;
+}
+
+void AssetLoader::release(Request* request)
+{
+	if (request->pixels)
+		SOIL_free_image_data(request->pixels);
+	// closes the cooked file and deletes any meshes that were already uploaded
+	delete request;
+}
@@ -0,0 +1,106 @@
+#ifndef _ASSET_LOADER_H
+#define _ASSET_LOADER_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <set>
+#include <thread>
+#include <atomic>
+#include <chrono>
+
+#include <GL/glew.h>
+
+#include <Kernel/OVR_Threads.h>
+
+#include "mesh.h"
+#include "MeshCache.h"
+#include "TextureCache.h"
+#include "DDSCache.h"
+#include "WorkSignal.h"
+
+#define ASSET_LOADER_THREADS 2
+// how long the render thread may spend uploading finished assets each frame
+#define ASSET_UPLOAD_BUDGET_MS 2.0
+
+using namespace std;
+
+class Model;
+
+// Loads models and textures in the background. Worker threads do everything that doesn't
+// need GL (mapping cooked meshes, Assimp imports, decoding images) and queue the results.
+// The render thread then uploads them a bit at a time in processUploads().
+class AssetLoader
+{
+public:
+	AssetLoader(unsigned int numThreads = ASSET_LOADER_THREADS);
+	~AssetLoader();
+
+	// Queues a model to be read into model, which draws its placeholder until then.
+	// Returns the ticket to cancel it with.
+	unsigned loadModel(Model* model, const string& path);
+	// Returns a texture name right away. It holds a 1x1 placeholder until the image is uploaded.
+	// Use TextureCache::acquire() instead, so every image is only loaded once.
+	GLuint loadTexture(const string& path, unsigned flags = TEXTURE_DEFAULT);
+	// Drops a request wherever it is, its target never hears about it again
+	void cancel(unsigned ticket);
+
+	// Call once per frame on the render thread. Uploads finished assets until budgetMs is used up,
+	// but always at least one mesh or texture, so loading keeps moving on a slow frame.
+	void processUploads(double budgetMs);
+	// Uploads everything requested so far, blocking until the workers are done with it
+	void finish();
+
+	// requests that aren't resident yet
+	size_t getOutstandingCount() const { return outstanding.load(); }
+
+private:
+	enum RequestType
+	{
+		REQUEST_MODEL,
+		REQUEST_TEXTURE
+	};
+
+	struct Request
+	{
+		RequestType type;
+		unsigned ticket;
+		string path;
+		bool failed;
+
+		// filled in by a worker for models, either the mapped cooked copy or the imported meshes
+		Model* model;
+		MeshCache cache;
+		vector<MeshData> meshData;
+		vector<ModelNode> nodes;
+		unsigned meshCount;
+		vector<Mesh> meshes;	// uploaded so far
+
+		// textures, either the cooked DXT copy or the decoded image if GL can't take DXT
+		GLuint texture;
+		unsigned flags;
+		bool compressed;
+		DDSCache dds;
+		unsigned char* pixels;
+		int width, height;
+	};
+
+	void workerLoop(unsigned int index);
+	Request* popPending();
+	void read(Request* request);
+	// returns true once the request is completely uploaded
+	bool upload(Request* request, double budgetMs, chrono::steady_clock::time_point start);
+	void release(Request* request);
+
+	OVR::Mutex lock;
+	deque<Request*> pending;	// waiting for a worker
+	deque<Request*> ready;		// waiting for the render thread, the front one may be half uploaded
+	set<unsigned> cancelled;	// tickets a worker is busy with that should be dropped when it's done
+	unsigned nextTicket;
+	atomic<size_t> outstanding;
+
+	vector<std::thread> workers;
+	WorkSignal workAvailable;	// counts what's in pending, and changes with it under lock
+};
+
+#endif
@@ -0,0 +1,59 @@
+#include <stdlib.h>
+#include <new>
+#include <atomic>
+
+#include "Benchmark.h"
+
+// Replaces the global operator new and delete so the benchmarks can count heap allocations.
+// Everything in the benchmark goes through these, the standard containers included.
+static std::atomic<size_t> allocations(0);
+
+size_t getAllocationCount()
+{
+	return allocations.load();
+}
+
+void* operator new(size_t size)
+{
+	++allocations;
+	void* p = malloc(size ? size : 1);
+	if (!p)
+		throw std::bad_alloc();
+	return p;
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+	++allocations;
+	return malloc(size ? size : 1);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+	return operator new(size, std::nothrow);
+}
+
+void operator delete(void* p) noexcept
+{
+	free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+	free(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept
+{
+	free(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept
+{
+	free(p);
+}
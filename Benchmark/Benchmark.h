@@ -0,0 +1,33 @@
+#ifndef _BENCHMARK_H
+#define _BENCHMARK_H
+
+#include <chrono>
+#include <cstddef>
+
+// Wall clock stopwatch for the benchmarks
+class Stopwatch
+{
+public:
+	Stopwatch() { start = std::chrono::steady_clock::now(); }
+
+	double elapsedNs() const
+	{
+		return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+	}
+
+private:
+	std::chrono::steady_clock::time_point start;
+};
+
+// Heap allocations made through operator new since the program started
+size_t getAllocationCount();
+
+// Each benchmark prints its own results to stdout
+void benchMoleculeStore();
+void benchJobSystem();
+void benchSpatialHash();
+void benchMoleculePool();
+// takes the command line options after the benchmark name
+void benchSimulation(int argc, char** argv);
+
+#endif
@@ -0,0 +1,56 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+
+#include "Benchmark.h"
+#include "../MoleculeStore.h"
+#include "../JobSystem.h"
+
+#define BENCH_MOLECULES 100000
+#define BENCH_STEPS 100
+// the same chunk size Factory uses (MOLS_PER_UPDATE_JOB)
+#define BENCH_MIN_CHUNK 1024
+
+static float randRange(float lo, float hi)
+{
+	return lo + (hi - lo) * (rand() / (float)RAND_MAX);
+}
+
+// Parallel MoleculeStore::update over 1 to N threads, where N is the number of hardware threads
+void benchJobSystem()
+{
+	MoleculeStore store(BENCH_MOLECULES);
+	srand(1);
+	for (size_t i = 0; i < BENCH_MOLECULES; ++i)
+	{
+		glm::vec3 spinAxis(randRange(0.0f, 1.0f), randRange(0.0f, 1.0f), randRange(0.0f, 1.0f));
+		store.add(MOLECULE_CO2, glm::vec3(0.0f, -2.5f, 0.0f), randRange(0.05f, 0.5f), spinAxis, randRange(0.5f, 8.0f));
+	}
+
+	unsigned int maxThreads = std::thread::hardware_concurrency();
+	if (maxThreads == 0)
+		maxThreads = 1;
+
+	printf("Parallel molecule update, %d molecules, %d steps\n", BENCH_MOLECULES, BENCH_STEPS);
+	printf("%8s %14s %10s\n", "threads", "ms/step", "speedup");
+
+	double singleMs = 0.0;
+	for (unsigned int threads = 1; threads <= maxThreads; ++threads)
+	{
+		JobSystem jobs(threads);
+
+		Stopwatch timer;
+		for (int step = 0; step < BENCH_STEPS; ++step)
+		{
+			jobs.parallelFor(store.size(), BENCH_MIN_CHUNK, [&store](size_t begin, size_t end)
+			{
+				store.update(begin, end);
+			});
+		}
+		double ms = timer.elapsedNs() / 1e6 / BENCH_STEPS;
+
+		if (threads == 1)
+			singleMs = ms;
+		printf("%8u %14.3f %9.2fx\n", threads, ms, singleMs / ms);
+	}
+}
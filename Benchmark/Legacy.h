@@ -0,0 +1,69 @@
+#ifndef _LEGACY_H
+#define _LEGACY_H
+
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "../MoleculeStore.h"
+
+using namespace std;
+
+// three low poly atoms per molecule, enough vertex data per copy to scatter the molecules across the heap
+#define BENCH_MESHES_PER_MOLECULE 3
+#define BENCH_VERTICES_PER_MESH 32
+#define BENCH_INDICES_PER_MESH 60
+
+// The layout Factory used before MoleculeStore: one heap object per molecule, each with its
+// own copy of the molecule meshes (vertex and index data included) and a toWorld per mesh.
+namespace legacy
+{
+	struct Vertex
+	{
+		glm::vec3 position;
+		glm::vec3 normal;
+		glm::vec2 texCoords;
+	};
+
+	struct Mesh
+	{
+		vector<Vertex> vertices;
+		vector<unsigned int> indices;
+		glm::vec3 ambient, diffuse, specular;
+		float shininess;
+		glm::mat4 toWorld;
+	};
+
+	struct Molecule
+	{
+		vector<Mesh> meshes;
+		float velocity;
+		float spinX, spinY, spinZ, spinSpeed;
+
+		glm::vec3 calcCenterPoint()
+		{
+			glm::vec3 center = glm::vec3(0.0f);
+			for (size_t i = 0; i < meshes.size(); i++)
+			{
+				glm::vec4 pos = meshes[i].toWorld[3];
+				center += glm::vec3(pos.x, pos.y, pos.z);
+			}
+			return center / (float)meshes.size();
+		}
+
+		void update()
+		{
+			for (size_t i = 0; i < meshes.size(); i++)
+			{
+				meshes[i].toWorld = glm::translate(meshes[i].toWorld, glm::vec3(0.0f, velocity, 0.0f));
+				meshes[i].toWorld = meshes[i].toWorld * glm::rotate(glm::mat4(1.0f), spinSpeed / 180.0f * glm::pi<float>(), glm::vec3(spinX, spinY, spinZ));
+			}
+
+			if (glm::abs(glm::distance(glm::vec3(0.0f), calcCenterPoint())) > BOUNDS_DIST)
+				velocity = -velocity;
+		}
+	};
+}
+
+#endif
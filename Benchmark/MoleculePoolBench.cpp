@@ -0,0 +1,196 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+#include "Benchmark.h"
+#include "Legacy.h"
+#include "../MoleculeStore.h"
+#include "../SpatialHash.h"
+
+using namespace std;
+
+// the game's numbers, from Factory.h (which needs GL, so it isn't included here)
+#define GAME_MOLS_INIT 5
+#define GAME_TICKS_BTWN_EMIT 60
+#define GAME_MAX_MOLS 10
+#define GAME_MOLS_ON_LOSE 50
+#define GAME_CAPACITY (GAME_MAX_MOLS + 1 + GAME_MOLS_ON_LOSE)
+
+// a player turns a CO2 into O2 this often, and a molecule despawns and a new CO2 takes its place this often
+#define BENCH_TICKS_BTWN_CONVERT 30
+#define BENCH_TICKS_BTWN_REPLACE 45
+#define BENCH_TICKS_AFTER_LOSE 120
+#define BENCH_ROUNDS 20
+
+static float randRange(float lo, float hi)
+{
+	return lo + (hi - lo) * (rand() / (float)RAND_MAX);
+}
+
+// Plays the same rounds of the game with both layouts: emit until the player loses,
+// convert and replace molecules along the way, then restart
+struct GameScript
+{
+	int ticksPerRound() const { return (GAME_MAX_MOLS + 1 - GAME_MOLS_INIT) * GAME_TICKS_BTWN_EMIT + BENCH_TICKS_AFTER_LOSE; }
+	bool emitAt(int tick) const { return tick > 0 && tick % GAME_TICKS_BTWN_EMIT == 0 && tick <= (GAME_MAX_MOLS + 1 - GAME_MOLS_INIT) * GAME_TICKS_BTWN_EMIT; }
+	bool loseAt(int tick) const { return tick == (GAME_MAX_MOLS + 1 - GAME_MOLS_INIT) * GAME_TICKS_BTWN_EMIT; }
+	bool convertAt(int tick) const { return tick % BENCH_TICKS_BTWN_CONVERT == 0; }
+	bool replaceAt(int tick) const { return tick % BENCH_TICKS_BTWN_REPLACE == 0; }
+};
+
+struct PoolResult
+{
+	size_t ticks;
+	size_t allocations;
+	size_t steadyAllocations;	// after the first round
+};
+
+// new Molecule per spawn with its own copy of the meshes, delete everything on restart
+static PoolResult runLegacy()
+{
+	GameScript script;
+	legacy::Mesh co2Prototype, o2Prototype;
+	co2Prototype.vertices.resize(BENCH_VERTICES_PER_MESH);
+	co2Prototype.indices.resize(BENCH_INDICES_PER_MESH);
+	o2Prototype = co2Prototype;
+
+	vector<legacy::Molecule*> molecules;
+	vector<bool> isO2;
+	PoolResult result = { 0, 0, 0 };
+	size_t start = getAllocationCount(), afterFirstRound = 0;
+
+	for (int round = 0; round < BENCH_ROUNDS; ++round)
+	{
+		for (int i = 0; i < GAME_MOLS_INIT; ++i)
+		{
+			legacy::Molecule* mol = new legacy::Molecule();
+			mol->meshes.assign(BENCH_MESHES_PER_MOLECULE, co2Prototype);
+			mol->velocity = randRange(0.05f, 0.5f);
+			mol->spinSpeed = randRange(0.5f, 8.0f);
+			mol->spinX = mol->spinY = mol->spinZ = 0.5f;
+			molecules.push_back(mol);
+			isO2.push_back(false);
+		}
+
+		for (int tick = 1; tick <= script.ticksPerRound(); ++tick)
+		{
+			int emitted = script.emitAt(tick) ? 1 : 0;
+			if (script.loseAt(tick))
+				emitted += GAME_MOLS_ON_LOSE;
+			for (int i = 0; i < emitted; ++i)
+			{
+				legacy::Molecule* mol = new legacy::Molecule();
+				mol->meshes.assign(BENCH_MESHES_PER_MOLECULE, co2Prototype);
+				mol->velocity = randRange(0.05f, 0.5f);
+				mol->spinSpeed = randRange(0.5f, 8.0f);
+				mol->spinX = mol->spinY = mol->spinZ = 0.5f;
+				molecules.push_back(mol);
+				isO2.push_back(false);
+			}
+
+			// converting swaps in the O2 meshes
+			if (script.convertAt(tick))
+			{
+				size_t i = rand() % molecules.size();
+				molecules[i]->meshes.assign(BENCH_MESHES_PER_MOLECULE, o2Prototype);
+				isO2[i] = true;
+			}
+
+			if (script.replaceAt(tick))
+			{
+				size_t i = rand() % molecules.size();
+				delete molecules[i];
+				molecules[i] = new legacy::Molecule();
+				molecules[i]->meshes.assign(BENCH_MESHES_PER_MOLECULE, co2Prototype);
+				molecules[i]->velocity = randRange(0.05f, 0.5f);
+				molecules[i]->spinSpeed = randRange(0.5f, 8.0f);
+				molecules[i]->spinX = molecules[i]->spinY = molecules[i]->spinZ = 0.5f;
+				isO2[i] = false;
+			}
+
+			for (size_t i = 0; i < molecules.size(); ++i)
+				molecules[i]->update();
+			++result.ticks;
+		}
+
+		for (size_t i = 0; i < molecules.size(); ++i)
+			delete molecules[i];
+		molecules.clear();
+		isO2.clear();
+
+		if (round == 0)
+			afterFirstRound = getAllocationCount();
+	}
+
+	result.allocations = getAllocationCount() - start;
+	result.steadyAllocations = getAllocationCount() - afterFirstRound;
+	return result;
+}
+
+// the fixed capacity MoleculeStore, with the spatial hash and instance matrices Factory uses every tick
+static PoolResult runPool()
+{
+	GameScript script;
+	PoolResult result = { 0, 0, 0 };
+	size_t start = getAllocationCount(), afterFirstRound = 0;
+
+	MoleculeStore store(GAME_CAPACITY);
+	SpatialHash grid(COLLISION_CELL_SIZE);
+	vector<glm::mat4> toWorlds;
+
+	for (int round = 0; round < BENCH_ROUNDS; ++round)
+	{
+		for (int i = 0; i < GAME_MOLS_INIT; ++i)
+			store.add(MOLECULE_CO2, glm::vec3(0.0f, -2.5f, 0.0f), randRange(0.05f, 0.5f), glm::vec3(0.5f), randRange(0.5f, 8.0f));
+
+		for (int tick = 1; tick <= script.ticksPerRound(); ++tick)
+		{
+			int emitted = script.emitAt(tick) ? 1 : 0;
+			if (script.loseAt(tick))
+				emitted += GAME_MOLS_ON_LOSE;
+			for (int i = 0; i < emitted; ++i)
+				store.add(MOLECULE_CO2, glm::vec3(0.0f, -2.5f, 0.0f), randRange(0.05f, 0.5f), glm::vec3(0.5f), randRange(0.5f, 8.0f));
+
+			if (script.convertAt(tick))
+				store.types[rand() % store.size()] = MOLECULE_O2;
+
+			if (script.replaceAt(tick))
+			{
+				store.remove(store.getHandle(rand() % store.size()));
+				store.add(MOLECULE_CO2, glm::vec3(0.0f, -2.5f, 0.0f), randRange(0.05f, 0.5f), glm::vec3(0.5f), randRange(0.5f, 8.0f));
+			}
+
+			store.update();
+			grid.build(store.posX.data(), store.posY.data(), store.posZ.data(), store.size());
+			store.collide(grid);
+
+			toWorlds.clear();
+			for (size_t i = 0; i < store.size(); ++i)
+				toWorlds.push_back(store.getInterpolatedToWorld(i, 0.5f));
+			++result.ticks;
+		}
+
+		store.clear();
+
+		if (round == 0)
+			afterFirstRound = getAllocationCount();
+	}
+
+	result.allocations = getAllocationCount() - start;
+	result.steadyAllocations = getAllocationCount() - afterFirstRound;
+	return result;
+}
+
+// Heap allocations per simulated frame over whole rounds of the game, old layout against the pool
+void benchMoleculePool()
+{
+	srand(1);
+	PoolResult legacyResult = runLegacy();
+	srand(1);
+	PoolResult poolResult = runPool();
+
+	printf("Molecule lifetimes, %d rounds of %u ticks (spawn, convert, replace, lose, restart)\n", BENCH_ROUNDS, (unsigned)(legacyResult.ticks / BENCH_ROUNDS));
+	printf("%8s %14s %14s %22s\n", "layout", "allocations", "allocs/frame", "allocs after round 1");
+	printf("%8s %14u %14.2f %22u\n", "legacy", (unsigned)legacyResult.allocations, legacyResult.allocations / (double)legacyResult.ticks, (unsigned)legacyResult.steadyAllocations);
+	printf("%8s %14u %14.2f %22u\n", "pool", (unsigned)poolResult.allocations, poolResult.allocations / (double)poolResult.ticks, (unsigned)poolResult.steadyAllocations);
+}
@@ -0,0 +1,86 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "Benchmark.h"
+#include "../MoleculeStore.h"
+#include "Legacy.h"
+
+using namespace std;
+
+#define BENCH_STEPS 100
+
+static float randRange(float lo, float hi)
+{
+	return lo + (hi - lo) * (rand() / (float)RAND_MAX);
+}
+
+static double runLegacy(size_t count)
+{
+	legacy::Mesh prototype;
+	prototype.vertices.resize(BENCH_VERTICES_PER_MESH);
+	prototype.indices.resize(BENCH_INDICES_PER_MESH);
+	prototype.toWorld = glm::scale(glm::mat4(1.0f), glm::vec3(MOLECULE_SCALE));
+
+	vector<legacy::Molecule*> molecules;
+	for (size_t i = 0; i < count; ++i)
+	{
+		legacy::Molecule* mol = new legacy::Molecule();
+		mol->meshes.assign(BENCH_MESHES_PER_MOLECULE, prototype);
+		mol->velocity = randRange(0.05f, 0.5f);
+		mol->spinSpeed = randRange(0.5f, 8.0f);
+		mol->spinX = randRange(0.0f, 1.0f);
+		mol->spinY = randRange(0.0f, 1.0f);
+		mol->spinZ = randRange(0.0f, 1.0f);
+		molecules.push_back(mol);
+	}
+
+	Stopwatch timer;
+	for (int step = 0; step < BENCH_STEPS; ++step)
+	{
+		for (size_t i = 0; i < molecules.size(); ++i)
+			molecules[i]->update();
+	}
+	double ns = timer.elapsedNs();
+
+	for (size_t i = 0; i < molecules.size(); ++i)
+		delete molecules[i];
+
+	return ns / (double)(count * BENCH_STEPS);
+}
+
+static double runStore(size_t count)
+{
+	MoleculeStore store(count);
+	for (size_t i = 0; i < count; ++i)
+	{
+		glm::vec3 spinAxis(randRange(0.0f, 1.0f), randRange(0.0f, 1.0f), randRange(0.0f, 1.0f));
+		store.add(MOLECULE_CO2, glm::vec3(0.0f, -2.5f, 0.0f), randRange(0.05f, 0.5f), spinAxis, randRange(0.5f, 8.0f));
+	}
+
+	Stopwatch timer;
+	for (int step = 0; step < BENCH_STEPS; ++step)
+		store.update();
+	double ns = timer.elapsedNs();
+
+	return ns / (double)(count * BENCH_STEPS);
+}
+
+void benchMoleculeStore()
+{
+	const size_t counts[] = { 1000, 10000, 100000 };
+
+	printf("Molecule update cost, %d steps\n", BENCH_STEPS);
+	printf("%10s %18s %18s %9s\n", "molecules", "legacy ns/mol", "store ns/mol", "speedup");
+	for (size_t i = 0; i < sizeof(counts) / sizeof(counts[0]); ++i)
+	{
+		srand(1);
+		double legacyNs = runLegacy(counts[i]);
+		srand(1);
+		double storeNs = runStore(counts[i]);
+		printf("%10zu %18.2f %18.2f %8.1fx\n", counts[i], legacyNs, storeNs, legacyNs / storeNs);
+	}
+}
@@ -0,0 +1,216 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <iostream>
+#include <streambuf>
+#include <vector>
+#include <algorithm>
+
+#include "Benchmark.h"
+#include "../Simulation.h"
+
+using namespace std;
+
+#define DEFAULT_TICKS 100
+#define WARMUP_TICKS 5
+#define GAME_ROUNDS 5
+#define GAME_TICKS_AFTER_LOSE 120
+
+// swallows the game's console messages so they don't end up in the report
+class NullBuffer : public streambuf
+{
+protected:
+	int overflow(int c) { return c; }
+};
+
+struct SimulationOptions
+{
+	vector<size_t> counts;
+	int ticks;
+	unsigned int threads;
+	bool json;
+};
+
+struct SimulationResult
+{
+	size_t molecules;
+	double minNs, medianNs;		// per molecule per tick
+	double contactsPerTick;
+	size_t allocations;
+	size_t memoryBytes;
+};
+
+struct GameResult
+{
+	size_t ticks;
+	double nsPerTick;
+	size_t allocations;
+	size_t steadyAllocations;	// after the first round
+};
+
+static SimulationOptions parseOptions(int argc, char** argv)
+{
+	SimulationOptions options;
+	options.ticks = DEFAULT_TICKS;
+	options.threads = 1;
+	options.json = false;
+
+	for (int i = 0; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "--json") == 0)
+			options.json = true;
+		else if (strcmp(argv[i], "--ticks") == 0 && i + 1 < argc)
+			options.ticks = max(1, atoi(argv[++i]));
+		else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+			options.threads = (unsigned int)max(0, atoi(argv[++i]));
+		else if (strcmp(argv[i], "--molecules") == 0 && i + 1 < argc)
+		{
+			// comma separated list of counts
+			for (char* count = strtok(argv[++i], ","); count; count = strtok(NULL, ","))
+				options.counts.push_back((size_t)atol(count));
+		}
+		else
+			fprintf(stderr, "unknown simulation benchmark option %s\n", argv[i]);
+	}
+
+	if (options.counts.empty())
+	{
+		options.counts.push_back(1000);
+		options.counts.push_back(10000);
+		options.counts.push_back(100000);
+	}
+	return options;
+}
+
+// count molecules spread around the factory, stepped outside of the game rules
+static SimulationResult runSteps(JobSystem& jobs, size_t count, int ticks)
+{
+	Molecule::seedRandom(1);
+	Simulation sim(&jobs, count + NUM_MOL_INIT);
+	for (size_t i = 0; i < count; ++i)
+		sim.spawn().randomizePosition();
+
+	for (int tick = 0; tick < WARMUP_TICKS; ++tick)
+		sim.step();
+
+	SimulationResult result;
+	result.molecules = sim.getMolecules().size();
+	result.memoryBytes = sim.getMolecules().getMemoryUsage();
+
+	vector<double> tickNs;
+	tickNs.reserve(ticks);
+	size_t contacts = 0;
+	size_t allocationsBefore = getAllocationCount();
+	for (int tick = 0; tick < ticks; ++tick)
+	{
+		Stopwatch timer;
+		sim.step();
+		tickNs.push_back(timer.elapsedNs());
+		contacts += sim.getNumContacts();
+	}
+	result.allocations = getAllocationCount() - allocationsBefore;
+
+	sort(tickNs.begin(), tickNs.end());
+	result.minNs = tickNs.front() / result.molecules;
+	result.medianNs = tickNs[tickNs.size() / 2] / result.molecules;
+	result.contactsPerTick = contacts / (double)ticks;
+	return result;
+}
+
+// whole rounds of the actual game: emit until losing, keep going for a bit, restart
+static GameResult runGame(JobSystem& jobs)
+{
+	Molecule::seedRandom(1);
+	GameResult result = { 0, 0.0, 0, 0 };
+	size_t start = getAllocationCount(), afterFirstRound = 0;
+
+	Stopwatch timer;
+	Simulation sim(&jobs);
+	for (int round = 0; round < GAME_ROUNDS; ++round)
+	{
+		while (!sim.isLost())
+		{
+			sim.update();
+			++result.ticks;
+		}
+		for (int tick = 0; tick < GAME_TICKS_AFTER_LOSE; ++tick)
+		{
+			sim.step();
+			++result.ticks;
+		}
+		sim.restart();
+
+		if (round == 0)
+			afterFirstRound = getAllocationCount();
+	}
+	result.nsPerTick = timer.elapsedNs() / result.ticks;
+
+	result.allocations = getAllocationCount() - start;
+	result.steadyAllocations = getAllocationCount() - afterFirstRound;
+	return result;
+}
+
+static void printText(const SimulationOptions& options, const vector<SimulationResult>& results, const GameResult& game)
+{
+	printf("Headless simulation, %d ticks, %u threads\n", options.ticks, options.threads);
+	printf("%10s %14s %14s %12s %8s %10s %12s\n", "molecules", "min ns/mol", "median ns/mol", "contacts", "allocs", "bytes/mol", "state KB");
+	for (size_t i = 0; i < results.size(); ++i)
+	{
+		const SimulationResult& r = results[i];
+		printf("%10u %14.2f %14.2f %12.1f %8u %10.1f %12.1f\n", (unsigned)r.molecules, r.minNs, r.medianNs, r.contactsPerTick,
+			(unsigned)r.allocations, r.memoryBytes / (double)r.molecules, r.memoryBytes / 1024.0);
+	}
+	printf("update() streams %u bytes per molecule per tick\n", (unsigned)MoleculeStore::getUpdateBytesPerMolecule());
+	printf("Game rounds: %u ticks, %.0f ns/tick, %u allocations (%u after the first round)\n",
+		(unsigned)game.ticks, game.nsPerTick, (unsigned)game.allocations, (unsigned)game.steadyAllocations);
+}
+
+static void printJson(const SimulationOptions& options, const vector<SimulationResult>& results, const GameResult& game)
+{
+	printf("{\n");
+	printf("  \"benchmark\": \"simulation\",\n");
+	printf("  \"ticks\": %d,\n", options.ticks);
+	printf("  \"threads\": %u,\n", options.threads);
+	printf("  \"update_bytes_per_molecule\": %u,\n", (unsigned)MoleculeStore::getUpdateBytesPerMolecule());
+	printf("  \"runs\": [\n");
+	for (size_t i = 0; i < results.size(); ++i)
+	{
+		const SimulationResult& r = results[i];
+		printf("    { \"molecules\": %u, \"min_ns_per_molecule_tick\": %.3f, \"median_ns_per_molecule_tick\": %.3f, "
+			"\"contacts_per_tick\": %.1f, \"allocations\": %u, \"state_bytes\": %u, \"state_bytes_per_molecule\": %.1f, "
+			"\"update_bytes_per_tick\": %u }%s\n",
+			(unsigned)r.molecules, r.minNs, r.medianNs, r.contactsPerTick, (unsigned)r.allocations, (unsigned)r.memoryBytes,
+			r.memoryBytes / (double)r.molecules, (unsigned)(MoleculeStore::getUpdateBytesPerMolecule() * r.molecules), i + 1 < results.size() ? "," : "");
+	}
+	printf("  ],\n");
+	printf("  \"game\": { \"rounds\": %d, \"ticks\": %u, \"ns_per_tick\": %.1f, \"allocations\": %u, \"allocations_after_first_round\": %u }\n",
+		GAME_ROUNDS, (unsigned)game.ticks, game.nsPerTick, (unsigned)game.allocations, (unsigned)game.steadyAllocations);
+	printf("}\n");
+}
+
+// The game simulation without a window or GL context, over any number of molecules.
+// Options: --molecules 1000,10000 --ticks 100 --threads 1 (0 = all hardware threads) --json
+void benchSimulation(int argc, char** argv)
+{
+	SimulationOptions options = parseOptions(argc, argv);
+	JobSystem jobs(options.threads);
+	options.threads = jobs.getNumThreads();
+
+	NullBuffer nullBuffer;
+	streambuf* console = cout.rdbuf(&nullBuffer);
+	bool logSpawns = Molecule::logSpawns;
+	Molecule::logSpawns = false;
+
+	vector<SimulationResult> results;
+	for (size_t i = 0; i < options.counts.size(); ++i)
+		results.push_back(runSteps(jobs, options.counts[i], options.ticks));
+	GameResult game = runGame(jobs);
+
+	Molecule::logSpawns = logSpawns;
+	cout.rdbuf(console);
+
+	if (options.json)
+		printJson(options, results, game);
+	else
+		printText(options, results, game);
+}
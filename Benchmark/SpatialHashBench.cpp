@@ -0,0 +1,125 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <cmath>
+
+#include "Benchmark.h"
+#include "../MoleculeStore.h"
+#include "../SpatialHash.h"
+
+#define BENCH_TICKS 20
+// brute force is O(n^2), past this it takes too long to be worth running
+#define BRUTE_FORCE_MAX 10000
+// average number of molecules per cubic world unit
+#define BENCH_DENSITY 0.5f
+
+static float randRange(float lo, float hi)
+{
+	return lo + (hi - lo) * (rand() / (float)RAND_MAX);
+}
+
+static void fillStore(MoleculeStore& store, size_t count)
+{
+	// spread them through a cube that keeps the density the same for every count
+	float halfSize = 0.5f * pow(count / BENCH_DENSITY, 1.0f / 3.0f);
+
+	store.clear();
+	srand(1);
+	for (size_t i = 0; i < count; ++i)
+	{
+		glm::vec3 position(randRange(-halfSize, halfSize), randRange(-halfSize, halfSize), randRange(-halfSize, halfSize));
+		glm::vec3 spinAxis(randRange(0.0f, 1.0f), randRange(0.0f, 1.0f), randRange(0.0f, 1.0f));
+		store.add(MOLECULE_CO2, position, randRange(0.05f, 0.5f), spinAxis, randRange(0.5f, 8.0f));
+	}
+}
+
+// every pair against every other pair, what the grid replaces
+static size_t countPairsBruteForce(const MoleculeStore& store)
+{
+	const float minDist2 = 4.0f * MOLECULE_RADIUS * MOLECULE_RADIUS;
+	size_t pairs = 0;
+	for (size_t i = 0; i < store.size(); ++i)
+	{
+		for (size_t j = i + 1; j < store.size(); ++j)
+		{
+			float dx = store.posX[j] - store.posX[i];
+			float dy = store.posY[j] - store.posY[i];
+			float dz = store.posZ[j] - store.posZ[i];
+			pairs += dx * dx + dy * dy + dz * dz < minDist2;
+		}
+	}
+	return pairs;
+}
+
+static size_t countPairsGrid(const MoleculeStore& store, const SpatialHash& grid)
+{
+	const float minDist2 = 4.0f * MOLECULE_RADIUS * MOLECULE_RADIUS;
+	size_t pairs = 0;
+	for (size_t i = 0; i < store.size(); ++i)
+	{
+		glm::vec3 p = store.getPosition(i);
+		grid.forEachNeighbor(p, 2.0f * MOLECULE_RADIUS, [&](unsigned int j)
+		{
+			if (j <= i)
+				return;
+			glm::vec3 delta = store.getPosition(j) - p;
+			pairs += glm::dot(delta, delta) < minDist2;
+		});
+	}
+	return pairs;
+}
+
+// Build, query and full collide() ticks of the spatial hash, against a brute force pair test
+void benchSpatialHash()
+{
+	const size_t counts[] = { 1000, 10000, 100000 };
+
+	printf("Spatial hash collisions, %d ticks, %.1f molecules per unit^3, radius %.2f\n", BENCH_TICKS, BENCH_DENSITY, MOLECULE_RADIUS);
+	printf("%10s %8s %12s %12s %12s %14s %10s\n", "molecules", "pairs", "build ms", "query ms", "tick ms", "brute ms", "speedup");
+
+	for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); ++c)
+	{
+		size_t count = counts[c];
+		MoleculeStore store(count);
+		fillStore(store, count);
+		SpatialHash grid(COLLISION_CELL_SIZE);
+
+		Stopwatch buildTimer;
+		for (int tick = 0; tick < BENCH_TICKS; ++tick)
+			grid.build(store.posX.data(), store.posY.data(), store.posZ.data(), store.size());
+		double buildMs = buildTimer.elapsedNs() / 1e6 / BENCH_TICKS;
+
+		size_t pairs = 0;
+		Stopwatch queryTimer;
+		for (int tick = 0; tick < BENCH_TICKS; ++tick)
+			pairs = countPairsGrid(store, grid);
+		double queryMs = queryTimer.elapsedNs() / 1e6 / BENCH_TICKS;
+
+		// what Factory does every tick: move, rebuild, resolve
+		MoleculeStore moving(count);
+		fillStore(moving, count);
+		Stopwatch tickTimer;
+		for (int tick = 0; tick < BENCH_TICKS; ++tick)
+		{
+			moving.update();
+			grid.build(moving.posX.data(), moving.posY.data(), moving.posZ.data(), moving.size());
+			moving.collide(grid);
+		}
+		double tickMs = tickTimer.elapsedNs() / 1e6 / BENCH_TICKS;
+
+		if (count <= BRUTE_FORCE_MAX)
+		{
+			size_t brutePairs = 0;
+			Stopwatch bruteTimer;
+			brutePairs = countPairsBruteForce(store);
+			double bruteMs = bruteTimer.elapsedNs() / 1e6;
+
+			if (brutePairs != pairs)
+				printf("  pair count mismatch: grid %u, brute force %u\n", (unsigned)pairs, (unsigned)brutePairs);
+			printf("%10u %8u %12.3f %12.3f %12.3f %14.3f %9.1fx\n", (unsigned)count, (unsigned)pairs, buildMs, queryMs, tickMs, bruteMs, bruteMs / (buildMs + queryMs));
+		}
+		else
+		{
+			printf("%10u %8u %12.3f %12.3f %12.3f %14s %10s\n", (unsigned)count, (unsigned)pairs, buildMs, queryMs, tickMs, "-", "-");
+		}
+	}
+}
@@ -0,0 +1,24 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "Benchmark.h"
+
+// Benchmarks for the CPU side of CO2RemovalVR. None of them need a window or a GL context.
+// Pass the name of a benchmark to only run that one, followed by its options.
+int main(int argc, char** argv)
+{
+	const char* only = argc > 1 ? argv[1] : NULL;
+
+	if (!only || strcmp(only, "store") == 0)
+		benchMoleculeStore();
+	if (!only || strcmp(only, "jobs") == 0)
+		benchJobSystem();
+	if (!only || strcmp(only, "hash") == 0)
+		benchSpatialHash();
+	if (!only || strcmp(only, "pool") == 0)
+		benchMoleculePool();
+	if (!only || strcmp(only, "sim") == 0)
+		benchSimulation(only ? argc - 2 : 0, argv + 2);
+
+	return 0;
+}
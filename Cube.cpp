@@ -1,5 +1,6 @@
 #include "Cube.h"
 #include "Window.h"
+#include "GLState.h"
 
 Cube::Cube()
 {
@@ -12,11 +13,11 @@ Cube::Cube()
 	
 	// Bind the Vertex Array Object (VAO) first, then bind the associated buffers to it.
 	// Consider the VAO as a container for all your buffers.
-	glBindVertexArray(VAO);
+	GLState::bindVertexArray(VAO);
 
 	// Now bind a VBO to it as a GL_ARRAY_BUFFER. The GL_ARRAY_BUFFER is an array containing relevant data to what
 	// you want to draw, such as vertices, normals, colors, etc.
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	GLState::bindBuffer(GL_ARRAY_BUFFER, VBO);
 	// glBufferData populates the most recently bound buffer with data starting at the 3rd argument and ending after
 	// the 2nd argument number of indices. How does OpenGL know how long an index spans? Go to glVertexAttribPointer.
 	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
@@ -31,43 +32,40 @@ Cube::Cube()
 
 	// We've sent the vertex data over to OpenGL, but there's still something missing.
 	// In what order should it draw those vertices? That's why we'll need a GL_ELEMENT_ARRAY_BUFFER for this.
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+	GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
 	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
 
 	// Unbind the currently bound buffer so that we don't accidentally make unwanted changes to it.
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	GLState::bindBuffer(GL_ARRAY_BUFFER, 0);
 	// Unbind the VAO now so we don't accidentally tamper with it.
 	// NOTE: You must NEVER unbind the element array buffer associated with a VAO!
-	glBindVertexArray(0);
+	GLState::bindVertexArray(0);
 }
 
 Cube::~Cube()
 {
 	// Delete previously generated buffers. Note that forgetting to do this can waste GPU memory in a 
 	// large project! This could crash the graphics driver due to memory leaks, or slow down application performance!
-	glDeleteVertexArrays(1, &VAO);
-	glDeleteBuffers(1, &VBO);
-	glDeleteBuffers(1, &EBO);
+	GLState::deleteVertexArrays(1, &VAO);
+	GLState::deleteBuffers(1, &VBO);
+	GLState::deleteBuffers(1, &EBO);
 }
 
 void Cube::draw(GLuint shaderProgram)
 { 
-	// Calculate the combination of the model and view (camera inverse) matrices
-	glm::mat4 modelview = Window::V * toWorld;
-	// We need to calcullate this because modern OpenGL does not keep track of any matrix other than the viewport (D)
-	// Consequently, we need to forward the projection, view, and model matrices to the shader programs
-	// Get the location of the uniform variables "projection" and "modelview"
-	uProjection = glGetUniformLocation(shaderProgram, "projection");
-	uModelview = glGetUniformLocation(shaderProgram, "modelview");
+	// The projection and view (camera inverse) matrices come from the per-frame uniform block,
+	// so we only need to forward the model matrix to the shader program
+	const ShaderUniforms& uniforms = GetShaderUniforms(shaderProgram);
+	uModel = uniforms.model;
+	uInstanced = uniforms.instanced;
 	// Now send these values to the shader program
-	glUniformMatrix4fv(uProjection, 1, GL_FALSE, &Window::P[0][0]);
-	glUniformMatrix4fv(uModelview, 1, GL_FALSE, &modelview[0][0]);
+	glUniformMatrix4fv(uModel, 1, GL_FALSE, &toWorld[0][0]);
+	glUniform1i(uInstanced, GL_FALSE);
 	// Now draw the cube. We simply need to bind the VAO associated with it.
-	glBindVertexArray(VAO);
+	GLState::bindVertexArray(VAO);
 	// Tell OpenGL to draw with triangles, using 36 indices, the type of the indices, and the offset to start from
 	glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-	// Unbind the VAO when we're done so we don't accidentally draw extra stuff or tamper with its bound buffers
-	glBindVertexArray(0);
+	// The VAO stays bound, GLState knows it is and skips binding it again for the next cube
 }
 
 void Cube::update()
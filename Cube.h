@@ -29,7 +29,7 @@ public:
 
 	// These variables are needed for the shader program
 	GLuint VBO, VAO, EBO;
-	GLuint uProjection, uModelview;
+	GLuint uModel, uInstanced;
 };
 
 // Define the coordinates and indices needed to draw the cube. Note that it is not necessary
@@ -0,0 +1,198 @@
+#include "DDSCache.h"
+#include "TextureCache.h"
+#include "RenderStats.h"
+#include "GLState.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <iostream>
+
+#include <SOIL.h>
+extern "C"
+{
+#include <image_DXT.h>
+}
+
+#define DDS_MAGIC (('D' << 0) | ('D' << 8) | ('S' << 16) | (' ' << 24))
+#define FOURCC_DXT1 (('D' << 0) | ('X' << 8) | ('T' << 16) | ('1' << 24))
+#define FOURCC_DXT5 (('D' << 0) | ('X' << 8) | ('T' << 16) | ('5' << 24))
+
+// where the cache keeps its own fields in dwReserved1
+enum DDSCacheField
+{
+	DDS_FIELD_TAG,
+	DDS_FIELD_VERSION,
+	DDS_FIELD_HASH_LOW,
+	DDS_FIELD_HASH_HIGH,
+	DDS_FIELD_SIZE_LOW,
+	DDS_FIELD_SIZE_HIGH
+};
+
+// DXT1 packs a 4x4 block into 8 bytes, DXT5 adds 8 more for alpha
+static size_t getLevelSize(unsigned width, unsigned height, bool alpha)
+{
+	return (size_t)((width + 3) / 4) * ((height + 3) / 4) * (alpha ? 16 : 8);
+}
+
+string DDSCache::getCookedPath(const string& sourcePath, unsigned flags)
+{
+	return sourcePath + (flags & TEXTURE_ALPHA ? ".dxt5.dds" : ".dxt1.dds");
+}
+
+bool DDSCache::load(const string& sourcePath, unsigned flags)
+{
+	close();
+
+	uint64_t sourceHash, sourceSize;
+	if (!MeshCache::hashFile(sourcePath, sourceHash, sourceSize))
+		return false;
+
+	// the cooked copy is only used if it was made from exactly this source file
+	string cookedPath = getCookedPath(sourcePath, flags);
+	if (file.open(cookedPath))
+	{
+		data = file.getData();
+		size = file.getSize();
+		if (open(sourceHash, sourceSize, flags))
+			return true;
+		close();
+	}
+
+	return cookFile(sourcePath, cookedPath, flags, sourceHash, sourceSize);
+}
+
+void DDSCache::close()
+{
+	file.close();
+	cooked.clear();
+	data = NULL;
+	size = 0;
+}
+
+bool DDSCache::open(uint64_t sourceHash, uint64_t sourceSize, unsigned flags)
+{
+	if (size < sizeof(DDS_header))
+		return false;
+
+	const DDS_header& header = *(const DDS_header*)data;
+	const unsigned* fields = header.dwReserved1;
+	bool alpha = (flags & TEXTURE_ALPHA) != 0;
+	if (header.dwMagic != DDS_MAGIC || header.dwSize != 124 ||
+		header.sPixelFormat.dwFourCC != (alpha ? FOURCC_DXT5 : FOURCC_DXT1) ||
+		fields[DDS_FIELD_TAG] != DDS_CACHE_TAG || fields[DDS_FIELD_VERSION] != DDS_CACHE_VERSION ||
+		fields[DDS_FIELD_HASH_LOW] != (unsigned)sourceHash || fields[DDS_FIELD_HASH_HIGH] != (unsigned)(sourceHash >> 32) ||
+		fields[DDS_FIELD_SIZE_LOW] != (unsigned)sourceSize || fields[DDS_FIELD_SIZE_HIGH] != (unsigned)(sourceSize >> 32) ||
+		header.dwWidth == 0 || header.dwHeight == 0 || header.dwMipMapCount == 0)
+	{
+		return false;
+	}
+
+	// make sure every level is actually there before anything reads it
+	size_t expected = sizeof(DDS_header);
+	unsigned width = header.dwWidth, height = header.dwHeight;
+	for (unsigned level = 0; level < header.dwMipMapCount; ++level)
+	{
+		expected += getLevelSize(width, height, alpha);
+		width = width > 1 ? width / 2 : 1;
+		height = height > 1 ? height / 2 : 1;
+	}
+	return expected <= size;
+}
+
+bool DDSCache::cookFile(const string& sourcePath, const string& cookedPath, unsigned flags, uint64_t sourceHash, uint64_t sourceSize)
+{
+	bool alpha = (flags & TEXTURE_ALPHA) != 0;
+
+	int width, height, channels;
+	unsigned char* image = SOIL_load_image(sourcePath.c_str(), &width, &height, &channels, alpha ? SOIL_LOAD_RGBA : SOIL_LOAD_RGB);
+	if (!image)
+		return false;
+
+	// compress the whole mip chain now, so nothing has to be filtered at load time
+	int compressedSize, mipCount;
+	unsigned char* compressed = convert_image_to_DXT_mipmapped(image, width, height, alpha ? 4 : 3, &compressedSize, &mipCount);
+	SOIL_free_image_data(image);
+	if (!compressed)
+		return false;
+
+	DDS_header header;
+	memset(&header, 0, sizeof(header));
+	header.dwMagic = DDS_MAGIC;
+	header.dwSize = 124;
+	header.dwFlags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_LINEARSIZE | DDSD_MIPMAPCOUNT;
+	header.dwWidth = width;
+	header.dwHeight = height;
+	header.dwPitchOrLinearSize = (unsigned)getLevelSize(width, height, alpha);
+	header.dwMipMapCount = mipCount;
+	header.dwReserved1[DDS_FIELD_TAG] = DDS_CACHE_TAG;
+	header.dwReserved1[DDS_FIELD_VERSION] = DDS_CACHE_VERSION;
+	header.dwReserved1[DDS_FIELD_HASH_LOW] = (unsigned)sourceHash;
+	header.dwReserved1[DDS_FIELD_HASH_HIGH] = (unsigned)(sourceHash >> 32);
+	header.dwReserved1[DDS_FIELD_SIZE_LOW] = (unsigned)sourceSize;
+	header.dwReserved1[DDS_FIELD_SIZE_HIGH] = (unsigned)(sourceSize >> 32);
+	header.sPixelFormat.dwSize = 32;
+	header.sPixelFormat.dwFlags = DDPF_FOURCC;
+	header.sPixelFormat.dwFourCC = alpha ? FOURCC_DXT5 : FOURCC_DXT1;
+	header.sCaps.dwCaps1 = DDSCAPS_TEXTURE | DDSCAPS_COMPLEX | DDSCAPS_MIPMAP;
+
+	cooked.resize(sizeof(header) + compressedSize);
+	memcpy(&cooked[0], &header, sizeof(header));
+	memcpy(&cooked[sizeof(header)], compressed, compressedSize);
+	free(compressed);
+	data = &cooked[0];
+	size = cooked.size();
+
+	// a texture that can't be written is still used, it's just cooked again next time
+	FILE* out = fopen(cookedPath.c_str(), "wb");
+	bool written = out && fwrite(data, 1, size, out) == size;
+	if (out)
+		written = fclose(out) == 0 && written;
+	if (!written)
+	{
+		cerr << "ERROR::DDS_CACHE::Failed to write " << cookedPath << endl;
+		remove(cookedPath.c_str());
+	}
+	return true;
+}
+
+size_t DDSCache::upload(GLuint texture, unsigned flags) const
+{
+	const DDS_header& header = *(const DDS_header*)data;
+	bool alpha = header.sPixelFormat.dwFourCC == FOURCC_DXT5;
+	GLenum format = alpha ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+	unsigned levels = flags & TEXTURE_NO_MIPMAPS ? 1 : header.dwMipMapCount;
+
+	GLState::bindTexture(0, GL_TEXTURE_2D, texture);
+	// the chain may stop short of what GL expects when either side is odd, so tell it where it ends
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+
+	const unsigned char* level = data + sizeof(DDS_header);
+	unsigned width = header.dwWidth, height = header.dwHeight;
+	size_t bytes = 0;
+	for (unsigned i = 0; i < levels; ++i)
+	{
+		size_t levelSize = getLevelSize(width, height, alpha);
+		glCompressedTexImage2D(GL_TEXTURE_2D, i, format, width, height, 0, (GLsizei)levelSize, level);
+
+		level += levelSize;
+		bytes += levelSize;
+		width = width > 1 ? width / 2 : 1;
+		height = height > 1 ? height / 2 : 1;
+	}
+	GLState::bindTexture(0, GL_TEXTURE_2D, 0);
+
+	RenderStats::current.textureBytesUploaded += bytes;
+	return bytes;
+}
+
+bool DDSCache::cook(const string& sourcePath, unsigned flags)
+{
+	DDSCache cache;
+	if (!cache.load(sourcePath, flags))
+	{
+		cerr << "ERROR::DDS_CACHE::Can't cook " << sourcePath << endl;
+		return false;
+	}
+	return true;
+}
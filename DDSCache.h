@@ -0,0 +1,54 @@
+#ifndef _DDS_CACHE_H
+#define _DDS_CACHE_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "MeshCache.h"
+
+// bump this whenever the cooking below changes, so old cooked textures get cooked again
+#define DDS_CACHE_VERSION 1u
+// Stored in the DDS header's reserved words, which every other DDS reader ignores, followed
+// by the source file's hash and size. "CO2T" in a little endian file.
+#define DDS_CACHE_TAG 0x54324f43u
+
+using namespace std;
+
+// The block compressed copy of an image, with its whole mip chain, cooked next to the source
+// file as a DDS. RGB images become DXT1 and images loaded with TEXTURE_ALPHA become DXT5,
+// a sixth and a quarter of their uncompressed size.
+class DDSCache
+{
+public:
+	// the alpha and no alpha cooks of the same image are different files
+	static string getCookedPath(const string& sourcePath, unsigned flags);
+
+	// Maps the cooked copy of sourcePath, cooking it first if it's missing or stale.
+	// Doesn't need GL, so it can run on any thread.
+	bool load(const string& sourcePath, unsigned flags);
+	void close();
+
+	// Uploads the mip chain with glCompressedTexImage2D, or just the top level with
+	// TEXTURE_NO_MIPMAPS. Returns the bytes the texture takes up.
+	size_t upload(GLuint texture, unsigned flags) const;
+
+	// whether the GL implementation can take DXT data at all
+	static bool isSupported() { return GLEW_EXT_texture_compression_s3tc != 0; }
+
+	// Cooks sourcePath if its cooked copy is missing or stale, for cooking assets ahead of time
+	static bool cook(const string& sourcePath, unsigned flags);
+
+private:
+	MappedFile file;
+	vector<unsigned char> cooked;	// the freshly cooked file, instead of mapping what was just written
+	const unsigned char* data = NULL;
+	size_t size = 0;
+
+	bool open(uint64_t sourceHash, uint64_t sourceSize, unsigned flags);
+	bool cookFile(const string& sourcePath, const string& cookedPath, unsigned flags, uint64_t sourceHash, uint64_t sourceSize);
+};
+
+#endif
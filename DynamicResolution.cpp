@@ -0,0 +1,129 @@
+#include "DynamicResolution.h"
+#include "GLState.h"
+
+#include <math.h>
+#include <iostream>
+#include <algorithm>
+
+using namespace std;
+
+// no frame has been looked at yet
+#define NO_FRAME ((unsigned long long)-1)
+
+DynamicResolution::DynamicResolution(float targetMs, float minScale, float maxScale, float hysteresis)
+{
+	this->targetMs = targetMs;
+	this->minScale = minScale;
+	this->maxScale = max(minScale, maxScale);
+	this->hysteresis = hysteresis;
+	// start out at full resolution, or as close to it as it's allowed
+	this->scale = min(max(1.0f, this->minScale), this->maxScale);
+	this->lastFrame = NO_FRAME;
+
+	width = height = 0;
+	scaledWidth = scaledHeight = 0;
+	FBO = colorBuffer = depthBuffer = 0;
+	resolveFBO = resolveBuffer = 0;
+}
+
+void DynamicResolution::resize(int width, int height)
+{
+	this->width = width;
+	this->height = height;
+	// minimized
+	if (width <= 0 || height <= 0)
+		return;
+
+	cleanup();
+	createTarget((int)ceilf(width * maxScale), (int)ceilf(height * maxScale));
+}
+
+float DynamicResolution::update(const Profiler& profiler)
+{
+	const Profiler::FrameTimes* times = profiler.getLastCompleteFrame();
+	if (!times || times->frame == lastFrame)
+		return scale;
+	lastFrame = times->frame;
+
+	double sceneMs = times->gpuMs[Profiler::Sample_AfterSceneRender];
+	if (sceneMs <= 0.0 || times->resolutionScale <= 0.0f)
+		return scale;
+	// close enough
+	if (sceneMs <= targetMs && sceneMs >= targetMs * (1.0f - hysteresis))
+		return scale;
+
+	// the GPU time goes with the pixel count, which goes with the square of the scale, so
+	// this is what the frame would have taken at full resolution. Aim for the middle of the band.
+	double fullMs = sceneMs / (times->resolutionScale * times->resolutionScale);
+	float wanted = (float)sqrt(targetMs * (1.0f - hysteresis * 0.5f) / fullMs);
+	scale = min(max(wanted, minScale), maxScale);
+	return scale;
+}
+
+void DynamicResolution::bind(int& scaledWidth, int& scaledHeight)
+{
+	this->scaledWidth = max(1, (int)(width * scale + 0.5f));
+	this->scaledHeight = max(1, (int)(height * scale + 0.5f));
+	scaledWidth = this->scaledWidth;
+	scaledHeight = this->scaledHeight;
+
+	GLState::bindFramebuffer(GL_FRAMEBUFFER, FBO);
+	GLState::viewport(0, 0, scaledWidth, scaledHeight);
+}
+
+void DynamicResolution::present(GLuint framebuffer, int width, int height)
+{
+	// resolve the samples at the size they were drawn at
+	GLState::bindFramebuffer(GL_READ_FRAMEBUFFER, FBO);
+	GLState::bindFramebuffer(GL_DRAW_FRAMEBUFFER, resolveFBO);
+	glBlitFramebuffer(0, 0, scaledWidth, scaledHeight, 0, 0, scaledWidth, scaledHeight, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+
+	// then filter that up to the whole window
+	GLState::bindFramebuffer(GL_READ_FRAMEBUFFER, resolveFBO);
+	GLState::bindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+	glBlitFramebuffer(0, 0, scaledWidth, scaledHeight, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+
+	GLState::bindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	GLState::viewport(0, 0, width, height);
+}
+
+void DynamicResolution::cleanup()
+{
+	GLState::deleteFramebuffers(1, &FBO);
+	GLState::deleteFramebuffers(1, &resolveFBO);
+	glDeleteRenderbuffers(1, &colorBuffer);
+	glDeleteRenderbuffers(1, &depthBuffer);
+	glDeleteRenderbuffers(1, &resolveBuffer);
+	FBO = colorBuffer = depthBuffer = 0;
+	resolveFBO = resolveBuffer = 0;
+}
+
+void DynamicResolution::createTarget(int targetWidth, int targetHeight)
+{
+	glGenFramebuffers(1, &FBO);
+	glGenRenderbuffers(1, &colorBuffer);
+	glGenRenderbuffers(1, &depthBuffer);
+	glGenFramebuffers(1, &resolveFBO);
+	glGenRenderbuffers(1, &resolveBuffer);
+
+	glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+	glRenderbufferStorageMultisample(GL_RENDERBUFFER, DYNAMIC_RESOLUTION_SAMPLES, GL_RGBA8, targetWidth, targetHeight);
+	glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+	glRenderbufferStorageMultisample(GL_RENDERBUFFER, DYNAMIC_RESOLUTION_SAMPLES, GL_DEPTH_COMPONENT24, targetWidth, targetHeight);
+	glBindRenderbuffer(GL_RENDERBUFFER, resolveBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, targetWidth, targetHeight);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	GLState::bindFramebuffer(GL_FRAMEBUFFER, FBO);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		cerr << "ERROR::DYNAMIC_RESOLUTION::Scene target is not complete" << endl;
+
+	GLState::bindFramebuffer(GL_FRAMEBUFFER, resolveFBO);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, resolveBuffer);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		cerr << "ERROR::DYNAMIC_RESOLUTION::Resolve target is not complete" << endl;
+
+	GLState::bindFramebuffer(GL_FRAMEBUFFER, 0);
+}
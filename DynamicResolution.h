@@ -0,0 +1,59 @@
+#ifndef _DYNAMIC_RESOLUTION_H
+#define _DYNAMIC_RESOLUTION_H
+
+#include <GL/glew.h>
+
+#include "Profiler.h"
+
+// GPU time the scene may take, a 90Hz frame with room left for everything else
+#define DYNAMIC_RESOLUTION_TARGET_MS 8.0f
+#define DYNAMIC_RESOLUTION_MIN_SCALE 0.5f
+#define DYNAMIC_RESOLUTION_MAX_SCALE 1.0f
+// The scale is left alone while the scene takes between this fraction under the target and
+// the target, so it doesn't flicker between two sizes every frame
+#define DYNAMIC_RESOLUTION_HYSTERESIS 0.15f
+// the scene is multisampled in the scaled target instead of the window
+#define DYNAMIC_RESOLUTION_SAMPLES 4
+
+// Draws the scene at whatever fraction of the window's resolution the GPU has time for. The
+// target is allocated once at the largest size it can be drawn at, and only the viewport in
+// it shrinks and grows. present() stretches whatever was drawn over the whole window.
+//
+// The scale comes from the scene's GPU time in the profiler, which is a few frames old. Since
+// the profiler keeps the scale each frame was drawn at, it's what that frame would have taken
+// at full resolution that decides, so the latency doesn't make it overshoot.
+class DynamicResolution
+{
+public:
+	DynamicResolution(float targetMs = DYNAMIC_RESOLUTION_TARGET_MS, float minScale = DYNAMIC_RESOLUTION_MIN_SCALE,
+		float maxScale = DYNAMIC_RESOLUTION_MAX_SCALE, float hysteresis = DYNAMIC_RESOLUTION_HYSTERESIS);
+
+	// the size of the window, the target is allocated for it at the largest scale
+	void resize(int width, int height);
+	// Picks the scale for the next frame from the newest one the profiler has GPU times for,
+	// and returns it
+	float update(const Profiler& profiler);
+	float getScale() const { return scale; }
+
+	// binds the target and sets the viewport to the scaled size, which is returned
+	void bind(int& scaledWidth, int& scaledHeight);
+	// resolves what was drawn since bind() and stretches it over framebuffer, which is width by height
+	void present(GLuint framebuffer, int width, int height);
+
+	// deletes the target, needs the GL context it was created in
+	void cleanup();
+
+private:
+	float targetMs, minScale, maxScale, hysteresis;
+	float scale;
+	unsigned long long lastFrame;	// the profiler frame the scale was last picked from
+
+	int width, height;				// of the window
+	int scaledWidth, scaledHeight;	// of the last bind()
+	GLuint FBO, colorBuffer, depthBuffer;
+	GLuint resolveFBO, resolveBuffer;	// multisampled images can only be resolved at the same size
+
+	void createTarget(int targetWidth, int targetHeight);
+};
+
+#endif
@@ -2,39 +2,35 @@
 #define _FACTORY_H
 
 #include <vector>
-#include <ctime>
 
-#include "Molecule.h"
+#include "model.h"
+#include "Simulation.h"
+#include "MoleculeRenderer.h"
+#include "JobSystem.h"
+#include "AssetLoader.h"
 
 #define FACTORY_PATH "../Assets/factory1/factory1.obj"
-#define NUM_MOL_INIT 5
-#define SECS_BTWN_EMIT 1
-#define MAX_MOLS 10
-#define MOLS_ON_LOSE 50
 
 class Factory : protected Model
 {
 public:
-	Factory();
+	// with no job system every update runs on the calling thread,
+	// with no loader every model is loaded before this returns
+	Factory(JobSystem* jobs = NULL, AssetLoader* loader = NULL);
 	~Factory();
 
-	void draw(GLuint shaderProgram);
+	// alpha is how far rendering is between the last two updates
+	void draw(GLuint shaderProgram, float alpha);
+	// advances the game by one fixed simulation tick
 	void update();
 	void restart();
 
-	int getNumCO2Molecules() { return numCO2Molecules; }
-	vector<Molecule*> getMolecules() { return molecules; }
-
-	static bool gameLost;
-	static bool gameWon;
+	int getNumCO2Molecules() { return simulation.getNumCO2Molecules(); }
+	const MoleculeStore& getMolecules() const { return simulation.getMolecules(); }
 
 private:
-	Molecule* createMolecule();
-
-	vector<Molecule*> molecules;
-	int numCO2Molecules;
-
-	clock_t timer;
+	Simulation simulation;
+	MoleculeRenderer* moleculeRenderer;
 };
 
 #endif
@@ -0,0 +1,218 @@
+#include "FrustumCuller.h"
+#include "RenderStats.h"
+
+#include <math.h>
+#include <float.h>
+#include <algorithm>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define FRUSTUM_CULLER_SSE
+#include <xmmintrin.h>
+#endif
+
+using namespace std;
+
+// planes that everything is in front of, so nothing is culled before the first setView
+glm::vec4 FrustumCuller::planes[FRUSTUM_PLANES] = {
+	glm::vec4(0.0f, 0.0f, 0.0f, 1.0f), glm::vec4(0.0f, 0.0f, 0.0f, 1.0f), glm::vec4(0.0f, 0.0f, 0.0f, 1.0f),
+	glm::vec4(0.0f, 0.0f, 0.0f, 1.0f), glm::vec4(0.0f, 0.0f, 0.0f, 1.0f), glm::vec4(0.0f, 0.0f, 0.0f, 1.0f)
+};
+
+void FrustumCuller::setView(const glm::mat4& viewProjection)
+{
+	extractPlanes(viewProjection, planes);
+}
+
+void FrustumCuller::setStereoView(const glm::mat4& leftViewProjection, const glm::mat4& rightViewProjection)
+{
+	glm::vec4 left[FRUSTUM_PLANES], right[FRUSTUM_PLANES];
+	extractPlanes(leftViewProjection, left);
+	extractPlanes(rightViewProjection, right);
+
+	glm::vec3 corners[16];
+	getCorners(leftViewProjection, corners);
+	getCorners(rightViewProjection, corners + 8);
+
+	// For each side, whichever eye's plane both frusta are furthest inside of. With eyes that
+	// only sit apart, that's the outer eye's side planes and the shared near and far planes,
+	// and nothing has to move.
+	for (int i = 0; i < FRUSTUM_PLANES; ++i)
+	{
+		float leftInside = FLT_MAX, rightInside = FLT_MAX;
+		for (int c = 0; c < 16; ++c)
+		{
+			leftInside = min(leftInside, glm::dot(glm::vec3(left[i]), corners[c]) + left[i].w);
+			rightInside = min(rightInside, glm::dot(glm::vec3(right[i]), corners[c]) + right[i].w);
+		}
+
+		planes[i] = leftInside >= rightInside ? left[i] : right[i];
+		float inside = max(leftInside, rightInside);
+		if (inside < 0.0f)
+			planes[i].w -= inside;
+	}
+}
+
+size_t FrustumCuller::cullSpheres(const glm::vec4* spheres, size_t count, unsigned char* visible)
+{
+	size_t visibleCount = 0;
+	size_t i = 0;
+
+#ifdef FRUSTUM_CULLER_SSE
+	__m128 planeX[FRUSTUM_PLANES], planeY[FRUSTUM_PLANES], planeZ[FRUSTUM_PLANES], planeW[FRUSTUM_PLANES];
+	for (int p = 0; p < FRUSTUM_PLANES; ++p)
+	{
+		planeX[p] = _mm_set1_ps(planes[p].x);
+		planeY[p] = _mm_set1_ps(planes[p].y);
+		planeZ[p] = _mm_set1_ps(planes[p].z);
+		planeW[p] = _mm_set1_ps(planes[p].w);
+	}
+
+	for (; i + 4 <= count; i += 4)
+	{
+		// four spheres in, one lane each
+		__m128 x = _mm_loadu_ps(&spheres[i][0]);
+		__m128 y = _mm_loadu_ps(&spheres[i + 1][0]);
+		__m128 z = _mm_loadu_ps(&spheres[i + 2][0]);
+		__m128 radius = _mm_loadu_ps(&spheres[i + 3][0]);
+		_MM_TRANSPOSE4_PS(x, y, z, radius);
+		__m128 negativeRadius = _mm_sub_ps(_mm_setzero_ps(), radius);
+
+		__m128 outside = _mm_setzero_ps();
+		for (int p = 0; p < FRUSTUM_PLANES; ++p)
+		{
+			__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, planeX[p]), _mm_mul_ps(y, planeY[p])),
+				_mm_add_ps(_mm_mul_ps(z, planeZ[p]), planeW[p]));
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, negativeRadius));
+		}
+
+		int mask = _mm_movemask_ps(outside);
+		for (int k = 0; k < 4; ++k)
+		{
+			visible[i + k] = (mask >> k & 1) == 0;
+			visibleCount += visible[i + k];
+		}
+	}
+#endif
+
+	for (; i < count; ++i)
+	{
+		glm::vec3 center = glm::vec3(spheres[i]);
+		bool inside = true;
+		for (int p = 0; p < FRUSTUM_PLANES && inside; ++p)
+			inside = glm::dot(glm::vec3(planes[p]), center) + planes[p].w >= -spheres[i].w;
+		visible[i] = inside;
+		visibleCount += inside;
+	}
+
+	RenderStats::current.objectsCulled += count - visibleCount;
+	return visibleCount;
+}
+
+size_t FrustumCuller::cullBoxes(const glm::vec3* centers, const glm::vec3* extents, size_t count, unsigned char* visible)
+{
+	// a box is outside once its corner nearest to a plane is, and that corner is as far
+	// from its center as the extents projected onto the plane's normal
+	glm::vec3 absNormals[FRUSTUM_PLANES];
+	for (int p = 0; p < FRUSTUM_PLANES; ++p)
+		absNormals[p] = glm::abs(glm::vec3(planes[p]));
+
+	size_t visibleCount = 0;
+	size_t i = 0;
+
+#ifdef FRUSTUM_CULLER_SSE
+	__m128 planeX[FRUSTUM_PLANES], planeY[FRUSTUM_PLANES], planeZ[FRUSTUM_PLANES], planeW[FRUSTUM_PLANES];
+	__m128 absX[FRUSTUM_PLANES], absY[FRUSTUM_PLANES], absZ[FRUSTUM_PLANES];
+	for (int p = 0; p < FRUSTUM_PLANES; ++p)
+	{
+		planeX[p] = _mm_set1_ps(planes[p].x);
+		planeY[p] = _mm_set1_ps(planes[p].y);
+		planeZ[p] = _mm_set1_ps(planes[p].z);
+		planeW[p] = _mm_set1_ps(planes[p].w);
+		absX[p] = _mm_set1_ps(absNormals[p].x);
+		absY[p] = _mm_set1_ps(absNormals[p].y);
+		absZ[p] = _mm_set1_ps(absNormals[p].z);
+	}
+
+	for (; i + 4 <= count; i += 4)
+	{
+		const glm::vec3* c = centers + i;
+		const glm::vec3* e = extents + i;
+		__m128 x = _mm_setr_ps(c[0].x, c[1].x, c[2].x, c[3].x);
+		__m128 y = _mm_setr_ps(c[0].y, c[1].y, c[2].y, c[3].y);
+		__m128 z = _mm_setr_ps(c[0].z, c[1].z, c[2].z, c[3].z);
+		__m128 ex = _mm_setr_ps(e[0].x, e[1].x, e[2].x, e[3].x);
+		__m128 ey = _mm_setr_ps(e[0].y, e[1].y, e[2].y, e[3].y);
+		__m128 ez = _mm_setr_ps(e[0].z, e[1].z, e[2].z, e[3].z);
+
+		__m128 outside = _mm_setzero_ps();
+		for (int p = 0; p < FRUSTUM_PLANES; ++p)
+		{
+			__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, planeX[p]), _mm_mul_ps(y, planeY[p])),
+				_mm_add_ps(_mm_mul_ps(z, planeZ[p]), planeW[p]));
+			__m128 reach = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ex, absX[p]), _mm_mul_ps(ey, absY[p])), _mm_mul_ps(ez, absZ[p]));
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, reach), _mm_setzero_ps()));
+		}
+
+		int mask = _mm_movemask_ps(outside);
+		for (int k = 0; k < 4; ++k)
+		{
+			visible[i + k] = (mask >> k & 1) == 0;
+			visibleCount += visible[i + k];
+		}
+	}
+#endif
+
+	for (; i < count; ++i)
+	{
+		bool inside = true;
+		for (int p = 0; p < FRUSTUM_PLANES && inside; ++p)
+			inside = glm::dot(glm::vec3(planes[p]), centers[i]) + planes[p].w + glm::dot(absNormals[p], extents[i]) >= 0.0f;
+		visible[i] = inside;
+		visibleCount += inside;
+	}
+
+	RenderStats::current.objectsCulled += count - visibleCount;
+	return visibleCount;
+}
+
+glm::vec4 FrustumCuller::getWorldSphere(const glm::vec3& center, float radius, const glm::mat4& toWorld)
+{
+	// the radius grows with the largest scale the transform applies
+	float scale = max(glm::length(glm::vec3(toWorld[0])), max(glm::length(glm::vec3(toWorld[1])), glm::length(glm::vec3(toWorld[2]))));
+	return glm::vec4(glm::vec3(toWorld * glm::vec4(center, 1.0f)), radius * scale);
+}
+
+void FrustumCuller::getWorldBox(const glm::vec3& min, const glm::vec3& max, const glm::mat4& toWorld, glm::vec3& center, glm::vec3& extent)
+{
+	// the box around the transformed box
+	glm::vec3 halfExtent = (max - min) * 0.5f;
+	center = glm::vec3(toWorld * glm::vec4((min + max) * 0.5f, 1.0f));
+	for (int row = 0; row < 3; ++row)
+		extent[row] = fabsf(toWorld[0][row]) * halfExtent.x + fabsf(toWorld[1][row]) * halfExtent.y + fabsf(toWorld[2][row]) * halfExtent.z;
+}
+
+void FrustumCuller::extractPlanes(const glm::mat4& viewProjection, glm::vec4* planes)
+{
+	// Gribb and Hartmann: each plane is the last row of the matrix plus or minus one of the others
+	glm::vec4 rows[4];
+	for (int row = 0; row < 4; ++row)
+		rows[row] = glm::vec4(viewProjection[0][row], viewProjection[1][row], viewProjection[2][row], viewProjection[3][row]);
+
+	for (int i = 0; i < FRUSTUM_PLANES; ++i)
+	{
+		glm::vec4 plane = i % 2 == 0 ? rows[3] + rows[i / 2] : rows[3] - rows[i / 2];
+		// a degenerate matrix doesn't cull anything rather than everything
+		float length = glm::length(glm::vec3(plane));
+		planes[i] = length > 0.0f ? plane / length : glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+	}
+}
+
+void FrustumCuller::getCorners(const glm::mat4& viewProjection, glm::vec3* corners)
+{
+	glm::mat4 toWorld = glm::inverse(viewProjection);
+	for (int i = 0; i < 8; ++i)
+	{
+		glm::vec4 corner = toWorld * glm::vec4(i & 1 ? 1.0f : -1.0f, i & 2 ? 1.0f : -1.0f, i & 4 ? 1.0f : -1.0f, 1.0f);
+		corners[i] = glm::vec3(corner) / corner.w;
+	}
+}
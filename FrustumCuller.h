@@ -0,0 +1,40 @@
+#ifndef _FRUSTUM_CULLER_H
+#define _FRUSTUM_CULLER_H
+
+#include <glm/glm.hpp>
+
+// left, right, bottom, top, near and far
+#define FRUSTUM_PLANES 6
+
+// Skips whatever is entirely outside the view before anything is sent to GL. Needs the
+// camera of the frame being drawn, like LodSelector. Until it has one nothing is culled.
+// Everything is tested four at a time with SSE where it's available.
+class FrustumCuller
+{
+public:
+	// culls against the frustum of projection * view
+	static void setView(const glm::mat4& viewProjection);
+	// Culls against one frustum around both eyes, so a stereo frame only tests everything once.
+	// It's the planes of either eye that keep both inside, pushed out where neither does.
+	static void setStereoView(const glm::mat4& leftViewProjection, const glm::mat4& rightViewProjection);
+
+	// World space spheres as center and radius in w. Sets visible[i] to whether sphere i
+	// is at least partly inside, and returns how many are. The culled ones are counted
+	// in RenderStats.
+	static size_t cullSpheres(const glm::vec4* spheres, size_t count, unsigned char* visible);
+	// the same for world space boxes, given by their centers and half extents
+	static size_t cullBoxes(const glm::vec3* centers, const glm::vec3* extents, size_t count, unsigned char* visible);
+
+	// object space bounds moved to world space, they can only grow
+	static glm::vec4 getWorldSphere(const glm::vec3& center, float radius, const glm::mat4& toWorld);
+	static void getWorldBox(const glm::vec3& min, const glm::vec3& max, const glm::mat4& toWorld, glm::vec3& center, glm::vec3& extent);
+
+private:
+	// dot(plane, vec4(p, 1)) >= 0 inside, with normalized normals
+	static glm::vec4 planes[FRUSTUM_PLANES];
+
+	static void extractPlanes(const glm::mat4& viewProjection, glm::vec4* planes);
+	static void getCorners(const glm::mat4& viewProjection, glm::vec3* corners);
+};
+
+#endif
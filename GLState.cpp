@@ -0,0 +1,398 @@
+#include "GLState.h"
+#include "RenderStats.h"
+
+#include <iostream>
+
+using namespace std;
+
+// a shadow nothing is known about, which no name or enum GL hands out can be
+#define UNKNOWN ((GLuint)-1)
+#define UNKNOWN_CAPABILITY -1
+
+GLuint GLState::program = UNKNOWN;
+GLuint GLState::vertexArray = UNKNOWN;
+GLuint GLState::buffers[Buffer_LAST];
+GLuint GLState::activeTexture = UNKNOWN;
+GLuint GLState::textures[GL_STATE_TEXTURE_UNITS];
+GLuint GLState::drawFramebuffer = UNKNOWN;
+GLuint GLState::readFramebuffer = UNKNOWN;
+GLint GLState::capabilities[Capability_LAST];
+GLenum GLState::depthFunction = UNKNOWN;
+GLenum GLState::blendSource = UNKNOWN;
+GLenum GLState::blendDestination = UNKNOWN;
+GLenum GLState::cullFaceMode = UNKNOWN;
+GLint GLState::viewportBox[4];
+
+// the arrays can't be filled with UNKNOWN where they're defined
+static struct GLStateInitializer
+{
+	GLStateInitializer() { GLState::invalidate(); }
+} initializer;
+
+static const GLenum bufferTargets[] = { GL_ARRAY_BUFFER, GL_ELEMENT_ARRAY_BUFFER, GL_UNIFORM_BUFFER,
+	GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, GL_PIXEL_UNPACK_BUFFER };
+// the copy buffers are queried with their targets, GL 3.3 has no separate names for their bindings
+static const GLenum bufferBindings[] = { GL_ARRAY_BUFFER_BINDING, GL_ELEMENT_ARRAY_BUFFER_BINDING, GL_UNIFORM_BUFFER_BINDING,
+	GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, GL_PIXEL_UNPACK_BUFFER_BINDING };
+static const GLenum capabilityNames[] = { GL_DEPTH_TEST, GL_BLEND, GL_CULL_FACE, GL_SCISSOR_TEST, GL_MULTISAMPLE, GL_CLIP_DISTANCE0 };
+
+void GLState::invalidate()
+{
+	program = UNKNOWN;
+	vertexArray = UNKNOWN;
+	for (int i = 0; i < Buffer_LAST; ++i)
+		buffers[i] = UNKNOWN;
+	activeTexture = UNKNOWN;
+	for (int i = 0; i < GL_STATE_TEXTURE_UNITS; ++i)
+		textures[i] = UNKNOWN;
+	drawFramebuffer = readFramebuffer = UNKNOWN;
+	for (int i = 0; i < Capability_LAST; ++i)
+		capabilities[i] = UNKNOWN_CAPABILITY;
+	depthFunction = UNKNOWN;
+	blendSource = blendDestination = UNKNOWN;
+	cullFaceMode = UNKNOWN;
+	viewportBox[0] = viewportBox[1] = viewportBox[2] = viewportBox[3] = -1;
+}
+
+void GLState::useProgram(GLuint program)
+{
+	if (program == GLState::program)
+	{
+		elided(GL_CURRENT_PROGRAM, program);
+		return;
+	}
+	glUseProgram(program);
+	GLState::program = program;
+	RenderStats::current.programBinds++;
+}
+
+void GLState::bindVertexArray(GLuint vertexArray)
+{
+	if (vertexArray == GLState::vertexArray)
+	{
+		elided(GL_VERTEX_ARRAY_BINDING, vertexArray);
+		return;
+	}
+	glBindVertexArray(vertexArray);
+	GLState::vertexArray = vertexArray;
+	buffers[Buffer_ElementArray] = UNKNOWN;
+	RenderStats::current.vertexArrayBinds++;
+}
+
+void GLState::bindBuffer(GLenum target, GLuint buffer)
+{
+	int index = getBufferTarget(target);
+	if (index >= 0 && buffer == buffers[index])
+	{
+		elided(bufferBindings[index], buffer);
+		return;
+	}
+	glBindBuffer(target, buffer);
+	if (index >= 0)
+		buffers[index] = buffer;
+	RenderStats::current.bufferBinds++;
+}
+
+void GLState::bindBufferBase(GLenum target, GLuint index, GLuint buffer)
+{
+	// the indexed binding points aren't shadowed, so this always goes through
+	glBindBufferBase(target, index, buffer);
+	int shadowed = getBufferTarget(target);
+	if (shadowed >= 0)
+		buffers[shadowed] = buffer;
+	RenderStats::current.bufferBinds++;
+}
+
+void GLState::bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+{
+	glBindBufferRange(target, index, buffer, offset, size);
+	int shadowed = getBufferTarget(target);
+	if (shadowed >= 0)
+		buffers[shadowed] = buffer;
+	RenderStats::current.bufferBinds++;
+}
+
+void GLState::bindTexture(GLuint unit, GLenum target, GLuint texture)
+{
+	bool shadowed = target == GL_TEXTURE_2D && unit < GL_STATE_TEXTURE_UNITS;
+	if (shadowed && texture == textures[unit])
+	{
+		// the binding can only be read back for the active unit
+		if (unit == activeTexture)
+			elided(GL_TEXTURE_BINDING_2D, texture);
+		else
+			elided(GL_NONE, 0);
+		return;
+	}
+	setActiveTexture(unit);
+	glBindTexture(target, texture);
+	if (shadowed)
+		textures[unit] = texture;
+	RenderStats::current.textureBinds++;
+}
+
+void GLState::bindFramebuffer(GLenum target, GLuint framebuffer)
+{
+	bool draw = target == GL_FRAMEBUFFER || target == GL_DRAW_FRAMEBUFFER;
+	bool read = target == GL_FRAMEBUFFER || target == GL_READ_FRAMEBUFFER;
+	if ((!draw || framebuffer == drawFramebuffer) && (!read || framebuffer == readFramebuffer))
+	{
+		elided(draw ? GL_DRAW_FRAMEBUFFER_BINDING : GL_READ_FRAMEBUFFER_BINDING, framebuffer);
+		return;
+	}
+	glBindFramebuffer(target, framebuffer);
+	if (draw)
+		drawFramebuffer = framebuffer;
+	if (read)
+		readFramebuffer = framebuffer;
+	RenderStats::current.renderStateChanges++;
+}
+
+void GLState::setEnabled(GLenum capability, bool enabled)
+{
+	int index = getCapability(capability);
+	if (index >= 0 && capabilities[index] == (GLint)enabled)
+	{
+		RenderStats::current.redundantStateCalls++;
+#ifdef GL_STATE_DEBUG
+		if ((glIsEnabled(capability) == GL_TRUE) != enabled)
+			cerr << "ERROR::GL_STATE::Capability 0x" << hex << capability << dec << " is not what it was left at" << endl;
+#endif
+		return;
+	}
+	if (enabled)
+		glEnable(capability);
+	else
+		glDisable(capability);
+	if (index >= 0)
+		capabilities[index] = enabled;
+	RenderStats::current.renderStateChanges++;
+}
+
+void GLState::depthFunc(GLenum func)
+{
+	if (func == depthFunction)
+	{
+		elided(GL_DEPTH_FUNC, func);
+		return;
+	}
+	glDepthFunc(func);
+	depthFunction = func;
+	RenderStats::current.renderStateChanges++;
+}
+
+void GLState::blendFunc(GLenum source, GLenum destination)
+{
+	if (source == blendSource && destination == blendDestination)
+	{
+		elided(GL_BLEND_SRC_RGB, source);
+#ifdef GL_STATE_DEBUG
+		check(GL_BLEND_DST_RGB, destination, "blend destination");
+#endif
+		return;
+	}
+	glBlendFunc(source, destination);
+	blendSource = source;
+	blendDestination = destination;
+	RenderStats::current.renderStateChanges++;
+}
+
+void GLState::cullFace(GLenum mode)
+{
+	if (mode == cullFaceMode)
+	{
+		elided(GL_CULL_FACE_MODE, mode);
+		return;
+	}
+	glCullFace(mode);
+	cullFaceMode = mode;
+	RenderStats::current.renderStateChanges++;
+}
+
+void GLState::viewport(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+	if (x == viewportBox[0] && y == viewportBox[1] && width == viewportBox[2] && height == viewportBox[3])
+	{
+		RenderStats::current.redundantStateCalls++;
+#ifdef GL_STATE_DEBUG
+		GLint actual[4];
+		glGetIntegerv(GL_VIEWPORT, actual);
+		if (actual[0] != x || actual[1] != y || actual[2] != width || actual[3] != height)
+			cerr << "ERROR::GL_STATE::Viewport is not what it was left at" << endl;
+#endif
+		return;
+	}
+	glViewport(x, y, width, height);
+	viewportBox[0] = x;
+	viewportBox[1] = y;
+	viewportBox[2] = width;
+	viewportBox[3] = height;
+	RenderStats::current.renderStateChanges++;
+}
+
+// deleting a bound object binds 0 in its place
+void GLState::deleteProgram(GLuint program)
+{
+	// a program that's in use is only really deleted once it isn't, so it stays current
+	glDeleteProgram(program);
+}
+
+void GLState::deleteVertexArrays(GLsizei count, const GLuint* vertexArrays)
+{
+	for (GLsizei i = 0; i < count; ++i)
+	{
+		if (vertexArrays[i] != 0 && vertexArrays[i] == vertexArray)
+		{
+			vertexArray = 0;
+			buffers[Buffer_ElementArray] = UNKNOWN;
+		}
+	}
+	glDeleteVertexArrays(count, vertexArrays);
+}
+
+void GLState::deleteBuffers(GLsizei count, const GLuint* buffers)
+{
+	for (GLsizei i = 0; i < count; ++i)
+		forget(GLState::buffers, Buffer_LAST, buffers[i]);
+	// the indexed binding points aren't shadowed, and some drivers reset the generic uniform
+	// binding too when a buffer that's only bound to one of them goes
+	GLState::buffers[Buffer_Uniform] = UNKNOWN;
+	glDeleteBuffers(count, buffers);
+}
+
+void GLState::deleteTextures(GLsizei count, const GLuint* textures)
+{
+	for (GLsizei i = 0; i < count; ++i)
+		forget(GLState::textures, GL_STATE_TEXTURE_UNITS, textures[i]);
+	glDeleteTextures(count, textures);
+}
+
+void GLState::deleteFramebuffers(GLsizei count, const GLuint* framebuffers)
+{
+	for (GLsizei i = 0; i < count; ++i)
+	{
+		forget(&drawFramebuffer, 1, framebuffers[i]);
+		forget(&readFramebuffer, 1, framebuffers[i]);
+	}
+	glDeleteFramebuffers(count, framebuffers);
+}
+
+bool GLState::validate()
+{
+	bool valid = true;
+	if (program != UNKNOWN)
+		valid &= check(GL_CURRENT_PROGRAM, program, "program");
+	if (vertexArray != UNKNOWN)
+		valid &= check(GL_VERTEX_ARRAY_BINDING, vertexArray, "vertex array");
+	for (int i = 0; i < Buffer_LAST; ++i)
+	{
+		if (buffers[i] != UNKNOWN)
+			valid &= check(bufferBindings[i], buffers[i], "buffer");
+	}
+	if (activeTexture != UNKNOWN)
+		valid &= check(GL_ACTIVE_TEXTURE, GL_TEXTURE0 + activeTexture, "active texture");
+	for (GLuint unit = 0; unit < GL_STATE_TEXTURE_UNITS; ++unit)
+	{
+		if (textures[unit] == UNKNOWN)
+			continue;
+		// looking at another unit has to go around the shadow, and put the active one back after
+		glActiveTexture(GL_TEXTURE0 + unit);
+		valid &= check(GL_TEXTURE_BINDING_2D, textures[unit], "texture");
+		if (activeTexture != UNKNOWN)
+			glActiveTexture(GL_TEXTURE0 + activeTexture);
+		else
+			activeTexture = unit;
+	}
+	if (drawFramebuffer != UNKNOWN)
+		valid &= check(GL_DRAW_FRAMEBUFFER_BINDING, drawFramebuffer, "draw framebuffer");
+	if (readFramebuffer != UNKNOWN)
+		valid &= check(GL_READ_FRAMEBUFFER_BINDING, readFramebuffer, "read framebuffer");
+	for (int i = 0; i < Capability_LAST; ++i)
+	{
+		if (capabilities[i] != UNKNOWN_CAPABILITY && (glIsEnabled(capabilityNames[i]) == GL_TRUE) != (capabilities[i] == 1))
+		{
+			cerr << "ERROR::GL_STATE::Capability 0x" << hex << capabilityNames[i] << dec << " is not what it was left at" << endl;
+			valid = false;
+		}
+	}
+	if (depthFunction != UNKNOWN)
+		valid &= check(GL_DEPTH_FUNC, depthFunction, "depth function");
+	if (blendSource != UNKNOWN)
+	{
+		valid &= check(GL_BLEND_SRC_RGB, blendSource, "blend source");
+		valid &= check(GL_BLEND_DST_RGB, blendDestination, "blend destination");
+	}
+	if (cullFaceMode != UNKNOWN)
+		valid &= check(GL_CULL_FACE_MODE, cullFaceMode, "cull face");
+	if (viewportBox[2] >= 0)
+	{
+		GLint actual[4];
+		glGetIntegerv(GL_VIEWPORT, actual);
+		if (actual[0] != viewportBox[0] || actual[1] != viewportBox[1] || actual[2] != viewportBox[2] || actual[3] != viewportBox[3])
+		{
+			cerr << "ERROR::GL_STATE::Viewport is not what it was left at" << endl;
+			valid = false;
+		}
+	}
+	return valid;
+}
+
+int GLState::getBufferTarget(GLenum target)
+{
+	for (int i = 0; i < Buffer_LAST; ++i)
+	{
+		if (bufferTargets[i] == target)
+			return i;
+	}
+	return -1;
+}
+
+int GLState::getCapability(GLenum capability)
+{
+	for (int i = 0; i < Capability_LAST; ++i)
+	{
+		if (capabilityNames[i] == capability)
+			return i;
+	}
+	return -1;
+}
+
+void GLState::setActiveTexture(GLuint unit)
+{
+	if (unit == activeTexture)
+	{
+		elided(GL_ACTIVE_TEXTURE, GL_TEXTURE0 + unit);
+		return;
+	}
+	glActiveTexture(GL_TEXTURE0 + unit);
+	activeTexture = unit;
+	RenderStats::current.textureBinds++;
+}
+
+void GLState::elided(GLenum binding, GLint shadowed)
+{
+	RenderStats::current.redundantStateCalls++;
+#ifdef GL_STATE_DEBUG
+	if (binding != GL_NONE)
+		check(binding, shadowed, "binding");
+#endif
+}
+
+bool GLState::check(GLenum binding, GLint shadowed, const char* name)
+{
+	GLint actual = 0;
+	glGetIntegerv(binding, &actual);
+	if (actual == shadowed)
+		return true;
+	cerr << "ERROR::GL_STATE::The " << name << " (0x" << hex << binding << dec << ") is " << actual << ", it was left at " << shadowed << endl;
+	return false;
+}
+
+void GLState::forget(GLuint* bound, size_t count, GLuint name)
+{
+	for (size_t i = 0; i < count; ++i)
+	{
+		if (name != 0 && bound[i] == name)
+			bound[i] = 0;
+	}
+}
@@ -0,0 +1,99 @@
+#ifndef _GL_STATE_H
+#define _GL_STATE_H
+
+#include <GL/glew.h>
+
+// texture units whose GL_TEXTURE_2D binding is shadowed, the rest are passed straight on
+#define GL_STATE_TEXTURE_UNITS 16
+
+// Define GL_STATE_DEBUG to check the shadow against glGet* whenever a call is dropped, and
+// once a frame with validate(). It stalls the pipeline, so it's only for finding whoever
+// changes state behind GLState's back.
+
+// Shadows the GL state the renderer keeps changing and drops the calls that wouldn't change
+// it. Issued calls are counted in RenderStats under the kind of state they change, the ones
+// that were dropped as redundantStateCalls.
+//
+// Only works if everything goes through it. Code that can't, like a library drawing on its
+// own, has to be followed by invalidate(). Objects that might still be bound are deleted
+// through it too, or a new object that gets the same name would look bound already.
+// Nothing is known until the first call for each piece of state, so the first one always goes through.
+class GLState
+{
+public:
+	// forgets everything, for a new context or after something changed state behind our back
+	static void invalidate();
+
+	static void useProgram(GLuint program);
+	// the element array buffer binding is part of the VAO, so it's forgotten with every VAO change
+	static void bindVertexArray(GLuint vertexArray);
+	static void bindBuffer(GLenum target, GLuint buffer);
+	// binds to an indexed binding point, which binds to target as well
+	static void bindBufferBase(GLenum target, GLuint index, GLuint buffer);
+	static void bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+	static void bindTexture(GLuint unit, GLenum target, GLuint texture);
+	// GL_FRAMEBUFFER binds both the draw and the read framebuffer
+	static void bindFramebuffer(GLenum target, GLuint framebuffer);
+
+	static void setEnabled(GLenum capability, bool enabled);
+	static void depthFunc(GLenum func);
+	static void blendFunc(GLenum source, GLenum destination);
+	static void cullFace(GLenum mode);
+	static void viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+
+	static void deleteProgram(GLuint program);
+	static void deleteVertexArrays(GLsizei count, const GLuint* vertexArrays);
+	static void deleteBuffers(GLsizei count, const GLuint* buffers);
+	static void deleteTextures(GLsizei count, const GLuint* textures);
+	static void deleteFramebuffers(GLsizei count, const GLuint* framebuffers);
+
+	// Compares everything that's known with glGet*. Prints what's different, and returns
+	// whether nothing was.
+	static bool validate();
+
+private:
+	enum BufferTarget
+	{
+		Buffer_Array,
+		Buffer_ElementArray,
+		Buffer_Uniform,
+		Buffer_CopyRead,
+		Buffer_CopyWrite,
+		Buffer_PixelUnpack,
+		Buffer_LAST
+	};
+
+	enum Capability
+	{
+		Capability_DepthTest,
+		Capability_Blend,
+		Capability_CullFace,
+		Capability_ScissorTest,
+		Capability_Multisample,
+		Capability_ClipDistance0,
+		Capability_LAST
+	};
+
+	static GLuint program;
+	static GLuint vertexArray;
+	static GLuint buffers[Buffer_LAST];
+	static GLuint activeTexture;	// the unit, not GL_TEXTURE0 + unit
+	static GLuint textures[GL_STATE_TEXTURE_UNITS];
+	static GLuint drawFramebuffer, readFramebuffer;
+	static GLint capabilities[Capability_LAST];	// 0 or 1
+	static GLenum depthFunction;
+	static GLenum blendSource, blendDestination;
+	static GLenum cullFaceMode;
+	static GLint viewportBox[4];
+
+	static int getBufferTarget(GLenum target);
+	static int getCapability(GLenum capability);
+	static void setActiveTexture(GLuint unit);
+	// counts a dropped call, and checks the shadow it was dropped for against what GL has
+	static void elided(GLenum binding, GLint shadowed);
+	static bool check(GLenum binding, GLint shadowed, const char* name);
+	// forget name wherever it's shadowed as bound
+	static void forget(GLuint* bound, size_t count, GLuint name);
+};
+
+#endif
@@ -0,0 +1,147 @@
+#include "JobSystem.h"
+
+#include <stdio.h>
+
+JobSystem::JobSystem(unsigned int numThreads)
+{
+	if (numThreads == 0)
+		numThreads = std::thread::hardware_concurrency();
+	if (numThreads == 0)
+		numThreads = 1;
+
+	for (unsigned int i = 0; i < numThreads; ++i)
+		queues.push_back(new WorkQueue());
+
+	// the calling thread is worker 0, so only start the others
+	for (unsigned int i = 1; i < numThreads; ++i)
+		workers.push_back(std::thread(&JobSystem::workerLoop, this, i));
+}
+
+JobSystem::~JobSystem()
+{
+	workAvailable.shutdown();
+	for (size_t i = 0; i < workers.size(); ++i)
+		workers[i].join();
+
+	for (size_t i = 0; i < queues.size(); ++i)
+		delete queues[i];
+}
+
+void JobSystem::parallelFor(size_t count, size_t minChunk, const function<void(size_t, size_t)>& func)
+{
+	if (count == 0)
+		return;
+	if (minChunk == 0)
+		minChunk = 1;
+
+	// a few chunks per thread leaves something to steal when the chunks don't take equally long
+	size_t numThreads = queues.size();
+	size_t chunk = count / (numThreads * 4);
+	if (chunk < minChunk)
+		chunk = minChunk;
+
+	if (numThreads == 1 || chunk >= count)
+	{
+		func(0, count);
+		return;
+	}
+
+	size_t numChunks = (count + chunk - 1) / chunk;
+	atomic<size_t> pending(numChunks);
+
+	// deal the chunks out round robin so every worker starts with work in its own queue
+	for (size_t i = 0; i < numChunks; ++i)
+	{
+		Job job;
+		job.func = &func;
+		job.begin = i * chunk;
+		job.end = job.begin + chunk < count ? job.begin + chunk : count;
+		job.pending = &pending;
+
+		WorkQueue* queue = queues[i % numThreads];
+		OVR::Mutex::Locker locker(&queue->lock);
+		queue->jobs.push_back(job);
+	}
+	workAvailable.post(numChunks);
+
+	// help out until our chunks are done. Jobs from other parallelFors may get run here too, that's fine.
+	Job job;
+	while (pending.load() > 0)
+	{
+		if (findJob(0, job))
+			run(job);
+		else
+			std::this_thread::yield();
+	}
+}
+
+void JobSystem::workerLoop(unsigned int index)
+{
+	char name[32];
+	snprintf(name, sizeof(name), "JobWorker%u", index);
+	OVR::Thread::SetCurrentThreadName(name);
+
+	Job job;
+	while (workAvailable.wait())
+	{
+		if (findJob(index, job))
+			run(job);
+		else
+		{
+			// it's counted but someone is just taking it, wait() won't sleep until they're done
+			std::this_thread::yield();
+		}
+	}
+}
+
+bool JobSystem::popOwn(unsigned int index, Job& job)
+{
+	WorkQueue* queue = queues[index];
+	OVR::Mutex::Locker locker(&queue->lock);
+	if (queue->jobs.empty())
+		return false;
+
+	// newest first, its data is most likely still in our cache
+	job = queue->jobs.back();
+	queue->jobs.pop_back();
+	return true;
+}
+
+bool JobSystem::steal(unsigned int thief, Job& job)
+{
+	size_t numThreads = queues.size();
+	for (size_t i = 1; i < numThreads; ++i)
+	{
+		WorkQueue* victim = queues[(thief + i) % numThreads];
+		if (!victim->lock.TryLock())
+			continue;
+
+		bool stolen = false;
+		if (!victim->jobs.empty())
+		{
+			// oldest first, the owner is working from the other end
+			job = victim->jobs.front();
+			victim->jobs.pop_front();
+			stolen = true;
+		}
+		victim->lock.Unlock();
+
+		if (stolen)
+			return true;
+	}
+	return false;
+}
+
+bool JobSystem::findJob(unsigned int index, Job& job)
+{
+	if (!popOwn(index, job) && !steal(index, job))
+		return false;
+	workAvailable.take();
+	return true;
+}
+
+void JobSystem::run(const Job& job)
+{
+	(*job.func)(job.begin, job.end);
+	job.pending->fetch_sub(1);
+}
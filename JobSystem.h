@@ -0,0 +1,59 @@
+#ifndef _JOB_SYSTEM_H
+#define _JOB_SYSTEM_H
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <atomic>
+#include <functional>
+
+#include <Kernel/OVR_Threads.h>
+
+#include "WorkSignal.h"
+
+using namespace std;
+
+// Work-stealing thread pool. Every worker owns a queue of jobs: it takes the newest job from
+// its own queue and, when that runs dry, steals the oldest job from another worker's queue.
+// The thread that calls parallelFor works on the jobs too instead of just waiting.
+class JobSystem
+{
+public:
+	// 0 threads means one per hardware thread. The calling thread counts as one of them.
+	JobSystem(unsigned int numThreads = 0);
+	~JobSystem();
+
+	unsigned int getNumThreads() const { return queues.size(); }
+
+	// Calls func(begin, end) over [0, count) split into chunks of at least minChunk items,
+	// and returns once every chunk is done. Small ranges just run on the calling thread.
+	void parallelFor(size_t count, size_t minChunk, const function<void(size_t, size_t)>& func);
+
+private:
+	struct Job
+	{
+		const function<void(size_t, size_t)>* func;
+		size_t begin, end;
+		atomic<size_t>* pending;
+	};
+
+	struct WorkQueue
+	{
+		OVR::Mutex lock;
+		deque<Job> jobs;
+	};
+
+	void workerLoop(unsigned int index);
+	bool popOwn(unsigned int index, Job& job);
+	bool steal(unsigned int thief, Job& job);
+	bool findJob(unsigned int index, Job& job);
+	void run(const Job& job);
+
+	vector<WorkQueue*> queues;	// queue 0 belongs to the thread calling parallelFor
+	vector<std::thread> workers;
+
+	// counts the jobs in every queue, workers sleep on it when there's nothing to steal
+	WorkSignal workAvailable;
+};
+
+#endif
@@ -0,0 +1,40 @@
+#include "LodSelector.h"
+
+#include <algorithm>
+
+using namespace std;
+
+glm::vec3 LodSelector::eye = glm::vec3(0.0f);
+float LodSelector::pixelsPerUnit = 0.0f;
+
+void LodSelector::setView(const glm::mat4& projection, const glm::mat4& view, int viewportHeight)
+{
+	eye = glm::vec3(glm::inverse(view)[3]);
+	// projection[1][1] is cot(fovy / 2), which maps half the viewport height to one unit
+	pixelsPerUnit = projection[1][1] * viewportHeight * 0.5f;
+}
+
+unsigned LodSelector::select(const LodChain& chain, const glm::mat4& toWorld, unsigned current)
+{
+	// nothing to pick from, or no view to pick with yet
+	if (chain.levels <= 1 || pixelsPerUnit <= 0.0f)
+		return 0;
+
+	// the error grows with the largest scale the transform applies
+	float scale = max(glm::length(glm::vec3(toWorld[0])), max(glm::length(glm::vec3(toWorld[1])), glm::length(glm::vec3(toWorld[2]))));
+	glm::vec3 center = glm::vec3(toWorld * glm::vec4(chain.center, 1.0f));
+	float distance = glm::length(center - eye) - chain.radius * scale;
+	// the camera is inside the bounds, draw everything
+	if (distance <= 0.0f)
+		return 0;
+	float pixelsPerObjectUnit = pixelsPerUnit * scale / distance;
+
+	// refine as soon as the current level's error would show, coarsen only once the
+	// next level's error is well under the threshold
+	unsigned level = min(current, chain.levels - 1);
+	while (level > 0 && chain.errors[level] * pixelsPerObjectUnit > LOD_PIXEL_ERROR)
+		level--;
+	while (level + 1 < chain.levels && chain.errors[level + 1] * pixelsPerObjectUnit <= LOD_PIXEL_ERROR * (1.0f - LOD_HYSTERESIS))
+		level++;
+	return level;
+}
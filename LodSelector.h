@@ -0,0 +1,39 @@
+#ifndef _LOD_SELECTOR_H
+#define _LOD_SELECTOR_H
+
+#include <glm/glm.hpp>
+
+// levels in a mesh's LOD chain, the full mesh included
+#define LOD_MAX_LEVELS 4
+// a level is only drawn while its error covers less than this many pixels on screen
+#define LOD_PIXEL_ERROR 1.0f
+// Meshes only switch to a coarser level once its error is this much under LOD_PIXEL_ERROR,
+// so one sitting right at the threshold doesn't pop back and forth every frame
+#define LOD_HYSTERESIS 0.25f
+
+// How far every level of an LOD chain is from the full mesh, and the sphere around the full
+// mesh that distances are measured from. All in object space.
+struct LodChain
+{
+	unsigned levels;
+	float errors[LOD_MAX_LEVELS];	// errors[0] is always 0, and they only ever grow
+	glm::vec3 center;
+	float radius;
+};
+
+// Picks the level of detail things are drawn at from how big their simplification error
+// would be on screen. Needs the camera of the frame being drawn, like FrameUniforms.
+class LodSelector
+{
+public:
+	static void setView(const glm::mat4& projection, const glm::mat4& view, int viewportHeight);
+
+	// the level to draw chain at with toWorld, given the level it was drawn at last time
+	static unsigned select(const LodChain& chain, const glm::mat4& toWorld, unsigned current);
+
+private:
+	static glm::vec3 eye;
+	static float pixelsPerUnit;	// pixels one unit covers one unit in front of the camera
+};
+
+#endif
@@ -0,0 +1,412 @@
+#include "MeshCache.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <iostream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define FNV_OFFSET_BASIS 0xcbf29ce484222325ull
+#define FNV_PRIME 0x100000001b3ull
+
+MappedFile::MappedFile()
+	: data(NULL), size(0)
+#ifdef _WIN32
+	, fileHandle(INVALID_HANDLE_VALUE), mappingHandle(NULL)
+#endif
+{
+}
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+bool MappedFile::open(const string& path)
+{
+	close();
+
+#ifdef _WIN32
+	fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (fileHandle == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart == 0)
+	{
+		close();
+		return false;
+	}
+
+	mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mappingHandle)
+		data = (const unsigned char*)MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+	if (!data)
+	{
+		close();
+		return false;
+	}
+	size = (size_t)fileSize.QuadPart;
+#else
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat info;
+	if (fstat(fd, &info) != 0 || info.st_size == 0)
+	{
+		::close(fd);
+		return false;
+	}
+
+	void* mapping = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	// the mapping keeps the file alive on its own
+	::close(fd);
+	if (mapping == MAP_FAILED)
+		return false;
+
+	data = (const unsigned char*)mapping;
+	size = (size_t)info.st_size;
+#endif
+	return true;
+}
+
+void MappedFile::close()
+{
+#ifdef _WIN32
+	if (data)
+		UnmapViewOfFile(data);
+	if (mappingHandle)
+		CloseHandle(mappingHandle);
+	if (fileHandle != INVALID_HANDLE_VALUE)
+		CloseHandle(fileHandle);
+	mappingHandle = NULL;
+	fileHandle = INVALID_HANDLE_VALUE;
+#else
+	if (data)
+		munmap((void*)data, size);
+#endif
+	data = NULL;
+	size = 0;
+}
+
+bool MeshCache::hashFile(const string& path, uint64_t& hash, uint64_t& size)
+{
+	MappedFile source;
+	if (!source.open(path))
+		return false;
+
+	const unsigned char* bytes = source.getData();
+	size = source.getSize();
+	hash = FNV_OFFSET_BASIS;
+
+	// FNV-1a one 64 bit word at a time instead of one byte at a time, the nanosuit is 21 MB
+	// and this runs on every launch
+	size_t words = size / sizeof(uint64_t);
+	for (size_t i = 0; i < words; ++i)
+	{
+		uint64_t word;
+		memcpy(&word, bytes + i * sizeof(uint64_t), sizeof(word));
+		hash = (hash ^ word) * FNV_PRIME;
+	}
+	for (size_t i = words * sizeof(uint64_t); i < size; ++i)
+		hash = (hash ^ bytes[i]) * FNV_PRIME;
+
+	return true;
+}
+
+// every level has to stay inside its mesh's vertices and indices
+static bool validLods(const CookedMeshRecord& record, const unsigned char* data)
+{
+	const MeshLod* lods = (const MeshLod*)(data + record.lodOffset);
+	for (uint32_t i = 0; i < record.lodCount; ++i)
+	{
+		if ((uint64_t)lods[i].firstVertex + lods[i].vertexCount > record.vertexCount ||
+			(uint64_t)lods[i].firstIndex + lods[i].indexCount > record.indexCount)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+// parents before children, and every mesh hangs off a node that exists
+static bool validNodes(const CookedFileHeader& header, const unsigned char* data)
+{
+	const CookedNode* nodes = (const CookedNode*)(data + header.nodeOffset);
+	for (uint32_t i = 0; i < header.nodeCount; ++i)
+	{
+		if (nodes[i].parent < TRANSFORM_NO_PARENT || nodes[i].parent >= (int32_t)i)
+			return false;
+	}
+
+	const CookedMeshRecord* records = (const CookedMeshRecord*)(data + sizeof(CookedFileHeader));
+	for (uint32_t i = 0; i < header.meshCount; ++i)
+	{
+		if (records[i].node >= header.nodeCount)
+			return false;
+	}
+	return true;
+}
+
+bool MeshCache::open(const string& cookedPath, uint64_t sourceHash, uint64_t sourceSize)
+{
+	close();
+	if (!file.open(cookedPath))
+		return false;
+
+	const unsigned char* data = file.getData();
+	size_t size = file.getSize();
+	if (size < sizeof(CookedFileHeader))
+	{
+		close();
+		return false;
+	}
+
+	const CookedFileHeader& header = *(const CookedFileHeader*)data;
+	if (header.magic != MESH_CACHE_MAGIC || header.version != MESH_CACHE_VERSION ||
+		header.vertexSize != sizeof(Vertex) || header.sourceHash != sourceHash || header.sourceSize != sourceSize ||
+		sizeof(CookedFileHeader) + (uint64_t)header.meshCount * sizeof(CookedMeshRecord) > size)
+	{
+		close();
+		return false;
+	}
+
+	// make sure no record points past the end of the file before anything reads through it
+	const CookedMeshRecord* records = (const CookedMeshRecord*)(data + sizeof(CookedFileHeader));
+	for (unsigned i = 0; i < header.meshCount; ++i)
+	{
+		const CookedMeshRecord& record = records[i];
+		if (record.vertexOffset % MESH_CACHE_ALIGNMENT != 0 || record.indexOffset % MESH_CACHE_ALIGNMENT != 0 ||
+			(record.indexSize != sizeof(GLushort) && record.indexSize != sizeof(GLuint)) ||
+			(record.vertexFormat != VERTEX_FLOAT && record.vertexFormat != VERTEX_PACKED) ||
+			record.vertexOffset + (uint64_t)record.vertexCount * Mesh::getVertexSize((VertexFormat)record.vertexFormat) > size ||
+			record.indexOffset + (uint64_t)record.indexCount * record.indexSize > size ||
+			record.lodOffset % MESH_CACHE_ALIGNMENT != 0 || record.lodCount == 0 || record.lodCount > LOD_MAX_LEVELS ||
+			record.lodOffset + (uint64_t)record.lodCount * sizeof(MeshLod) > size || !validLods(record, data))
+		{
+			cerr << "ERROR::MESH_CACHE::" << cookedPath << " is corrupt" << endl;
+			close();
+			return false;
+		}
+	}
+
+	if (header.nodeOffset % MESH_CACHE_ALIGNMENT != 0 || header.nodeOffset + (uint64_t)header.nodeCount * sizeof(CookedNode) > size ||
+		!validNodes(header, data))
+	{
+		cerr << "ERROR::MESH_CACHE::" << cookedPath << " is corrupt" << endl;
+		close();
+		return false;
+	}
+
+	meshCount = header.meshCount;
+	nodeCount = header.nodeCount;
+	return true;
+}
+
+const CookedMeshRecord& MeshCache::getMesh(unsigned i) const
+{
+	const CookedMeshRecord* records = (const CookedMeshRecord*)(file.getData() + sizeof(CookedFileHeader));
+	return records[i];
+}
+
+ModelNode MeshCache::getNode(unsigned i) const
+{
+	const CookedNode& cooked = ((const CookedNode*)(file.getData() + ((const CookedFileHeader*)file.getData())->nodeOffset))[i];
+
+	ModelNode node;
+	node.parent = cooked.parent;
+	node.local.translation = glm::vec3(cooked.translation[0], cooked.translation[1], cooked.translation[2]);
+	node.local.rotation = glm::quat(cooked.rotation[0], cooked.rotation[1], cooked.rotation[2], cooked.rotation[3]);
+	node.local.scale = glm::vec3(cooked.scale[0], cooked.scale[1], cooked.scale[2]);
+	return node;
+}
+
+MeshSource MeshCache::getSource(unsigned i) const
+{
+	const CookedMeshRecord& record = getMesh(i);
+
+	MeshSource source;
+	source.vertices = file.getData() + record.vertexOffset;
+	source.vertexFormat = (VertexFormat)record.vertexFormat;
+	source.vertexCount = record.vertexCount;
+	source.indices = file.getData() + record.indexOffset;
+	source.indexType = record.indexSize == sizeof(GLushort) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+	source.indexCount = record.indexCount;
+	source.positionScale = glm::vec3(record.positionScale[0], record.positionScale[1], record.positionScale[2]);
+	source.positionOffset = glm::vec3(record.positionOffset[0], record.positionOffset[1], record.positionOffset[2]);
+	source.lods = (const MeshLod*)(file.getData() + record.lodOffset);
+	source.lodCount = record.lodCount;
+	source.bounds.center = glm::vec3(record.boundsCenter[0], record.boundsCenter[1], record.boundsCenter[2]);
+	source.bounds.radius = record.boundsRadius;
+	source.bounds.min = glm::vec3(record.boundsMin[0], record.boundsMin[1], record.boundsMin[2]);
+	source.bounds.max = glm::vec3(record.boundsMax[0], record.boundsMax[1], record.boundsMax[2]);
+	return source;
+}
+
+static uint64_t alignOffset(uint64_t offset)
+{
+	return (offset + MESH_CACHE_ALIGNMENT - 1) / MESH_CACHE_ALIGNMENT * MESH_CACHE_ALIGNMENT;
+}
+
+static bool writePadded(FILE* file, const void* data, size_t size, uint64_t& offset)
+{
+	static const unsigned char zeros[MESH_CACHE_ALIGNMENT] = {};
+
+	if (size > 0 && fwrite(data, 1, size, file) != size)
+		return false;
+	offset += size;
+
+	size_t padding = (size_t)(alignOffset(offset) - offset);
+	if (padding > 0 && fwrite(zeros, 1, padding, file) != padding)
+		return false;
+	offset += padding;
+	return true;
+}
+
+// the box around every position in the file, as the scale and offset PackedVertex positions use
+static void getPositionBox(const vector<MeshData>& meshes, glm::vec3& scale, glm::vec3& offset)
+{
+	glm::vec3 low(0.0f), high(0.0f);
+	bool empty = true;
+	for (size_t i = 0; i < meshes.size(); ++i)
+	{
+		for (size_t j = 0; j < meshes[i].vertices.size(); ++j)
+		{
+			const glm::vec3& position = meshes[i].vertices[j].position;
+			low = empty ? position : glm::min(low, position);
+			high = empty ? position : glm::max(high, position);
+			empty = false;
+		}
+	}
+	offset = (low + high) * 0.5f;
+	scale = (high - low) * 0.5f;
+}
+
+bool MeshCache::write(const string& cookedPath, uint64_t sourceHash, uint64_t sourceSize,
+	const vector<MeshData>& meshes, const vector<ModelNode>& nodes, VertexFormat format)
+{
+	glm::vec3 positionScale(1.0f), positionOffset(0.0f);
+	if (format == VERTEX_PACKED)
+		getPositionBox(meshes, positionScale, positionOffset);
+	GLsizei vertexSize = Mesh::getVertexSize(format);
+
+	CookedFileHeader header;
+	memset(&header, 0, sizeof(header));
+	header.version = MESH_CACHE_VERSION;
+	header.sourceHash = sourceHash;
+	header.sourceSize = sourceSize;
+	header.meshCount = (uint32_t)meshes.size();
+	header.vertexSize = sizeof(Vertex);
+	header.nodeCount = (uint32_t)nodes.size();
+
+	vector<CookedNode> cookedNodes(nodes.size());
+	for (size_t i = 0; i < nodes.size(); ++i)
+	{
+		const Transform& local = nodes[i].local;
+		cookedNodes[i].parent = nodes[i].parent;
+		memcpy(cookedNodes[i].translation, &local.translation[0], sizeof(cookedNodes[i].translation));
+		cookedNodes[i].rotation[0] = local.rotation.w;
+		cookedNodes[i].rotation[1] = local.rotation.x;
+		cookedNodes[i].rotation[2] = local.rotation.y;
+		cookedNodes[i].rotation[3] = local.rotation.z;
+		memcpy(cookedNodes[i].scale, &local.scale[0], sizeof(cookedNodes[i].scale));
+	}
+
+	// lay out the blocks first so the records can be written before the data they point at
+	vector<CookedMeshRecord> records(meshes.size());
+	uint64_t offset = alignOffset(sizeof(CookedFileHeader) + records.size() * sizeof(CookedMeshRecord));
+	header.nodeOffset = offset;
+	offset = alignOffset(offset + cookedNodes.size() * sizeof(CookedNode));
+	for (size_t i = 0; i < meshes.size(); ++i)
+	{
+		const MeshData& mesh = meshes[i];
+		CookedMeshRecord& record = records[i];
+		memset(&record, 0, sizeof(record));
+
+		record.vertexCount = (uint32_t)mesh.vertices.size();
+		record.indexCount = (uint32_t)mesh.indices.size();
+		record.indexSize = Mesh::fitsShortIndices(mesh.vertices.size()) ? sizeof(GLushort) : sizeof(GLuint);
+		record.vertexFormat = format;
+		record.vertexOffset = offset;
+		offset = alignOffset(offset + mesh.vertices.size() * vertexSize);
+		record.indexOffset = offset;
+		offset = alignOffset(offset + mesh.indices.size() * record.indexSize);
+		record.lodCount = mesh.lods.empty() ? 1 : (uint32_t)mesh.lods.size();
+		record.lodOffset = offset;
+		offset = alignOffset(offset + record.lodCount * sizeof(MeshLod));
+
+		memcpy(record.ambient, &mesh.ambient[0], sizeof(record.ambient));
+		memcpy(record.diffuse, &mesh.diffuse[0], sizeof(record.diffuse));
+		memcpy(record.specular, &mesh.specular[0], sizeof(record.specular));
+		record.shininess = mesh.shininess;
+		memcpy(record.positionScale, &positionScale[0], sizeof(record.positionScale));
+		memcpy(record.positionOffset, &positionOffset[0], sizeof(record.positionOffset));
+		memcpy(record.boundsCenter, &mesh.bounds.center[0], sizeof(record.boundsCenter));
+		record.boundsRadius = mesh.bounds.radius;
+		memcpy(record.boundsMin, &mesh.bounds.min[0], sizeof(record.boundsMin));
+		memcpy(record.boundsMax, &mesh.bounds.max[0], sizeof(record.boundsMax));
+		record.node = mesh.node;
+	}
+
+	FILE* file = fopen(cookedPath.c_str(), "wb");
+	if (!file)
+		return false;
+
+	// the magic stays zero until everything else is on disk, so a cook that dies
+	// halfway leaves a file that open() rejects
+	uint64_t written = 0;
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+	written += sizeof(header);
+	ok = ok && writePadded(file, records.data(), records.size() * sizeof(CookedMeshRecord), written);
+	ok = ok && writePadded(file, cookedNodes.data(), cookedNodes.size() * sizeof(CookedNode), written);
+	for (size_t i = 0; ok && i < meshes.size(); ++i)
+	{
+		if (format == VERTEX_PACKED)
+		{
+			vector<PackedVertex> packed;
+			packed.reserve(meshes[i].vertices.size());
+			for (size_t j = 0; j < meshes[i].vertices.size(); ++j)
+				packed.push_back(Mesh::packVertex(meshes[i].vertices[j], positionScale, positionOffset));
+			ok = writePadded(file, packed.data(), packed.size() * sizeof(PackedVertex), written);
+		}
+		else
+		{
+			ok = writePadded(file, meshes[i].vertices.data(), meshes[i].vertices.size() * sizeof(Vertex), written);
+		}
+		if (records[i].indexSize == sizeof(GLushort))
+		{
+			vector<GLushort> shortIndices(meshes[i].indices.begin(), meshes[i].indices.end());
+			ok = ok && writePadded(file, shortIndices.data(), shortIndices.size() * sizeof(GLushort), written);
+		}
+		else
+		{
+			ok = ok && writePadded(file, meshes[i].indices.data(), meshes[i].indices.size() * sizeof(GLuint), written);
+		}
+		// a mesh that was never simplified is just its one full level
+		MeshLod full = { 0, (GLuint)meshes[i].vertices.size(), 0, (GLuint)meshes[i].indices.size(), 0.0f };
+		const MeshLod* lods = meshes[i].lods.empty() ? &full : meshes[i].lods.data();
+		ok = ok && writePadded(file, lods, records[i].lodCount * sizeof(MeshLod), written);
+	}
+
+	header.magic = MESH_CACHE_MAGIC;
+	ok = ok && fflush(file) == 0 && fseek(file, 0, SEEK_SET) == 0 && fwrite(&header.magic, sizeof(header.magic), 1, file) == 1;
+	ok = fclose(file) == 0 && ok;
+
+	if (!ok)
+	{
+		cerr << "ERROR::MESH_CACHE::Failed to write " << cookedPath << endl;
+		remove(cookedPath.c_str());
+	}
+	return ok;
+}
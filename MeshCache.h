@@ -0,0 +1,153 @@
+#ifndef _MESH_CACHE_H
+#define _MESH_CACHE_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "mesh.h"
+#include "TransformHierarchy.h"
+
+// "MESH" in a little endian file
+#define MESH_CACHE_MAGIC 0x4853454du
+// bump this whenever the layout below, Vertex or the Assimp import flags change
+#define MESH_CACHE_VERSION 7u
+#define MESH_CACHE_EXTENSION ".cooked"
+// every vertex and index block starts on this boundary
+#define MESH_CACHE_ALIGNMENT 16
+// what models cooked while loading use, --cook can pick either
+#define MESH_DEFAULT_VERTEX_FORMAT VERTEX_PACKED
+
+using namespace std;
+
+// One node of a model's node tree, as Model::processNode finds it. Parents always come
+// before their children.
+struct ModelNode
+{
+	int parent;	// TRANSFORM_NO_PARENT for the root
+	Transform local;
+};
+
+// What Model::processMesh produces for one mesh, before anything is uploaded to GL.
+// indices are always 32 bit here, they're only narrowed when written or uploaded.
+struct MeshData
+{
+	vector<Vertex> vertices;
+	vector<GLuint> indices;
+	glm::vec3 ambient, diffuse, specular;
+	float shininess;
+	// every level of detail, each one's vertices and indices following the one before it
+	vector<MeshLod> lods;
+	MeshBounds bounds;	// of the full mesh
+	unsigned node;	// the ModelNode the mesh hangs off
+};
+
+// The cooked file is a CookedFileHeader, then meshCount CookedMeshRecords, then the node
+// tree and the vertex and index blocks they point at. Everything is stored exactly as GL wants it, so a
+// mapped file can be handed to glBufferData without touching the vertices. The vertices are
+// either Vertex or PackedVertex, whichever format the file was cooked with.
+struct CookedFileHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint64_t sourceHash;	// of the source file's contents
+	uint64_t sourceSize;
+	uint32_t meshCount;
+	uint32_t vertexSize;	// sizeof(Vertex) when the file was cooked
+	uint64_t nodeOffset;	// nodeCount CookedNodes
+	uint32_t nodeCount;
+	uint32_t padding;
+};
+
+struct CookedNode
+{
+	int32_t parent;
+	float translation[3];
+	float rotation[4];	// w, x, y, z
+	float scale[3];
+};
+
+struct CookedMeshRecord
+{
+	uint64_t vertexOffset;	// from the start of the file
+	uint64_t indexOffset;
+	uint32_t vertexCount;
+	uint32_t indexCount;
+	uint32_t indexSize;	// 2 when the mesh fits 16 bit indices, 4 otherwise
+	uint32_t vertexFormat;	// a VertexFormat
+	float ambient[3];
+	float diffuse[3];
+	float specular[3];
+	float shininess;
+	// Packed positions are scaled into this box. It's the same for every mesh in a file, so
+	// vertices that meshes share at their seams still land in exactly the same place.
+	float positionScale[3];
+	float positionOffset[3];
+	uint64_t lodOffset;	// lodCount MeshLods, the full mesh first
+	uint32_t lodCount;
+	float boundsCenter[3];
+	float boundsRadius;
+	float boundsMin[3];
+	float boundsMax[3];
+	uint32_t node;
+};
+
+// A read only view of a whole file, mapped into memory instead of read into a buffer
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool open(const string& path);
+	void close();
+
+	const unsigned char* getData() const { return data; }
+	size_t getSize() const { return size; }
+
+private:
+	const unsigned char* data;
+	size_t size;
+#ifdef _WIN32
+	void* fileHandle;
+	void* mappingHandle;
+#endif
+};
+
+// Reads and writes the cooked copy of a model that sits next to its source file
+class MeshCache
+{
+public:
+	static string getCookedPath(const string& sourcePath) { return sourcePath + MESH_CACHE_EXTENSION; }
+
+	// 64 bit FNV-1a of a file's contents. Returns false if the file can't be read.
+	static bool hashFile(const string& path, uint64_t& hash, uint64_t& size);
+
+	// Maps a cooked file. Fails if it's missing, truncated, from another version or cooked
+	// from a source with a different hash, which all mean the source has to be imported again.
+	bool open(const string& cookedPath, uint64_t sourceHash, uint64_t sourceSize);
+	void close() { file.close(); meshCount = 0; nodeCount = 0; }
+	bool isOpen() const { return file.getData() != NULL; }
+
+	unsigned getMeshCount() const { return meshCount; }
+	unsigned getNodeCount() const { return nodeCount; }
+	ModelNode getNode(unsigned i) const;
+	const CookedMeshRecord& getMesh(unsigned i) const;
+	// points straight into the mapped file and is only valid until close()
+	MeshSource getSource(unsigned i) const;
+
+	static bool write(const string& cookedPath, uint64_t sourceHash, uint64_t sourceSize,
+		const vector<MeshData>& meshes, const vector<ModelNode>& nodes, VertexFormat format);
+
+private:
+	MappedFile file;
+	unsigned meshCount = 0;
+	unsigned nodeCount = 0;
+};
+
+#endif
@@ -0,0 +1,332 @@
+#include "MeshOptimizer.h"
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <unordered_map>
+
+// Forsyth's scoring constants, from "Linear-Speed Vertex Cache Optimisation"
+#define FORSYTH_CACHE_DECAY_POWER 1.5f
+#define FORSYTH_LAST_TRI_SCORE 0.75f
+#define FORSYTH_VALENCE_BOOST_SCALE 2.0f
+#define FORSYTH_VALENCE_BOOST_POWER 0.5f
+// vertices with more triangles left than this all get the same valence boost
+#define FORSYTH_MAX_VALENCE 32
+
+void MeshOptimizerStats::add(const MeshOptimizerStats& other)
+{
+	triangles += other.triangles;
+	verticesBefore += other.verticesBefore;
+	verticesAfter += other.verticesAfter;
+	missesBefore += other.missesBefore;
+	missesAfter += other.missesAfter;
+}
+
+MeshOptimizerStats MeshOptimizer::optimize(MeshData& mesh)
+{
+	MeshOptimizerStats stats;
+	stats.triangles = mesh.indices.size() / 3;
+	stats.verticesBefore = mesh.vertices.size();
+	stats.missesBefore = countCacheMisses(mesh.indices, mesh.vertices.size(), MEASURE_CACHE_SIZE);
+
+	weldVertices(mesh);
+	optimizeVertexCache(mesh.indices, mesh.vertices.size());
+	optimizeOverdraw(mesh.indices, mesh.vertices);
+	optimizeVertexFetch(mesh);
+
+	stats.verticesAfter = mesh.vertices.size();
+	stats.missesAfter = countCacheMisses(mesh.indices, mesh.vertices.size(), MEASURE_CACHE_SIZE);
+	return stats;
+}
+
+// Vertex has no padding, so two vertices are the same exactly when their bytes are
+struct VertexBytesHash
+{
+	size_t operator()(const Vertex& vertex) const
+	{
+		const unsigned char* bytes = (const unsigned char*)&vertex;
+		size_t hash = 2166136261u;
+		for (size_t i = 0; i < sizeof(Vertex); ++i)
+			hash = (hash ^ bytes[i]) * 16777619u;
+		return hash;
+	}
+};
+
+struct VertexBytesEqual
+{
+	bool operator()(const Vertex& a, const Vertex& b) const
+	{
+		return memcmp(&a, &b, sizeof(Vertex)) == 0;
+	}
+};
+
+void MeshOptimizer::weldVertices(MeshData& mesh)
+{
+	unordered_map<Vertex, GLuint, VertexBytesHash, VertexBytesEqual> unique;
+	unique.reserve(mesh.vertices.size());
+
+	vector<Vertex> welded;
+	vector<GLuint> remap(mesh.vertices.size());
+	for (size_t i = 0; i < mesh.vertices.size(); ++i)
+	{
+		pair<unordered_map<Vertex, GLuint, VertexBytesHash, VertexBytesEqual>::iterator, bool> found =
+			unique.insert(make_pair(mesh.vertices[i], (GLuint)welded.size()));
+		if (found.second)
+			welded.push_back(mesh.vertices[i]);
+		remap[i] = found.first->second;
+	}
+
+	for (size_t i = 0; i < mesh.indices.size(); ++i)
+		mesh.indices[i] = remap[mesh.indices[i]];
+	mesh.vertices.swap(welded);
+}
+
+void MeshOptimizer::optimizeVertexCache(vector<GLuint>& indices, size_t vertexCount)
+{
+	size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0)
+		return;
+
+	// the scores only depend on small integers, so look them up instead of calling pow
+	float cacheScores[FORSYTH_CACHE_SIZE];
+	for (int i = 0; i < FORSYTH_CACHE_SIZE; ++i)
+	{
+		// the last triangle's vertices get a fixed score, so it doesn't matter which order they went in
+		if (i < 3)
+			cacheScores[i] = FORSYTH_LAST_TRI_SCORE;
+		else
+			cacheScores[i] = powf(1.0f - (float)(i - 3) / (FORSYTH_CACHE_SIZE - 3), FORSYTH_CACHE_DECAY_POWER);
+	}
+	float valenceScores[FORSYTH_MAX_VALENCE + 1];
+	valenceScores[0] = 0.0f;
+	for (int i = 1; i <= FORSYTH_MAX_VALENCE; ++i)
+		valenceScores[i] = FORSYTH_VALENCE_BOOST_SCALE * powf((float)i, -FORSYTH_VALENCE_BOOST_POWER);
+
+	// every vertex's triangles, packed into one array
+	vector<unsigned> remaining(vertexCount, 0);
+	for (size_t i = 0; i < indices.size(); ++i)
+		remaining[indices[i]]++;
+	vector<size_t> adjacencyStart(vertexCount + 1, 0);
+	for (size_t v = 0; v < vertexCount; ++v)
+		adjacencyStart[v + 1] = adjacencyStart[v] + remaining[v];
+	vector<size_t> adjacency(indices.size());
+	vector<size_t> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+	for (size_t i = 0; i < indices.size(); ++i)
+		adjacency[fill[indices[i]]++] = i / 3;
+
+	vector<int> cachePosition(vertexCount, -1);
+	vector<float> vertexScores(vertexCount);
+	for (size_t v = 0; v < vertexCount; ++v)
+		vertexScores[v] = remaining[v] ? valenceScores[min(remaining[v], (unsigned)FORSYTH_MAX_VALENCE)] : -1.0f;
+
+	vector<float> triangleScores(triangleCount);
+	vector<bool> emitted(triangleCount, false);
+	size_t best = 0;
+	for (size_t t = 0; t < triangleCount; ++t)
+	{
+		triangleScores[t] = vertexScores[indices[3 * t]] + vertexScores[indices[3 * t + 1]] + vertexScores[indices[3 * t + 2]];
+		if (triangleScores[t] > triangleScores[best])
+			best = t;
+	}
+
+	vector<GLuint> optimized;
+	optimized.reserve(indices.size());
+	vector<GLuint> cache, nextCache;
+	cache.reserve(FORSYTH_CACHE_SIZE + 3);
+	nextCache.reserve(FORSYTH_CACHE_SIZE + 3);
+	size_t cursor = 0;	// nothing before this is left to emit
+
+	for (size_t emittedCount = 0; emittedCount < triangleCount; ++emittedCount)
+	{
+		// nothing in the cache has triangles left, so start over at the first triangle that's left
+		if (best == (size_t)-1)
+		{
+			while (emitted[cursor])
+				cursor++;
+			best = cursor;
+		}
+
+		const GLuint* triangle = &indices[3 * best];
+		emitted[best] = true;
+		optimized.insert(optimized.end(), triangle, triangle + 3);
+
+		// this triangle's vertices go to the front of the cache, and it's no longer left for them
+		nextCache.assign(triangle, triangle + 3);
+		for (int i = 0; i < 3; ++i)
+		{
+			GLuint v = triangle[i];
+			size_t* begin = &adjacency[adjacencyStart[v]];
+			size_t* end = begin + remaining[v];
+			*find(begin, end, best) = *(end - 1);
+			remaining[v]--;
+		}
+		for (size_t i = 0; i < cache.size(); ++i)
+		{
+			if (cache[i] != triangle[0] && cache[i] != triangle[1] && cache[i] != triangle[2])
+				nextCache.push_back(cache[i]);
+		}
+		cache.swap(nextCache);
+
+		// rescore everything that moved in the cache, including what just fell out of it
+		for (size_t i = 0; i < cache.size(); ++i)
+		{
+			GLuint v = cache[i];
+			cachePosition[v] = i < FORSYTH_CACHE_SIZE ? (int)i : -1;
+
+			float score = -1.0f;
+			if (remaining[v])
+			{
+				score = valenceScores[min(remaining[v], (unsigned)FORSYTH_MAX_VALENCE)];
+				if (cachePosition[v] >= 0)
+					score += cacheScores[cachePosition[v]];
+			}
+
+			float delta = score - vertexScores[v];
+			vertexScores[v] = score;
+			for (size_t j = 0; j < remaining[v]; ++j)
+				triangleScores[adjacency[adjacencyStart[v] + j]] += delta;
+		}
+		if (cache.size() > FORSYTH_CACHE_SIZE)
+			cache.resize(FORSYTH_CACHE_SIZE);
+
+		// the next triangle is the best one that uses a vertex in the cache
+		best = (size_t)-1;
+		float bestScore = -1e30f;
+		for (size_t i = 0; i < cache.size(); ++i)
+		{
+			GLuint v = cache[i];
+			for (size_t j = 0; j < remaining[v]; ++j)
+			{
+				size_t t = adjacency[adjacencyStart[v] + j];
+				if (triangleScores[t] > bestScore)
+				{
+					bestScore = triangleScores[t];
+					best = t;
+				}
+			}
+		}
+	}
+
+	indices.swap(optimized);
+}
+
+struct TriangleCluster
+{
+	size_t begin, end;	// in triangles
+	float sortKey;
+};
+
+void MeshOptimizer::optimizeOverdraw(vector<GLuint>& indices, const vector<Vertex>& vertices)
+{
+	size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0)
+		return;
+
+	// A triangle that misses on all three vertices starts from a cold cache, so cutting there
+	// and moving the pieces around costs (almost) no vertex cache hits
+	vector<TriangleCluster> clusters;
+	vector<size_t> stamps(vertices.size(), 0);
+	size_t misses = 0;
+	for (size_t t = 0; t < triangleCount; ++t)
+	{
+		int triangleMisses = 0;
+		for (int i = 0; i < 3; ++i)
+		{
+			GLuint v = indices[3 * t + i];
+			if (stamps[v] == 0 || misses - stamps[v] >= MEASURE_CACHE_SIZE)
+			{
+				stamps[v] = ++misses;
+				triangleMisses++;
+			}
+		}
+		if (t == 0 || triangleMisses == 3)
+		{
+			if (!clusters.empty())
+				clusters.back().end = t;
+			TriangleCluster cluster;
+			cluster.begin = t;
+			cluster.end = triangleCount;
+			cluster.sortKey = 0.0f;
+			clusters.push_back(cluster);
+		}
+	}
+	if (clusters.size() < 2)
+		return;
+
+	// area weighted centre and facing of every cluster, and the centre of the whole mesh
+	vector<glm::vec3> centres(clusters.size()), normals(clusters.size());
+	glm::vec3 meshCentre(0.0f);
+	float meshArea = 0.0f;
+	for (size_t c = 0; c < clusters.size(); ++c)
+	{
+		glm::vec3 centre(0.0f), normal(0.0f);
+		float area = 0.0f;
+		for (size_t t = clusters[c].begin; t < clusters[c].end; ++t)
+		{
+			const glm::vec3& a = vertices[indices[3 * t]].position;
+			const glm::vec3& b = vertices[indices[3 * t + 1]].position;
+			const glm::vec3& d = vertices[indices[3 * t + 2]].position;
+			glm::vec3 cross = glm::cross(b - a, d - a);
+			float triangleArea = glm::length(cross);
+			centre += (a + b + d) * (triangleArea / 3.0f);
+			normal += cross;
+			area += triangleArea;
+		}
+		meshCentre += centre;
+		meshArea += area;
+		centres[c] = area > 0.0f ? centre / area : centre;
+		normals[c] = normal;
+	}
+	if (meshArea > 0.0f)
+		meshCentre /= meshArea;
+
+	// the further out a cluster is and the more it faces outwards, the more it can hide
+	for (size_t c = 0; c < clusters.size(); ++c)
+	{
+		float length = glm::length(normals[c]);
+		clusters[c].sortKey = length > 0.0f ? glm::dot(centres[c] - meshCentre, normals[c] / length) : 0.0f;
+	}
+	stable_sort(clusters.begin(), clusters.end(),
+		[](const TriangleCluster& a, const TriangleCluster& b) { return a.sortKey > b.sortKey; });
+
+	vector<GLuint> sorted;
+	sorted.reserve(indices.size());
+	for (size_t c = 0; c < clusters.size(); ++c)
+		sorted.insert(sorted.end(), indices.begin() + 3 * clusters[c].begin, indices.begin() + 3 * clusters[c].end);
+	indices.swap(sorted);
+}
+
+void MeshOptimizer::optimizeVertexFetch(MeshData& mesh)
+{
+	const GLuint unused = (GLuint)-1;
+	vector<GLuint> remap(mesh.vertices.size(), unused);
+	vector<Vertex> fetched;
+	fetched.reserve(mesh.vertices.size());
+
+	// vertices no triangle uses are dropped here too
+	for (size_t i = 0; i < mesh.indices.size(); ++i)
+	{
+		GLuint& index = mesh.indices[i];
+		if (remap[index] == unused)
+		{
+			remap[index] = (GLuint)fetched.size();
+			fetched.push_back(mesh.vertices[index]);
+		}
+		index = remap[index];
+	}
+	mesh.vertices.swap(fetched);
+}
+
+size_t MeshOptimizer::countCacheMisses(const vector<GLuint>& indices, size_t vertexCount, unsigned cacheSize)
+{
+	// a vertex is still cached if fewer than cacheSize misses came after its own
+	vector<size_t> stamps(vertexCount, 0);
+	size_t misses = 0;
+	for (size_t i = 0; i < indices.size(); ++i)
+	{
+		GLuint v = indices[i];
+		if (stamps[v] == 0 || misses - stamps[v] >= cacheSize)
+			stamps[v] = ++misses;
+	}
+	return misses;
+}
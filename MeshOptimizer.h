@@ -0,0 +1,55 @@
+#ifndef _MESH_OPTIMIZER_H
+#define _MESH_OPTIMIZER_H
+
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "MeshCache.h"
+
+// entries in the LRU cache the Forsyth scores are tuned for
+#define FORSYTH_CACHE_SIZE 32
+// entries in the FIFO cache ACMR and ATVR are measured with, about what older GPUs have
+#define MEASURE_CACHE_SIZE 16
+
+using namespace std;
+
+// Counts that add up over every mesh of an asset. ACMR is vertex shader runs per triangle
+// (0.5 is perfect, 3 is no reuse at all), ATVR is runs per unique vertex (1 is perfect).
+struct MeshOptimizerStats
+{
+	size_t triangles;
+	size_t verticesBefore, verticesAfter;
+	size_t missesBefore, missesAfter;
+
+	float getACMRBefore() const { return triangles ? (float)missesBefore / triangles : 0.0f; }
+	float getACMRAfter() const { return triangles ? (float)missesAfter / triangles : 0.0f; }
+	float getATVRBefore() const { return verticesBefore ? (float)missesBefore / verticesBefore : 0.0f; }
+	float getATVRAfter() const { return verticesAfter ? (float)missesAfter / verticesAfter : 0.0f; }
+
+	void add(const MeshOptimizerStats& other);
+};
+
+// Rewrites imported meshes so the GPU does less work drawing them. Only the order and
+// sharing of vertices and triangles change, never what's drawn.
+class MeshOptimizer
+{
+public:
+	// All the passes below in order, returns the ACMR/ATVR counts from before and after
+	static MeshOptimizerStats optimize(MeshData& mesh);
+
+	// Merges vertices that are identical in every attribute
+	static void weldVertices(MeshData& mesh);
+	// Tom Forsyth's linear-speed vertex cache optimisation
+	static void optimizeVertexCache(vector<GLuint>& indices, size_t vertexCount);
+	// Cuts the triangles into clusters where the vertex cache starts over anyway, then draws
+	// the clusters facing away from the middle of the mesh first, so they hide what's behind them
+	static void optimizeOverdraw(vector<GLuint>& indices, const vector<Vertex>& vertices);
+	// Puts the vertices in the order the triangles first use them
+	static void optimizeVertexFetch(MeshData& mesh);
+
+	// vertex shader runs for indices with a FIFO post-transform cache of cacheSize entries
+	static size_t countCacheMisses(const vector<GLuint>& indices, size_t vertexCount, unsigned cacheSize);
+};
+
+#endif
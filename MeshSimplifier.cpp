@@ -0,0 +1,438 @@
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <unordered_map>
+
+// Sum of squared distances to a set of planes, as the symmetric 4x4 matrix of the planes'
+// outer products. Doubles, since errors are differences of large sums.
+struct Quadric
+{
+	double a00, a01, a02, a03, a11, a12, a13, a22, a23, a33;
+
+	Quadric() { memset(this, 0, sizeof(*this)); }
+
+	// the plane dot(normal, p) + d = 0, with a unit normal
+	void addPlane(const glm::vec3& normal, float d, float weight)
+	{
+		double x = normal.x, y = normal.y, z = normal.z, w = d;
+		a00 += weight * x * x; a01 += weight * x * y; a02 += weight * x * z; a03 += weight * x * w;
+		a11 += weight * y * y; a12 += weight * y * z; a13 += weight * y * w;
+		a22 += weight * z * z; a23 += weight * z * w;
+		a33 += weight * w * w;
+	}
+
+	void add(const Quadric& other)
+	{
+		a00 += other.a00; a01 += other.a01; a02 += other.a02; a03 += other.a03;
+		a11 += other.a11; a12 += other.a12; a13 += other.a13;
+		a22 += other.a22; a23 += other.a23;
+		a33 += other.a33;
+	}
+
+	double evaluate(const glm::vec3& p) const
+	{
+		double x = p.x, y = p.y, z = p.z;
+		double error = a00 * x * x + 2.0 * a01 * x * y + 2.0 * a02 * x * z + 2.0 * a03 * x
+			+ a11 * y * y + 2.0 * a12 * y * z + 2.0 * a13 * y
+			+ a22 * z * z + 2.0 * a23 * z
+			+ a33;
+		// rounding can take it just under zero
+		return error > 0.0 ? error : 0.0;
+	}
+};
+
+// moving every vertex at position from onto position to, for cost
+struct Collapse
+{
+	double cost;
+	unsigned from, to;
+	unsigned fromVersion, toVersion;	// the collapse is stale once either position changes
+
+	bool operator>(const Collapse& other) const { return cost > other.cost; }
+};
+
+struct SimplifyTriangle
+{
+	unsigned positions[3];	// into the shared positions, these change as edges collapse
+	unsigned vertices[3];	// the original corners, for their normals and texture coordinates
+	bool alive;
+};
+
+struct PositionHash
+{
+	size_t operator()(const glm::vec3& p) const
+	{
+		const unsigned char* bytes = (const unsigned char*)&p;
+		size_t hash = 2166136261u;
+		for (size_t i = 0; i < sizeof(p); ++i)
+			hash = (hash ^ bytes[i]) * 16777619u;
+		return hash;
+	}
+};
+
+// State of one simplification run, from the full mesh down to the coarsest level
+class Simplification
+{
+public:
+	Simplification(const MeshData& mesh);
+
+	// collapses edges until at most targetTriangles are left, or nothing more can go
+	void run(size_t targetTriangles);
+	size_t getTriangleCount() const { return triangleCount; }
+	// the biggest collapse cost so far, as a distance
+	float getError() const { return (float)sqrt(maxCost); }
+	// the mesh as it is now, welded and optimized
+	MeshData getLevel() const;
+
+private:
+	const MeshData& mesh;
+	vector<glm::vec3> positions;
+	vector<Quadric> quadrics;
+	vector<unsigned> versions;
+	vector<bool> collapsed;
+	vector<vector<unsigned>> positionTriangles;	// can still list dead triangles
+	vector<SimplifyTriangle> triangles;
+	size_t triangleCount;
+	double maxCost;
+	priority_queue<Collapse, vector<Collapse>, greater<Collapse>> queue;
+
+	void addCollapse(unsigned a, unsigned b);
+	void getNeighbours(unsigned position, vector<unsigned>& neighbours) const;
+	bool canCollapse(unsigned from, unsigned to) const;
+	void collapse(unsigned from, unsigned to);
+};
+
+static glm::vec3 getNormal(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c)
+{
+	return glm::cross(b - a, c - a);
+}
+
+Simplification::Simplification(const MeshData& mesh)
+	: mesh(mesh), triangleCount(0), maxCost(0.0)
+{
+	// vertices that only differ in their normal or texture coordinates move together
+	unordered_map<glm::vec3, unsigned, PositionHash> uniquePositions;
+	vector<unsigned> vertexPositions(mesh.vertices.size());
+	for (size_t i = 0; i < mesh.vertices.size(); ++i)
+	{
+		pair<unordered_map<glm::vec3, unsigned, PositionHash>::iterator, bool> found =
+			uniquePositions.insert(make_pair(mesh.vertices[i].position, (unsigned)positions.size()));
+		if (found.second)
+			positions.push_back(mesh.vertices[i].position);
+		vertexPositions[i] = found.first->second;
+	}
+
+	quadrics.resize(positions.size());
+	versions.assign(positions.size(), 0);
+	collapsed.assign(positions.size(), false);
+	positionTriangles.resize(positions.size());
+
+	// every position starts out knowing the planes of the triangles around it
+	unordered_map<unsigned long long, unsigned> edgeUses;
+	for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+	{
+		SimplifyTriangle triangle;
+		for (int k = 0; k < 3; ++k)
+		{
+			triangle.vertices[k] = mesh.indices[i + k];
+			triangle.positions[k] = vertexPositions[mesh.indices[i + k]];
+		}
+		if (triangle.positions[0] == triangle.positions[1] || triangle.positions[1] == triangle.positions[2] ||
+			triangle.positions[0] == triangle.positions[2])
+			continue;
+
+		glm::vec3 normal = getNormal(positions[triangle.positions[0]], positions[triangle.positions[1]], positions[triangle.positions[2]]);
+		float length = glm::length(normal);
+		if (length > 0.0f)
+		{
+			normal /= length;
+			float d = -glm::dot(normal, positions[triangle.positions[0]]);
+			for (int k = 0; k < 3; ++k)
+				quadrics[triangle.positions[k]].addPlane(normal, d, 1.0f);
+		}
+
+		triangle.alive = true;
+		for (int k = 0; k < 3; ++k)
+		{
+			positionTriangles[triangle.positions[k]].push_back((unsigned)triangles.size());
+			unsigned a = triangle.positions[k], b = triangle.positions[(k + 1) % 3];
+			edgeUses[(unsigned long long)min(a, b) << 32 | max(a, b)]++;
+		}
+		triangles.push_back(triangle);
+	}
+	triangleCount = triangles.size();
+
+	// Open borders get a plane standing up along them as well, so they don't shrink away.
+	// Every edge is a collapse candidate.
+	for (size_t t = 0; t < triangles.size(); ++t)
+	{
+		const SimplifyTriangle& triangle = triangles[t];
+		for (int k = 0; k < 3; ++k)
+		{
+			unsigned a = triangle.positions[k], b = triangle.positions[(k + 1) % 3];
+			unsigned uses = edgeUses[(unsigned long long)min(a, b) << 32 | max(a, b)];
+			if (uses == 1)
+			{
+				glm::vec3 edge = positions[b] - positions[a];
+				glm::vec3 border = glm::cross(edge, getNormal(positions[triangle.positions[0]], positions[triangle.positions[1]], positions[triangle.positions[2]]));
+				float length = glm::length(border);
+				if (length > 0.0f)
+				{
+					border /= length;
+					float d = -glm::dot(border, positions[a]);
+					quadrics[a].addPlane(border, d, LOD_BORDER_WEIGHT);
+					quadrics[b].addPlane(border, d, LOD_BORDER_WEIGHT);
+				}
+			}
+			// shared edges only need to be queued from one side
+			if (uses == 1 || a < b)
+				addCollapse(a, b);
+		}
+	}
+}
+
+void Simplification::addCollapse(unsigned a, unsigned b)
+{
+	Quadric quadric = quadrics[a];
+	quadric.add(quadrics[b]);
+
+	// whichever direction moves the surface less
+	Collapse collapse;
+	double aToB = quadric.evaluate(positions[b]), bToA = quadric.evaluate(positions[a]);
+	collapse.from = aToB <= bToA ? a : b;
+	collapse.to = aToB <= bToA ? b : a;
+	collapse.cost = min(aToB, bToA);
+	collapse.fromVersion = versions[collapse.from];
+	collapse.toVersion = versions[collapse.to];
+	queue.push(collapse);
+}
+
+void Simplification::getNeighbours(unsigned position, vector<unsigned>& neighbours) const
+{
+	neighbours.clear();
+	const vector<unsigned>& around = positionTriangles[position];
+	for (size_t i = 0; i < around.size(); ++i)
+	{
+		const SimplifyTriangle& triangle = triangles[around[i]];
+		if (!triangle.alive)
+			continue;
+		for (int k = 0; k < 3; ++k)
+		{
+			if (triangle.positions[k] != position)
+				neighbours.push_back(triangle.positions[k]);
+		}
+	}
+	sort(neighbours.begin(), neighbours.end());
+	neighbours.erase(unique(neighbours.begin(), neighbours.end()), neighbours.end());
+}
+
+bool Simplification::canCollapse(unsigned from, unsigned to) const
+{
+	// The link condition: the two ends may only share the neighbours across the triangles
+	// on the edge, or the surface gets pinched into something that isn't a manifold
+	vector<unsigned> fromNeighbours, toNeighbours, shared;
+	getNeighbours(from, fromNeighbours);
+	getNeighbours(to, toNeighbours);
+	set_intersection(fromNeighbours.begin(), fromNeighbours.end(), toNeighbours.begin(), toNeighbours.end(), back_inserter(shared));
+
+	size_t edgeTriangles = 0;
+	const vector<unsigned>& around = positionTriangles[from];
+	for (size_t i = 0; i < around.size(); ++i)
+	{
+		const SimplifyTriangle& triangle = triangles[around[i]];
+		if (triangle.alive && (triangle.positions[0] == to || triangle.positions[1] == to || triangle.positions[2] == to))
+			edgeTriangles++;
+	}
+	if (shared.size() != edgeTriangles)
+		return false;
+
+	// and no triangle that stays may flip over or turn too far
+	for (size_t i = 0; i < around.size(); ++i)
+	{
+		const SimplifyTriangle& triangle = triangles[around[i]];
+		if (!triangle.alive || triangle.positions[0] == to || triangle.positions[1] == to || triangle.positions[2] == to)
+			continue;
+
+		glm::vec3 before[3], after[3];
+		for (int k = 0; k < 3; ++k)
+		{
+			before[k] = positions[triangle.positions[k]];
+			after[k] = triangle.positions[k] == from ? positions[to] : before[k];
+		}
+		glm::vec3 normalBefore = getNormal(before[0], before[1], before[2]);
+		glm::vec3 normalAfter = getNormal(after[0], after[1], after[2]);
+		float lengths = glm::length(normalBefore) * glm::length(normalAfter);
+		if (lengths <= 0.0f || glm::dot(normalBefore, normalAfter) < LOD_MIN_NORMAL_DOT * lengths)
+			return false;
+	}
+	return true;
+}
+
+void Simplification::collapse(unsigned from, unsigned to)
+{
+	// The triangles on the edge say which corner at to is on the same side of an attribute
+	// seam as each corner at from. Those corners take over to's attributes, so they weld
+	// together again. A corner at from that ends up with two candidates, or none, keeps its own.
+	vector<pair<unsigned, unsigned>> attributes;	// from's vertex and to's, sorted by from's
+	vector<unsigned>& around = positionTriangles[from];
+	for (size_t i = 0; i < around.size(); ++i)
+	{
+		const SimplifyTriangle& triangle = triangles[around[i]];
+		if (!triangle.alive)
+			continue;
+
+		int fromCorner = -1, toCorner = -1;
+		for (int k = 0; k < 3; ++k)
+		{
+			if (triangle.positions[k] == from)
+				fromCorner = k;
+			else if (triangle.positions[k] == to)
+				toCorner = k;
+		}
+		if (toCorner >= 0)
+			attributes.push_back(make_pair(triangle.vertices[fromCorner], triangle.vertices[toCorner]));
+	}
+	sort(attributes.begin(), attributes.end());
+	attributes.erase(unique(attributes.begin(), attributes.end()), attributes.end());
+
+	// triangles on the edge disappear, the rest move over to the position that stays
+	for (size_t i = 0; i < around.size(); ++i)
+	{
+		SimplifyTriangle& triangle = triangles[around[i]];
+		if (!triangle.alive)
+			continue;
+
+		if (triangle.positions[0] == to || triangle.positions[1] == to || triangle.positions[2] == to)
+		{
+			triangle.alive = false;
+			triangleCount--;
+			continue;
+		}
+		for (int k = 0; k < 3; ++k)
+		{
+			if (triangle.positions[k] != from)
+				continue;
+			triangle.positions[k] = to;
+
+			vector<pair<unsigned, unsigned>>::const_iterator match =
+				lower_bound(attributes.begin(), attributes.end(), make_pair(triangle.vertices[k], 0u));
+			if (match != attributes.end() && match->first == triangle.vertices[k] &&
+				(match + 1 == attributes.end() || (match + 1)->first != triangle.vertices[k]))
+			{
+				triangle.vertices[k] = match->second;
+			}
+		}
+		positionTriangles[to].push_back(around[i]);
+	}
+	vector<unsigned>().swap(around);
+
+	// forget the dead triangles while we're here
+	vector<unsigned>& kept = positionTriangles[to];
+	size_t count = 0;
+	for (size_t i = 0; i < kept.size(); ++i)
+	{
+		if (triangles[kept[i]].alive)
+			kept[count++] = kept[i];
+	}
+	kept.resize(count);
+
+	quadrics[to].add(quadrics[from]);
+	collapsed[from] = true;
+	versions[to]++;
+
+	// every edge that still touches the position that stayed costs something else now
+	vector<unsigned> neighbours;
+	getNeighbours(to, neighbours);
+	for (size_t i = 0; i < neighbours.size(); ++i)
+		addCollapse(to, neighbours[i]);
+}
+
+void Simplification::run(size_t targetTriangles)
+{
+	while (triangleCount > targetTriangles && !queue.empty())
+	{
+		Collapse next = queue.top();
+		queue.pop();
+		if (collapsed[next.from] || collapsed[next.to] ||
+			next.fromVersion != versions[next.from] || next.toVersion != versions[next.to])
+			continue;
+		// it may still work once the neighbourhood changes, in which case it gets queued again
+		if (!canCollapse(next.from, next.to))
+			continue;
+
+		collapse(next.from, next.to);
+		maxCost = max(maxCost, next.cost);
+	}
+}
+
+MeshData Simplification::getLevel() const
+{
+	MeshData level;
+	level.vertices.reserve(triangleCount * 3);
+	level.indices.reserve(triangleCount * 3);
+
+	// one vertex per corner, with the attributes the corner has now at wherever its position
+	// went. The optimizer welds the ones that match back together.
+	for (size_t t = 0; t < triangles.size(); ++t)
+	{
+		const SimplifyTriangle& triangle = triangles[t];
+		if (!triangle.alive)
+			continue;
+		for (int k = 0; k < 3; ++k)
+		{
+			Vertex vertex = mesh.vertices[triangle.vertices[k]];
+			vertex.position = positions[triangle.positions[k]];
+			level.indices.push_back((GLuint)level.vertices.size());
+			level.vertices.push_back(vertex);
+		}
+	}
+	MeshOptimizer::optimize(level);
+	return level;
+}
+
+void MeshSimplifier::buildLodChain(MeshData& mesh)
+{
+	MeshLod full = { 0, (GLuint)mesh.vertices.size(), 0, (GLuint)mesh.indices.size(), 0.0f };
+	mesh.lods.assign(1, full);
+
+	size_t triangles = mesh.indices.size() / 3;
+	if (triangles < 2 * LOD_MIN_TRIANGLES)
+		return;
+
+	// every level continues collapsing where the one before it stopped
+	Simplification simplification(mesh);
+	vector<MeshData> levels;
+	vector<float> errors;
+	while (levels.size() + 1 < LOD_MAX_LEVELS)
+	{
+		size_t target = (size_t)(triangles * LOD_REDUCTION);
+		if (target < LOD_MIN_TRIANGLES)
+			break;
+		simplification.run(target);
+		if (simplification.getTriangleCount() > triangles * LOD_MIN_REDUCTION)
+			break;
+
+		triangles = simplification.getTriangleCount();
+		levels.push_back(simplification.getLevel());
+		errors.push_back(simplification.getError());
+	}
+
+	for (size_t i = 0; i < levels.size(); ++i)
+	{
+		MeshLod lod;
+		lod.firstVertex = (GLuint)mesh.vertices.size();
+		lod.vertexCount = (GLuint)levels[i].vertices.size();
+		lod.firstIndex = (GLuint)mesh.indices.size();
+		lod.indexCount = (GLuint)levels[i].indices.size();
+		lod.error = errors[i];
+		mesh.lods.push_back(lod);
+
+		mesh.vertices.insert(mesh.vertices.end(), levels[i].vertices.begin(), levels[i].vertices.end());
+		mesh.indices.insert(mesh.indices.end(), levels[i].indices.begin(), levels[i].indices.end());
+	}
+}
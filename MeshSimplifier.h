@@ -0,0 +1,36 @@
+#ifndef _MESH_SIMPLIFIER_H
+#define _MESH_SIMPLIFIER_H
+
+#include <vector>
+
+#include "MeshCache.h"
+
+// every level aims for this fraction of the triangles of the level before it
+#define LOD_REDUCTION 0.5f
+// levels with fewer triangles than this aren't worth having
+#define LOD_MIN_TRIANGLES 64
+// a level that can't get under this fraction of the level before it ends the chain
+#define LOD_MIN_REDUCTION 0.8f
+// how much harder open borders resist being collapsed than the surface around them
+#define LOD_BORDER_WEIGHT 10.0f
+// collapses that turn a triangle's normal further than this cosine allows are skipped
+#define LOD_MIN_NORMAL_DOT 0.2f
+
+using namespace std;
+
+// Builds the levels of detail of imported meshes with quadric error metrics (Garland and
+// Heckbert): the edge whose collapse moves the surface the least goes first, until each
+// level's triangle budget is met. Vertices only ever move onto other vertices' positions, and
+// the corners that move take the normal and texture coordinates of the corner they land on,
+// from the same side of any attribute seam. Seams don't stop anything from collapsing, and
+// only the real ones stay split.
+class MeshSimplifier
+{
+public:
+	// Appends up to LOD_MAX_LEVELS - 1 simplified levels, each run through the MeshOptimizer,
+	// to mesh's vertices and indices, and fills in mesh.lods. mesh has to hold just the full
+	// level when this is called.
+	static void buildLodChain(MeshData& mesh);
+};
+
+#endif
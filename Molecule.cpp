@@ -1,106 +1,55 @@
 #include "Molecule.h"
-#include "window.h"
 
 #include <iostream>
 #include <ctime>
 #include <cstdlib>
 
-bool Molecule::modelLoaded = false;
-vector<Mesh> Molecule::model_meshes;
+using namespace std;
+
+bool Molecule::seeded = false;
+bool Molecule::logSpawns = true;
 
 float Molecule::randPosMin = -50.0f;
 float Molecule::randPosMax = 50.0f;
 
-Model* Molecule::o2Model;
-
 const float SPIN_LO = 0.5f, SPIN_HI = 8.0f;
 const float SPIN_DIR_LO = 0.0f, SPIN_DIR_HI = 1.0f;
 const float VEL_LO = 0.05f, VEL_HI = 0.5f;
 
-glm::vec3 boundsOrigin = glm::vec3(0.0f);
+// Meshes are built translated to origin (0, -5, 0) after a 0.5 scale, which puts new molecules here
+const glm::vec3 spawnPoint = glm::vec3(0.0f, -2.5f, 0.0f);
 
-// Used for creating first molecule and loading the meshes
-Molecule::Molecule(bool first) : Model(CO2_PATH)
+Molecule Molecule::spawn(MoleculeStore& store)
 {
-	cout << "\nCreating first CO2 Molecule..." << endl;
-
-	if (!modelLoaded)
+	if (!seeded)
 	{
-		modelLoaded = true;
-		o2Model = new Model(O2_PATH);
-
-		// scale the molecules down a bit
-		for (GLuint i = 0; i < this->meshes.size(); i++)
-			meshes[i].toWorld = glm::scale(meshes[i].toWorld, glm::vec3(0.5f, 0.5f, 0.5f));
-		model_meshes = meshes;
-
 		// generate a seed for the velocity and spin generation
 		srand(static_cast <unsigned> (time(0)));
-
-		initRands();
-	}
-	else
-	{
-		cerr << "Attempting to respawn initial molecule and reload the meshes!" << endl;
+		seeded = true;
 	}
-}
-
-Molecule::Molecule() : Model()
-{
-	cout << "\nCreating CO2 molecule..." << endl;
-	meshes = model_meshes;
-	initRands();
-}
-
-Molecule::~Molecule()
-{
-	Model::~Model();
-}
-
-void Molecule::cleanup()
-{
-	model_meshes.clear();
-	delete o2Model;
-	o2Model = NULL;
-}
 
-void Molecule::initRands()
-{
 	// assign initial random upwards velocity and spin
-	this->spinSpeed = SPIN_LO + static_cast <float> (rand()) / (static_cast <float> (RAND_MAX / (SPIN_HI - SPIN_LO)));
-	this->spinX = SPIN_DIR_LO + static_cast <float> (rand()) / (static_cast <float> (RAND_MAX / (SPIN_DIR_HI - SPIN_DIR_LO)));
-	this->spinY = SPIN_DIR_LO + static_cast <float> (rand()) / (static_cast <float> (RAND_MAX / (SPIN_DIR_HI - SPIN_DIR_LO)));
-	this->spinZ = SPIN_DIR_LO + static_cast <float> (rand()) / (static_cast <float> (RAND_MAX / (SPIN_DIR_HI - SPIN_DIR_LO)));
-	this->velocity = VEL_LO + static_cast <float> (rand()) / (static_cast <float> (RAND_MAX / (VEL_HI - VEL_LO)));
-
-	cout << "Spin speed: " << spinSpeed << "     Velocity: " << velocity << endl;
-	cout << "Spin X: " << spinX << "     Spin Y: " << spinY << "     Spin Z: " << spinZ << endl << endl;
-}
+	float spinSpeed = SPIN_LO + static_cast <float> (rand()) / (static_cast <float> (RAND_MAX / (SPIN_HI - SPIN_LO)));
+	float spinX = SPIN_DIR_LO + static_cast <float> (rand()) / (static_cast <float> (RAND_MAX / (SPIN_DIR_HI - SPIN_DIR_LO)));
+	float spinY = SPIN_DIR_LO + static_cast <float> (rand()) / (static_cast <float> (RAND_MAX / (SPIN_DIR_HI - SPIN_DIR_LO)));
+	float spinZ = SPIN_DIR_LO + static_cast <float> (rand()) / (static_cast <float> (RAND_MAX / (SPIN_DIR_HI - SPIN_DIR_LO)));
+	float velocity = VEL_LO + static_cast <float> (rand()) / (static_cast <float> (RAND_MAX / (VEL_HI - VEL_LO)));
 
-void Molecule::draw(GLuint shaderProgram)
-{
-	// draw all meshes associated with this model
-	for (GLuint i = 0; i < meshes.size(); i++)
+	if (logSpawns)
 	{
-		meshes[i].draw(shaderProgram);
+		cout << "\nCreating CO2 molecule..." << endl;
+		cout << "Spin speed: " << spinSpeed << "     Velocity: " << velocity << endl;
+		cout << "Spin X: " << spinX << "     Spin Y: " << spinY << "     Spin Z: " << spinZ << endl << endl;
 	}
+
+	MoleculeHandle handle = store.add(MOLECULE_CO2, spawnPoint, velocity, glm::vec3(spinX, spinY, spinZ), spinSpeed);
+	return Molecule(store, handle);
 }
 
-void Molecule::update()
+void Molecule::seedRandom(unsigned int seed)
 {
-	// spin and translate the molecule
-	for (GLuint i = 0; i < this->meshes.size(); i++)
-	{
-		meshes[i].toWorld = glm::translate(meshes[i].toWorld, glm::vec3(0.0f, velocity, 0.0f));
-		meshes[i].toWorld = meshes[i].toWorld * glm::rotate(glm::mat4(1.0f), spinSpeed / 180.0f * glm::pi<float>(), glm::vec3(spinX, spinY, spinZ));
-	}
-
-	// get the distance from the center of the molecule to the bounding box border
-	float dist = glm::abs(glm::distance(boundsOrigin, calcCenterPoint()));
-
-	// "bounce" the molecules back when they reach the bounding box
-	if (dist > BOUNDS_DIST)
-		velocity = -velocity;
+	srand(seed);
+	seeded = true;
 }
 
 // Called when the game has been lost and molecules should be spawned in random locations
@@ -110,35 +59,28 @@ void Molecule::randomizePosition()
 	float y = ((static_cast<float> (rand()) / (static_cast<float> (RAND_MAX))) * (randPosMax - randPosMin)) + randPosMin;
 	float z = ((static_cast<float> (rand()) / (static_cast<float> (RAND_MAX))) * (randPosMax - randPosMin)) + randPosMin;
 
-	// move the molecule to the new position
-	for (GLuint i = 0; i < this->meshes.size(); i++)
-	{
-		meshes[i].toWorld = glm::translate(meshes[i].toWorld, glm::vec3(x, y, z));
-	}
+	// move the molecule to the new position, in its own (rotated and scaled) space
+	size_t index = getIndex();
+	glm::vec3 offset = store->orientations[index] * (glm::vec3(x, y, z) * MOLECULE_SCALE);
+	store->posX[index] += offset.x;
+	store->posY[index] += offset.y;
+	store->posZ[index] += offset.z;
+	store->resetHistory(index);
 }
 
 void Molecule::makeO2()
 {
-	vector<Mesh> oldMeshes = meshes;
-
-	// turns the CO2 molecule into an O2
-	meshes.clear();
-	meshes = o2Model->getMeshes();
-	for (int i = 0; i < meshes.size(); ++i)
-		meshes[i].toWorld = oldMeshes[i].toWorld;
+	// turns the CO2 molecule into an O2, the transform stays where it is
+	store->types[getIndex()] = MOLECULE_O2;
 }
 
-glm::vec3 Molecule::calcCenterPoint()
+void Molecule::despawn()
 {
-	glm::vec3 center = glm::vec3(0.0f);
-
-	// calculate the average (center) of all the mesh points
-	for (GLuint i = 0; i < this->meshes.size(); i++)
-	{
-		glm::vec4 pos = meshes[i].toWorld[3];
-		center += glm::vec3(pos.x, pos.y, pos.z);
-	}
-	center /= (float)meshes.size();
+	// the last molecule in the store moves into this one's place, the handle goes stale
+	store->remove(handle);
+}
 
-	return center;
-}
\ No newline at end of file
+glm::vec3 Molecule::calcCenterPoint() const
+{
+	return store->getPosition(getIndex());
+}
@@ -1,42 +1,43 @@
 #ifndef _MOLECULE_H
 #define _MOLECULE_H
 
-#include "model.h"
+#include <glm/glm.hpp>
 
-#define CO2_PATH "../Assets/co2/co2.obj"
-#define O2_PATH "../Assets/o2/o2.obj"
-#define BOUNDS_DIST 5.0f
+#include "MoleculeStore.h"
 
-class Molecule : protected Model
+// A molecule is a view of one entry in a MoleculeStore. It holds no state of its own,
+// so it is cheap to create and keep around whenever a single molecule needs to be worked on.
+// Once the molecule is removed from the store isAlive() turns false and nothing else may be called.
+class Molecule
 {
 public:
-	Molecule(bool first);
-	Molecule();
-	~Molecule();
+	Molecule(MoleculeStore& store, MoleculeHandle handle) : store(&store), handle(handle) {}
 
-	void draw(GLuint shaderProgram);
-	void update();
-	void randomizePosition();
-	void makeO2();
+	// adds a new CO2 molecule with a random velocity and spin to the store.
+	// Check isAlive(), the molecule isn't added if the store is full.
+	static Molecule spawn(MoleculeStore& store);
+	// seeds the spawns with a fixed value instead of the time, for repeatable runs
+	static void seedRandom(unsigned int seed);
 
-	glm::vec3 calcCenterPoint();
+	// print the velocity and spin of every spawned molecule
+	static bool logSpawns;
 
-	static void cleanup();
+	void randomizePosition();
+	void makeO2();
+	void despawn();
 
-	static bool modelLoaded;
+	glm::vec3 calcCenterPoint() const;
+	bool isO2() const { return store->types[getIndex()] == MOLECULE_O2; }
+	bool isAlive() const { return store->isAlive(handle); }
+	MoleculeHandle getHandle() const { return handle; }
+	size_t getIndex() const { return store->indexOf(handle); }
 
 private:
-	void initRands();
-
-	static vector<Mesh> model_meshes;
-
-	float velocity;
-	float spinX, spinY, spinZ, spinSpeed;
+	MoleculeStore* store;
+	MoleculeHandle handle;
 
+	static bool seeded;
 	static float randPosMin, randPosMax;
-
-	// this is a really shitty thing to do
-	static Model* o2Model;
 };
 
 #endif
@@ -0,0 +1,131 @@
+#include "MoleculeRenderer.h"
+#include "RenderStats.h"
+#include "FrustumCuller.h"
+#include "RenderQueue.h"
+#include "StreamBuffer.h"
+
+#include <string.h>
+#include <iostream>
+
+MoleculeRenderer::MoleculeRenderer(AssetLoader* loader)
+{
+	cout << "\nLoading molecule models..." << endl;
+	co2Model = new Model(CO2_PATH, loader);
+	o2Model = new Model(O2_PATH, loader);
+	co2Batch.count = o2Batch.count = 0;
+}
+
+MoleculeRenderer::~MoleculeRenderer()
+{
+	delete co2Model;
+	delete o2Model;
+}
+
+void MoleculeRenderer::draw(GLuint shaderProgram, const MoleculeStore& molecules, float alpha)
+{
+	for (unsigned l = 0; l < LOD_MAX_LEVELS; ++l)
+	{
+		co2Batch.levelToWorlds[l].clear();
+		o2Batch.levelToWorlds[l].clear();
+	}
+
+	// the molecules only bring where the whole model goes, the meshes have to be in place in it
+	co2Model->updateTransforms();
+	o2Model->updateTransforms();
+	LodChain co2Chain = co2Model->getLodChain();
+	LodChain o2Chain = o2Model->getLodChain();
+	if (lodStates.size() < molecules.getCapacity())
+		lodStates.resize(molecules.getCapacity(), LodState());
+
+	// every molecule's place this frame, and whether that's in view at all
+	toWorlds.resize(molecules.size());
+	spheres.resize(molecules.size());
+	visible.resize(molecules.size());
+	for (size_t i = 0; i < molecules.size(); ++i)
+	{
+		const LodChain& chain = molecules.types[i] == MOLECULE_O2 ? o2Chain : co2Chain;
+		toWorlds[i] = molecules.getInterpolatedToWorld(i, alpha);
+		spheres[i] = FrustumCuller::getWorldSphere(chain.center, chain.radius, toWorlds[i]);
+	}
+	if (!spheres.empty())
+		FrustumCuller::cullSpheres(&spheres[0], spheres.size(), &visible[0]);
+
+	// sort the ones that are into one batch per type, and within it by level of detail
+	for (size_t i = 0; i < molecules.size(); ++i)
+	{
+		if (!visible[i])
+			continue;
+		bool o2 = molecules.types[i] == MOLECULE_O2;
+		const glm::mat4& toWorld = toWorlds[i];
+
+		// a new molecule in an old slot starts from the full mesh
+		MoleculeHandle handle = molecules.getHandle(i);
+		LodState& state = lodStates[handle.slot];
+		if (state.generation != handle.generation)
+		{
+			state.generation = handle.generation;
+			state.level = 0;
+		}
+		state.level = (unsigned char)LodSelector::select(o2 ? o2Chain : co2Chain, toWorld, state.level);
+
+		(o2 ? o2Batch : co2Batch).levelToWorlds[state.level].push_back(toWorld);
+	}
+
+	InstanceBatch* batches[] = { &co2Batch, &o2Batch };
+	for (int b = 0; b < 2; ++b)
+	{
+		batches[b]->count = 0;
+		for (unsigned l = 0; l < LOD_MAX_LEVELS; ++l)
+			batches[b]->count += batches[b]->levelToWorlds[l].size();
+	}
+
+	if (co2Batch.count > 0)
+		drawBatch(shaderProgram, co2Batch, co2Model);
+	if (o2Batch.count > 0)
+		drawBatch(shaderProgram, o2Batch, o2Model);
+}
+
+void MoleculeRenderer::uploadInstances(InstanceBatch& batch, vector<Mesh>& meshes)
+{
+	// the levels go straight into this frame's part of the stream buffer, one after the other
+	StreamChunk chunk = StreamBuffer::allocate(batch.count * sizeof(glm::mat4));
+	glm::mat4* toWorlds = (glm::mat4*)chunk.data;
+	for (unsigned l = 0; l < LOD_MAX_LEVELS; ++l)
+	{
+		if (!batch.levelToWorlds[l].empty())
+			memcpy(toWorlds, &batch.levelToWorlds[l][0], batch.levelToWorlds[l].size() * sizeof(glm::mat4));
+		toWorlds += batch.levelToWorlds[l].size();
+	}
+	StreamBuffer::commit(chunk);
+
+	// the chunk is somewhere else every frame, and the meshes might have just replaced their placeholder
+	for (GLuint i = 0; i < meshes.size(); i++)
+		meshes[i].attachInstanceBuffer(chunk.buffer, chunk.offset, chunk.generation);
+}
+
+void MoleculeRenderer::drawBatch(GLuint shaderProgram, InstanceBatch& batch, Model* model)
+{
+	vector<Mesh>& meshes = model->getMeshes();
+	uploadInstances(batch, meshes);
+
+	// one draw call per mesh and level, no matter how many molecules there are
+	GLuint firstInstance = 0;
+	for (unsigned l = 0; l < LOD_MAX_LEVELS; ++l)
+	{
+		GLsizei count = (GLsizei)batch.levelToWorlds[l].size();
+		if (count == 0)
+			continue;
+		for (GLuint i = 0; i < meshes.size(); i++)
+		{
+			if (RenderQueue::isEnabled())
+			{
+				// the molecules at one level are about as far away as each other, the first stands in for all of them
+				DrawPacket packet = { shaderProgram, &meshes[i], l, meshes[i].materialIndex, &meshes[i].toModel, count, firstInstance };
+				RenderQueue::submit(packet, glm::vec3(batch.levelToWorlds[l][0][3]));
+			}
+			else
+				meshes[i].drawInstanced(shaderProgram, count, l, firstInstance);
+		}
+		firstInstance += count;
+	}
+}
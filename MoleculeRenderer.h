@@ -0,0 +1,62 @@
+#ifndef _MOLECULE_RENDERER_H
+#define _MOLECULE_RENDERER_H
+
+#include <vector>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "model.h"
+#include "MoleculeStore.h"
+
+#define CO2_PATH "../Assets/co2/co2.obj"
+#define O2_PATH "../Assets/o2/o2.obj"
+
+using namespace std;
+
+// Owns the CO2 and O2 meshes shared by every molecule and draws every molecule of a type
+// with one instanced draw call per shared mesh and level of detail, instead of one draw call
+// per mesh per molecule. Molecules out of view are left out before anything is uploaded.
+class MoleculeRenderer
+{
+public:
+	// the molecule models stream in through loader if there is one
+	MoleculeRenderer(AssetLoader* loader = NULL);
+	~MoleculeRenderer();
+
+	// alpha is how far we are between the last two simulation ticks
+	void draw(GLuint shaderProgram, const MoleculeStore& molecules, float alpha);
+
+private:
+	// the toWorld matrices of every molecule that shares a set of meshes, one list per level
+	// of detail, written to the StreamBuffer one after the other
+	struct InstanceBatch
+	{
+		vector<glm::mat4> levelToWorlds[LOD_MAX_LEVELS];
+		size_t count;	// in all the levels together
+	};
+
+	// the level a molecule was drawn at last frame, until its slot goes to another molecule
+	struct LodState
+	{
+		unsigned int generation;
+		unsigned char level;
+	};
+
+	// writes the batch's matrices for this frame and points meshes at them
+	void uploadInstances(InstanceBatch& batch, vector<Mesh>& meshes);
+	void drawBatch(GLuint shaderProgram, InstanceBatch& batch, Model* model);
+
+	Model* co2Model;
+	Model* o2Model;
+
+	InstanceBatch co2Batch, o2Batch;
+	vector<LodState> lodStates;	// by molecule slot
+
+	// every molecule's toWorld and world space bounding sphere, and whether it's in view
+	vector<glm::mat4> toWorlds;
+	vector<glm::vec4> spheres;
+	vector<unsigned char> visible;
+};
+
+#endif
@@ -0,0 +1,318 @@
+#include "MoleculeStore.h"
+#include "SpatialHash.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+MoleculeStore::MoleculeStore(size_t capacity)
+{
+	posX.reserve(capacity);
+	posY.reserve(capacity);
+	posZ.reserve(capacity);
+	orientations.reserve(capacity);
+	velocities.reserve(capacity);
+	spinAxes.reserve(capacity);
+	spinSpeeds.reserve(capacity);
+	spinSteps.reserve(capacity);
+	types.reserve(capacity);
+	prevPosX.reserve(capacity);
+	prevPosY.reserve(capacity);
+	prevPosZ.reserve(capacity);
+	prevOrientations.reserve(capacity);
+	indexSlots.reserve(capacity);
+	collided.reserve(capacity);
+
+	slotIndices.assign(capacity, 0);
+	generations.assign(capacity, 0);
+
+	// hand out the low slots first
+	freeSlots.reserve(capacity);
+	for (size_t i = capacity; i > 0; --i)
+		freeSlots.push_back((unsigned int)(i - 1));
+}
+
+MoleculeHandle MoleculeStore::add(MoleculeType type, glm::vec3 position, float velocity, glm::vec3 spinAxis, float spinSpeed)
+{
+	MoleculeHandle handle;
+	if (freeSlots.empty())
+	{
+		handle.slot = INVALID_MOLECULE_SLOT;
+		handle.generation = 0;
+		return handle;
+	}
+
+	handle.slot = freeSlots.back();
+	handle.generation = generations[handle.slot];
+	freeSlots.pop_back();
+
+	slotIndices[handle.slot] = (unsigned int)size();
+	indexSlots.push_back(handle.slot);
+
+	// none of these grow past the capacity reserved up front
+	posX.push_back(position.x);
+	posY.push_back(position.y);
+	posZ.push_back(position.z);
+	orientations.push_back(glm::quat(1.0f, 0.0f, 0.0f, 0.0f));
+	velocities.push_back(velocity);
+	spinAxes.push_back(spinAxis);
+	spinSpeeds.push_back(spinSpeed);
+	spinSteps.push_back(glm::angleAxis(spinSpeed / 180.0f * glm::pi<float>(), glm::normalize(spinAxis)));
+	types.push_back(type);
+
+	prevPosX.push_back(position.x);
+	prevPosY.push_back(position.y);
+	prevPosZ.push_back(position.z);
+	prevOrientations.push_back(orientations.back());
+
+	return handle;
+}
+
+// moves the last element into i and drops the last one
+template <typename T>
+static void swapRemove(vector<T>& v, size_t i)
+{
+	v[i] = v.back();
+	v.pop_back();
+}
+
+void MoleculeStore::remove(MoleculeHandle handle)
+{
+	if (!isAlive(handle))
+		return;
+
+	size_t i = slotIndices[handle.slot];
+
+	// the last molecule takes over the removed one's index
+	unsigned int lastSlot = indexSlots.back();
+	slotIndices[lastSlot] = (unsigned int)i;
+	swapRemove(indexSlots, i);
+
+	swapRemove(posX, i);
+	swapRemove(posY, i);
+	swapRemove(posZ, i);
+	swapRemove(orientations, i);
+	swapRemove(velocities, i);
+	swapRemove(spinAxes, i);
+	swapRemove(spinSpeeds, i);
+	swapRemove(spinSteps, i);
+	swapRemove(types, i);
+	swapRemove(prevPosX, i);
+	swapRemove(prevPosY, i);
+	swapRemove(prevPosZ, i);
+	swapRemove(prevOrientations, i);
+
+	// any handle still pointing at this slot is now stale
+	++generations[handle.slot];
+	freeSlots.push_back(handle.slot);
+}
+
+void MoleculeStore::clear()
+{
+	for (size_t i = 0; i < indexSlots.size(); ++i)
+	{
+		++generations[indexSlots[i]];
+		freeSlots.push_back(indexSlots[i]);
+	}
+	indexSlots.clear();
+
+	// the elements are plain data, so these just reset the sizes and keep the memory
+	posX.clear();
+	posY.clear();
+	posZ.clear();
+	orientations.clear();
+	velocities.clear();
+	spinAxes.clear();
+	spinSpeeds.clear();
+	spinSteps.clear();
+	types.clear();
+	prevPosX.clear();
+	prevPosY.clear();
+	prevPosZ.clear();
+	prevOrientations.clear();
+}
+
+template <typename T>
+static size_t arrayBytes(const vector<T>& v)
+{
+	return v.capacity() * sizeof(T);
+}
+
+size_t MoleculeStore::getMemoryUsage() const
+{
+	return arrayBytes(posX) + arrayBytes(posY) + arrayBytes(posZ) + arrayBytes(orientations) + arrayBytes(velocities)
+		+ arrayBytes(spinAxes) + arrayBytes(spinSpeeds) + arrayBytes(spinSteps) + arrayBytes(types)
+		+ arrayBytes(prevPosX) + arrayBytes(prevPosY) + arrayBytes(prevPosZ) + arrayBytes(prevOrientations)
+		+ arrayBytes(indexSlots) + arrayBytes(slotIndices) + arrayBytes(generations) + arrayBytes(freeSlots) + arrayBytes(collided);
+}
+
+size_t MoleculeStore::getUpdateBytesPerMolecule()
+{
+	// the history copy reads the position and orientation and writes them out again,
+	// then integrate() and bounce() work on the position, orientation, velocity and spin step
+	size_t state = 3 * sizeof(float) + sizeof(glm::quat);
+	return 2 * state + state + sizeof(float) + sizeof(glm::quat);
+}
+
+MoleculeHandle MoleculeStore::getHandle(size_t i) const
+{
+	MoleculeHandle handle;
+	handle.slot = indexSlots[i];
+	handle.generation = generations[handle.slot];
+	return handle;
+}
+
+bool MoleculeStore::isAlive(MoleculeHandle handle) const
+{
+	if (handle.slot >= generations.size() || generations[handle.slot] != handle.generation)
+		return false;
+
+	// a slot that was never used still has its first generation, check it's actually in use
+	unsigned int i = slotIndices[handle.slot];
+	return i < indexSlots.size() && indexSlots[i] == handle.slot;
+}
+
+void MoleculeStore::update()
+{
+	update(0, size());
+}
+
+void MoleculeStore::update(size_t begin, size_t end)
+{
+	// every pass only touches molecules in [begin, end), so ranges can run on different threads
+	std::copy(posX.begin() + begin, posX.begin() + end, prevPosX.begin() + begin);
+	std::copy(posY.begin() + begin, posY.begin() + end, prevPosY.begin() + begin);
+	std::copy(posZ.begin() + begin, posZ.begin() + end, prevPosZ.begin() + begin);
+	std::copy(orientations.begin() + begin, orientations.begin() + end, prevOrientations.begin() + begin);
+
+	integrate(begin, end);
+	bounce(begin, end);
+}
+
+void MoleculeStore::integrate(size_t begin, size_t end)
+{
+	for (size_t i = begin; i < end; ++i)
+	{
+		// move along the molecule's local up axis (the second column of its rotation), then spin it
+		const glm::quat& q = orientations[i];
+		float step = velocities[i] * MOLECULE_SCALE;
+		posX[i] += step * 2.0f * (q.x * q.y - q.w * q.z);
+		posY[i] += step * (1.0f - 2.0f * (q.x * q.x + q.z * q.z));
+		posZ[i] += step * 2.0f * (q.y * q.z + q.w * q.x);
+
+		orientations[i] = glm::normalize(q * spinSteps[i]);
+	}
+}
+
+void MoleculeStore::bounce(size_t begin, size_t end)
+{
+	const float boundsDist2 = BOUNDS_DIST * BOUNDS_DIST;
+	const float* x = posX.data();
+	const float* y = posY.data();
+	const float* z = posZ.data();
+	float* v = velocities.data();
+
+	// "bounce" the molecules back when they reach the bounding sphere around the origin.
+	// No branches and no cross-iteration dependencies, so the compiler can vectorize this loop.
+	for (size_t i = begin; i < end; ++i)
+	{
+		float dist2 = x[i] * x[i] + y[i] * y[i] + z[i] * z[i];
+		v[i] = dist2 > boundsDist2 ? -v[i] : v[i];
+	}
+}
+
+size_t MoleculeStore::collide(const SpatialHash& grid)
+{
+	const float minDist = 2.0f * MOLECULE_RADIUS;
+	const float minDist2 = minDist * minDist;
+	size_t contacts = 0;
+
+	collided.assign(size(), 0);
+
+	for (size_t i = 0; i < size(); ++i)
+	{
+		grid.forEachNeighbor(getPosition(i), minDist, [&](unsigned int j)
+		{
+			// every pair shows up twice, only handle it from the lower index
+			if (j <= i)
+				return;
+
+			// narrow phase, sphere vs sphere
+			glm::vec3 delta = getPosition(j) - getPosition(i);
+			float dist2 = glm::dot(delta, delta);
+			if (dist2 >= minDist2)
+				return;
+
+			// molecules spawn on top of each other, so pick any direction to separate them
+			float dist = sqrt(dist2);
+			glm::vec3 normal = dist > 1e-6f ? delta / dist : glm::vec3(1.0f, 0.0f, 0.0f);
+
+			// move both out of the overlap by half of it each
+			glm::vec3 push = normal * ((minDist - dist) * 0.5f);
+			posX[i] -= push.x;
+			posY[i] -= push.y;
+			posZ[i] -= push.z;
+			posX[j] += push.x;
+			posY[j] += push.y;
+			posZ[j] += push.z;
+
+			++contacts;
+
+			// pairs that are already moving apart only need the push
+			glm::vec3 relativeVelocity = getVelocity(j) - getVelocity(i);
+			if (glm::dot(relativeVelocity, normal) >= 0.0f)
+				return;
+
+			// molecules only move along their own up axis, so bouncing reverses them like the bounds do.
+			// Only once per tick, or an even number of contacts would cancel out.
+			if (!collided[i])
+				velocities[i] = -velocities[i];
+			if (!collided[j])
+				velocities[j] = -velocities[j];
+			collided[i] = collided[j] = 1;
+		});
+	}
+
+	return contacts;
+}
+
+void MoleculeStore::resetHistory(size_t i)
+{
+	prevPosX[i] = posX[i];
+	prevPosY[i] = posY[i];
+	prevPosZ[i] = posZ[i];
+	prevOrientations[i] = orientations[i];
+}
+
+void MoleculeStore::resetHistory()
+{
+	// plain array copies, the same size every tick
+	prevPosX = posX;
+	prevPosY = posY;
+	prevPosZ = posZ;
+	prevOrientations = orientations;
+}
+
+glm::vec3 MoleculeStore::getVelocity(size_t i) const
+{
+	// the same local up axis integrate() moves along
+	return orientations[i] * glm::vec3(0.0f, velocities[i] * MOLECULE_SCALE, 0.0f);
+}
+
+glm::mat4 MoleculeStore::getToWorld(size_t i) const
+{
+	glm::mat4 toWorld = glm::translate(glm::mat4(1.0f), getPosition(i)) * glm::mat4_cast(orientations[i]);
+	return glm::scale(toWorld, glm::vec3(MOLECULE_SCALE));
+}
+
+glm::mat4 MoleculeStore::getInterpolatedToWorld(size_t i, float alpha) const
+{
+	glm::vec3 prevPosition(prevPosX[i], prevPosY[i], prevPosZ[i]);
+	glm::vec3 position = glm::mix(prevPosition, getPosition(i), alpha);
+	// the spin per tick is small, so normalized lerp is as good as slerp here
+	glm::quat orientation = glm::normalize(glm::lerp(prevOrientations[i], orientations[i], alpha));
+
+	glm::mat4 toWorld = glm::translate(glm::mat4(1.0f), position) * glm::mat4_cast(orientation);
+	return glm::scale(toWorld, glm::vec3(MOLECULE_SCALE));
+}
@@ -0,0 +1,121 @@
+#ifndef _MOLECULE_STORE_H
+#define _MOLECULE_STORE_H
+
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+using namespace std;
+
+class SpatialHash;
+
+#define BOUNDS_DIST 5.0f
+
+// Every mesh is built scaled by 0.5 and the molecule meshes are scaled down by another 0.5
+#define MOLECULE_SCALE 0.25f
+// radius of the bounding sphere used for molecule-molecule collisions, in world units
+#define MOLECULE_RADIUS 0.3f
+// grid cell size for the collision broad phase. Twice the contact distance, so each molecule only looks at 2 x 2 x 2 cells.
+#define COLLISION_CELL_SIZE (4.0f * MOLECULE_RADIUS)
+
+enum MoleculeType : unsigned char
+{
+	MOLECULE_CO2,
+	MOLECULE_O2
+};
+
+// Refers to one molecule for as long as it lives. Indices into the arrays change when other molecules
+// are removed, and a slot is reused after its molecule is gone, so handles carry the generation of
+// their slot and go stale instead of silently pointing at a different molecule.
+struct MoleculeHandle
+{
+	unsigned int slot;
+	unsigned int generation;
+};
+
+#define INVALID_MOLECULE_SLOT 0xffffffffu
+
+// Structure-of-arrays storage for the simulation state of every molecule.
+// A molecule is just an index into these arrays; element i of each array belongs to molecule i.
+// Everything is allocated up front for a fixed number of molecules, so adding, removing and
+// clearing molecules never touches the heap. The arrays stay packed: removing a molecule moves
+// the last one into its place.
+class MoleculeStore
+{
+public:
+	MoleculeStore(size_t capacity);
+
+	// returns a handle with slot INVALID_MOLECULE_SLOT when the store is full
+	MoleculeHandle add(MoleculeType type, glm::vec3 position, float velocity, glm::vec3 spinAxis, float spinSpeed);
+	// does nothing if the molecule is already gone
+	void remove(MoleculeHandle handle);
+	// removes every molecule, handles to them go stale
+	void clear();
+
+	size_t size() const { return types.size(); }
+	size_t getCapacity() const { return slotIndices.size(); }
+	// bytes allocated for the molecule arrays
+	size_t getMemoryUsage() const;
+	// bytes update() reads and writes per molecule
+	static size_t getUpdateBytesPerMolecule();
+
+	bool isAlive(MoleculeHandle handle) const;
+	// the molecule's current index into the arrays, only valid until the next remove()
+	size_t indexOf(MoleculeHandle handle) const { return slotIndices[handle.slot]; }
+	// a lasting handle to the molecule currently at index i
+	MoleculeHandle getHandle(size_t i) const;
+
+	// advance every molecule by one simulation tick
+	void update();
+	// same, but only for the molecules in [begin, end). Separate ranges can be updated in parallel.
+	void update(size_t begin, size_t end);
+
+	// pushes apart every pair of molecules closer than 2 * MOLECULE_RADIUS and sends both back the way
+	// they came. grid must have been built from the current positions, with COLLISION_CELL_SIZE cells.
+	// Returns the number of colliding pairs.
+	size_t collide(const SpatialHash& grid);
+
+	// makes molecule i's previous state the same as its current one, so a teleport isn't interpolated
+	void resetHistory(size_t i);
+	// same for every molecule, for when the molecules stop moving
+	void resetHistory();
+
+	glm::vec3 getPosition(size_t i) const { return glm::vec3(posX[i], posY[i], posZ[i]); }
+	// world space distance moved per tick
+	glm::vec3 getVelocity(size_t i) const;
+	glm::mat4 getToWorld(size_t i) const;
+	// blends the state before the last tick (alpha = 0) with the current state (alpha = 1)
+	glm::mat4 getInterpolatedToWorld(size_t i, float alpha) const;
+
+	// positions are split per component so the bounds test runs over plain float arrays
+	vector<float> posX, posY, posZ;
+	vector<glm::quat> orientations;
+	vector<float> velocities;
+	vector<glm::vec3> spinAxes;
+	vector<float> spinSpeeds;
+	vector<MoleculeType> types;
+
+	// the state before the last update, for interpolating between ticks
+	vector<float> prevPosX, prevPosY, prevPosZ;
+	vector<glm::quat> prevOrientations;
+
+private:
+	void integrate(size_t begin, size_t end);
+	void bounce(size_t begin, size_t end);
+
+	// the rotation applied every step, derived from the spin axis and speed
+	vector<glm::quat> spinSteps;
+
+	// slot of each index, index of each slot, and the generation of each slot
+	vector<unsigned int> indexSlots;
+	vector<unsigned int> slotIndices;
+	vector<unsigned int> generations;
+	// unused slots, used as a stack
+	vector<unsigned int> freeSlots;
+
+	// scratch for collide(), whether a molecule already bounced off something this tick
+	vector<unsigned char> collided;
+};
+
+#endif
@@ -0,0 +1,278 @@
+#include "Profiler.h"
+
+#include <stdio.h>
+
+Profiler::Profiler()
+{
+	history.resize(PROFILER_HISTORY_FRAMES);
+	frameCount = 0;
+	frameOpen = false;
+	queriesCreated = false;
+	resolutionScale = 1.0f;
+
+	for (int i = 0; i < Sample_LAST; ++i)
+		recorded[i] = false;
+	for (int i = 0; i <= PROFILER_QUERY_LATENCY; ++i)
+		querySets[i].pending = false;
+}
+
+void Profiler::recordSample(SampleType sampleType)
+{
+	if (sampleType == Sample_FrameStart)
+	{
+		if (frameOpen)
+			closeFrame();
+
+		if (!queriesCreated)
+		{
+			for (int i = 0; i <= PROFILER_QUERY_LATENCY; ++i)
+				glGenQueries(Sample_LAST, querySets[i].queries);
+			queriesCreated = true;
+		}
+
+		// collect whatever the GPU has finished, without waiting on anything
+		for (int i = 0; i <= PROFILER_QUERY_LATENCY; ++i)
+		{
+			if (querySets[i].pending)
+				readQueries(querySets[i]);
+		}
+
+		// if the GPU is more than PROFILER_QUERY_LATENCY frames behind, that frame's GPU times are lost
+		QuerySet& querySet = querySets[frameCount % (PROFILER_QUERY_LATENCY + 1)];
+		querySet.pending = false;
+		querySet.frame = frameCount;
+		for (int i = 0; i < Sample_LAST; ++i)
+		{
+			querySet.issued[i] = false;
+			recorded[i] = false;
+		}
+
+		frameOpen = true;
+		resolutionScale = 1.0f;
+	}
+	else if (!frameOpen)
+	{
+		return;
+	}
+
+	QuerySet& querySet = querySets[frameCount % (PROFILER_QUERY_LATENCY + 1)];
+	glQueryCounter(querySet.queries[sampleType], GL_TIMESTAMP);
+	querySet.issued[sampleType] = true;
+	querySet.pending = true;
+
+	cpuSamples[sampleType] = clock::now();
+	recorded[sampleType] = true;
+	if (sampleType == Sample_FrameStart && frameCount == 0)
+		firstFrameStart = cpuSamples[sampleType];
+}
+
+void Profiler::setResolutionScale(float scale)
+{
+	resolutionScale = scale;
+}
+
+void Profiler::closeFrame()
+{
+	FrameTimes& times = historyOf(frameCount);
+	times.frame = frameCount;
+	times.startMs = std::chrono::duration<double, std::milli>(cpuSamples[Sample_FrameStart] - firstFrameStart).count();
+	times.resolutionScale = resolutionScale;
+
+	// every stage runs from the sample before it, skipping samples that weren't recorded this frame
+	int previous = Sample_FrameStart;
+	for (int i = 1; i < Sample_LAST; ++i)
+	{
+		times.cpuMs[i] = 0.0;
+		times.gpuMs[i] = -1.0;
+		if (!recorded[i])
+			continue;
+
+		times.cpuMs[i] = std::chrono::duration<double, std::milli>(cpuSamples[i] - cpuSamples[previous]).count();
+		previous = i;
+	}
+	times.cpuMs[0] = std::chrono::duration<double, std::milli>(cpuSamples[previous] - cpuSamples[Sample_FrameStart]).count();
+	times.gpuMs[0] = -1.0;
+
+	++frameCount;
+	frameOpen = false;
+}
+
+bool Profiler::readQueries(QuerySet& querySet)
+{
+	// queries finish in order, so once the last one is there they all are
+	int last = Sample_FrameStart;
+	for (int i = 1; i < Sample_LAST; ++i)
+	{
+		if (querySet.issued[i])
+			last = i;
+	}
+
+	GLint available = 0;
+	glGetQueryObjectiv(querySet.queries[last], GL_QUERY_RESULT_AVAILABLE, &available);
+	if (!available)
+		return false;
+	querySet.pending = false;
+
+	// the frame may still be open, or long gone from the history
+	if (querySet.frame >= frameCount || querySet.frame < getFirstFrame())
+		return true;
+
+	GLuint64 timestamps[Sample_LAST];
+	for (int i = 0; i < Sample_LAST; ++i)
+	{
+		if (querySet.issued[i])
+			glGetQueryObjectui64v(querySet.queries[i], GL_QUERY_RESULT, &timestamps[i]);
+	}
+
+	FrameTimes& times = historyOf(querySet.frame);
+	int previous = Sample_FrameStart;
+	for (int i = 1; i < Sample_LAST; ++i)
+	{
+		if (!querySet.issued[i])
+			continue;
+
+		times.gpuMs[i] = (timestamps[i] - timestamps[previous]) / 1e6;
+		previous = i;
+	}
+	times.gpuMs[0] = (timestamps[previous] - timestamps[Sample_FrameStart]) / 1e6;
+	return true;
+}
+
+unsigned long long Profiler::getFirstFrame() const
+{
+	return frameCount > PROFILER_HISTORY_FRAMES ? frameCount - PROFILER_HISTORY_FRAMES : 0;
+}
+
+void Profiler::getAverages(double cpuMs[Sample_LAST], double gpuMs[Sample_LAST]) const
+{
+	int cpuFrames = 0, gpuFrames = 0;
+	for (int i = 0; i < Sample_LAST; ++i)
+		cpuMs[i] = gpuMs[i] = 0.0;
+
+	for (unsigned long long frame = getFirstFrame(); frame < frameCount; ++frame)
+	{
+		const FrameTimes& times = history[frame % PROFILER_HISTORY_FRAMES];
+		++cpuFrames;
+		for (int i = 0; i < Sample_LAST; ++i)
+			cpuMs[i] += times.cpuMs[i];
+
+		if (times.gpuMs[0] < 0.0)
+			continue;
+		++gpuFrames;
+		for (int i = 0; i < Sample_LAST; ++i)
+			gpuMs[i] += times.gpuMs[i] > 0.0 ? times.gpuMs[i] : 0.0;
+	}
+
+	for (int i = 0; i < Sample_LAST; ++i)
+	{
+		if (cpuFrames > 0)
+			cpuMs[i] /= cpuFrames;
+		if (gpuFrames > 0)
+			gpuMs[i] /= gpuFrames;
+	}
+}
+
+const Profiler::FrameTimes* Profiler::getLastCompleteFrame() const
+{
+	for (unsigned long long frame = frameCount; frame > getFirstFrame(); --frame)
+	{
+		const FrameTimes& times = history[(frame - 1) % PROFILER_HISTORY_FRAMES];
+		if (times.gpuMs[0] >= 0.0)
+			return &times;
+	}
+	return NULL;
+}
+
+bool Profiler::dumpCSV(const string& path) const
+{
+	FILE* file = fopen(path.c_str(), "w");
+	if (!file)
+		return false;
+
+	fprintf(file, "frame,start_ms,resolution_scale");
+	for (int i = 0; i < Sample_LAST; ++i)
+		fprintf(file, ",%s_cpu_ms", getSampleName((SampleType)i));
+	for (int i = 0; i < Sample_LAST; ++i)
+		fprintf(file, ",%s_gpu_ms", getSampleName((SampleType)i));
+	fprintf(file, "\n");
+
+	for (unsigned long long frame = getFirstFrame(); frame < frameCount; ++frame)
+	{
+		const FrameTimes& times = history[frame % PROFILER_HISTORY_FRAMES];
+		fprintf(file, "%llu,%.3f,%.3f", times.frame, times.startMs, times.resolutionScale);
+		for (int i = 0; i < Sample_LAST; ++i)
+			fprintf(file, ",%.4f", times.cpuMs[i]);
+		for (int i = 0; i < Sample_LAST; ++i)
+			fprintf(file, ",%.4f", times.gpuMs[i]);
+		fprintf(file, "\n");
+	}
+
+	fclose(file);
+	return true;
+}
+
+// writes one {"stage": ms, ...} object
+static void writeStages(FILE* file, const double ms[Profiler::Sample_LAST])
+{
+	fprintf(file, "{");
+	for (int i = 0; i < Profiler::Sample_LAST; ++i)
+		fprintf(file, "%s\"%s\": %.4f", i > 0 ? ", " : " ", Profiler::getSampleName((Profiler::SampleType)i), ms[i]);
+	fprintf(file, " }");
+}
+
+bool Profiler::dumpJSON(const string& path) const
+{
+	FILE* file = fopen(path.c_str(), "w");
+	if (!file)
+		return false;
+
+	double cpuAverages[Sample_LAST], gpuAverages[Sample_LAST];
+	getAverages(cpuAverages, gpuAverages);
+
+	fprintf(file, "{\n");
+	fprintf(file, "  \"average_cpu_ms\": ");
+	writeStages(file, cpuAverages);
+	fprintf(file, ",\n  \"average_gpu_ms\": ");
+	writeStages(file, gpuAverages);
+	fprintf(file, ",\n  \"frames\": [\n");
+	for (unsigned long long frame = getFirstFrame(); frame < frameCount; ++frame)
+	{
+		const FrameTimes& times = history[frame % PROFILER_HISTORY_FRAMES];
+		fprintf(file, "    { \"frame\": %llu, \"start_ms\": %.3f, \"resolution_scale\": %.3f, \"cpu_ms\": ", times.frame, times.startMs,
+			times.resolutionScale);
+		writeStages(file, times.cpuMs);
+		fprintf(file, ", \"gpu_ms\": ");
+		writeStages(file, times.gpuMs);
+		fprintf(file, " }%s\n", frame + 1 < frameCount ? "," : "");
+	}
+	fprintf(file, "  ]\n}\n");
+
+	fclose(file);
+	return true;
+}
+
+void Profiler::cleanup()
+{
+	if (!queriesCreated)
+		return;
+
+	for (int i = 0; i <= PROFILER_QUERY_LATENCY; ++i)
+	{
+		glDeleteQueries(Sample_LAST, querySets[i].queries);
+		querySets[i].pending = false;
+	}
+	queriesCreated = false;
+}
+
+const char* Profiler::getSampleName(SampleType sampleType)
+{
+	switch (sampleType)
+	{
+	case Sample_FrameStart:				return "frame";
+	case Sample_AfterGameProcessing:	return "game_processing";
+	case Sample_AfterUniformSetup:		return "uniform_setup";
+	case Sample_AfterSceneRender:		return "scene_render";
+	case Sample_AfterPresent:			return "present";
+	default:							return "unknown";
+	}
+}
@@ -0,0 +1,101 @@
+#ifndef _PROFILER_H
+#define _PROFILER_H
+
+#include <chrono>
+#include <vector>
+#include <string>
+
+#include <GL/glew.h>
+
+using namespace std;
+
+// frames of per-stage times kept around for averages and dumps
+#define PROFILER_HISTORY_FRAMES 300
+// frames between issuing the GPU timestamp queries and reading them back, so reading never stalls
+#define PROFILER_QUERY_LATENCY 3
+#define PROFILER_CSV_PATH "profile.csv"
+#define PROFILER_JSON_PATH "profile.json"
+
+// Frame profiler. Like RenderProfiler in the SDK samples, every sample marks a point in the frame,
+// and a stage is the time from the previous sample to its own. Each sample records the CPU time and
+// puts a GL timestamp query in the command stream, so every stage has a CPU and a GPU time.
+// The queries are read back PROFILER_QUERY_LATENCY frames later, and only once the GPU has them.
+class Profiler
+{
+public:
+	enum SampleType
+	{
+		Sample_FrameStart,
+		Sample_AfterGameProcessing,		// simulation ticks
+		Sample_AfterUniformSetup,		// frame and material uniform blocks
+		Sample_AfterSceneRender,		// Factory::draw
+		Sample_AfterPresent,			// glfwSwapBuffers
+
+		Sample_LAST
+	};
+
+	struct FrameTimes
+	{
+		unsigned long long frame;
+		double startMs;				// since the first frame
+		float resolutionScale;		// the scene was drawn at, see DynamicResolution
+		// time of each stage, ending at the sample with the same index. Element 0 is the whole frame.
+		double cpuMs[Sample_LAST];
+		double gpuMs[Sample_LAST];	// negative until the queries come back, or if they never did
+	};
+
+	Profiler();
+
+	// Sample_FrameStart closes the previous frame and opens the next one.
+	// Other samples are ignored when no frame is open, so code shared with tools that don't profile can still record.
+	void recordSample(SampleType sampleType);
+	// the resolution scale the open frame is drawn at, it's 1 unless this is called
+	void setResolutionScale(float scale);
+
+	// averages over the history, for frames that have their GPU times
+	void getAverages(double cpuMs[Sample_LAST], double gpuMs[Sample_LAST]) const;
+	// the newest frame that has its GPU times, NULL if there isn't one yet
+	const FrameTimes* getLastCompleteFrame() const;
+
+	bool dumpCSV(const string& path) const;
+	bool dumpJSON(const string& path) const;
+
+	// deletes the queries, needs the GL context that recorded them
+	void cleanup();
+
+	static const char* getSampleName(SampleType sampleType);
+
+private:
+	typedef std::chrono::steady_clock clock;
+
+	// a set of Sample_LAST timestamp queries per frame in flight
+	struct QuerySet
+	{
+		GLuint queries[Sample_LAST];
+		bool issued[Sample_LAST];
+		unsigned long long frame;	// the frame the queries were issued in
+		bool pending;				// issued and not read back yet
+	};
+
+	void closeFrame();
+	// false if the GPU isn't done with the queries yet
+	bool readQueries(QuerySet& querySet);
+	// the history entry of a frame, oldest first from getFirstFrame()
+	FrameTimes& historyOf(unsigned long long frame) { return history[frame % PROFILER_HISTORY_FRAMES]; }
+	unsigned long long getFirstFrame() const;
+
+	vector<FrameTimes> history;
+	unsigned long long frameCount;	// frames closed so far
+	bool frameOpen;
+
+	// CPU time of every sample of the open frame
+	clock::time_point cpuSamples[Sample_LAST];
+	bool recorded[Sample_LAST];
+	clock::time_point firstFrameStart;
+	float resolutionScale;
+
+	QuerySet querySets[PROFILER_QUERY_LATENCY + 1];
+	bool queriesCreated;
+};
+
+#endif
@@ -0,0 +1,477 @@
+#include "RenderBenchmark.h"
+#include "Window.h"
+#include "Molecule.h"
+#include "Factory.h"
+#include "RenderQueue.h"
+#include "GLState.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <algorithm>
+
+#include <glm/gtc/constants.hpp>
+
+#ifdef USE_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+static EGLDisplay eglDisplay = EGL_NO_DISPLAY;
+static EGLContext eglContext = EGL_NO_CONTEXT;
+#endif
+
+typedef std::chrono::steady_clock BenchClock;
+
+// by StereoMode
+static const char* stereoNames[] = { "off", "instanced", "multipass" };
+
+static double elapsedMs(BenchClock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(BenchClock::now() - start).count();
+}
+
+bool RenderBenchmark::parseArgs(int argc, char** argv, RenderBenchmarkOptions& options)
+{
+	options.frames = BENCH_DEFAULT_FRAMES;
+	options.width = BENCH_DEFAULT_WIDTH;
+	options.height = BENCH_DEFAULT_HEIGHT;
+	options.reportPath = "";
+	options.vertexFormats = false;
+	options.stereo = STEREO_OFF;
+	options.immediate = false;
+
+	bool benchmark = false;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "--bench-render") == 0 || strcmp(argv[i], "--bench-vertex-formats") == 0)
+		{
+			benchmark = true;
+			options.vertexFormats = strcmp(argv[i], "--bench-vertex-formats") == 0;
+			// the frame count is optional
+			if (i + 1 < argc && atoi(argv[i + 1]) > 0)
+				options.frames = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--size") == 0 && i + 1 < argc)
+		{
+			if (sscanf(argv[++i], "%dx%d", &options.width, &options.height) != 2 || options.width <= 0 || options.height <= 0)
+			{
+				fprintf(stderr, "Bad benchmark size %s, using %dx%d\n", argv[i], BENCH_DEFAULT_WIDTH, BENCH_DEFAULT_HEIGHT);
+				options.width = BENCH_DEFAULT_WIDTH;
+				options.height = BENCH_DEFAULT_HEIGHT;
+			}
+		}
+		else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc)
+		{
+			options.reportPath = argv[++i];
+		}
+		else if (strcmp(argv[i], "--stereo") == 0)
+		{
+			options.stereo = STEREO_INSTANCED;
+		}
+		else if (strcmp(argv[i], "--stereo-multipass") == 0)
+		{
+			options.stereo = STEREO_MULTIPASS;
+		}
+		else if (strcmp(argv[i], "--immediate") == 0)
+		{
+			options.immediate = true;
+		}
+	}
+	if (options.reportPath.empty())
+		options.reportPath = options.vertexFormats ? BENCH_VERTEX_FORMAT_REPORT : BENCH_DEFAULT_REPORT;
+	return benchmark;
+}
+
+bool RenderBenchmark::createContext(const RenderBenchmarkOptions& options, GLFWwindow*& window)
+{
+	window = NULL;
+
+#ifdef USE_EGL
+	// a display that isn't tied to any window system or GPU, Mesa falls back to llvmpipe
+	PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+	if (getPlatformDisplay)
+		eglDisplay = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+	if (eglDisplay == EGL_NO_DISPLAY || !eglInitialize(eglDisplay, NULL, NULL))
+	{
+		fprintf(stderr, "Failed to initialize a surfaceless EGL display.\n");
+		return false;
+	}
+
+	const EGLint attribs[] =
+	{
+		EGL_CONTEXT_MAJOR_VERSION, 3,
+		EGL_CONTEXT_MINOR_VERSION, 3,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE
+	};
+	eglBindAPI(EGL_OPENGL_API);
+	eglContext = eglCreateContext(eglDisplay, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, attribs);
+
+	// no surface at all, everything is drawn into the FBO
+	if (eglContext == EGL_NO_CONTEXT || !eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, eglContext))
+	{
+		fprintf(stderr, "Failed to create a surfaceless OpenGL 3.3 context.\n");
+		eglTerminate(eglDisplay);
+		return false;
+	}
+#else
+	if (!glfwInit())
+	{
+		fprintf(stderr, "Failed to initialize GLFW\n");
+		return false;
+	}
+
+	glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+#ifdef __APPLE__
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+
+	window = glfwCreateWindow(options.width, options.height, "CO2RemovalVR benchmark", NULL, NULL);
+	if (!window)
+	{
+		fprintf(stderr, "Failed to create the benchmark context.\n");
+		glfwTerminate();
+		return false;
+	}
+	glfwMakeContextCurrent(window);
+
+	// nothing is presented, so never wait for vsync
+	glfwSwapInterval(0);
+#endif
+
+	// the scene is created after this, so every run spawns the same molecules
+	Molecule::seedRandom(BENCH_SEED);
+	return true;
+}
+
+void RenderBenchmark::destroyContext(GLFWwindow* window)
+{
+#ifdef USE_EGL
+	eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	eglDestroyContext(eglDisplay, eglContext);
+	eglTerminate(eglDisplay);
+	eglContext = EGL_NO_CONTEXT;
+	eglDisplay = EGL_NO_DISPLAY;
+#else
+	glfwDestroyWindow(window);
+	glfwTerminate();
+#endif
+}
+
+// the GPU time between a frame's start and end timestamps
+static double readGpuMs(const GLuint* frameQueries)
+{
+	GLuint64 start = 0, end = 0;
+	glGetQueryObjectui64v(frameQueries[0], GL_QUERY_RESULT, &start);
+	glGetQueryObjectui64v(frameQueries[1], GL_QUERY_RESULT, &end);
+	return end >= start ? (end - start) / 1e6 : -1.0;
+}
+
+// single sampled offscreen target, so the numbers don't depend on how the driver resolves
+struct OffscreenTarget
+{
+	GLuint FBO, colorBuffer, depthBuffer;
+};
+
+static bool createTarget(const RenderBenchmarkOptions& options, OffscreenTarget& target)
+{
+	glGenFramebuffers(1, &target.FBO);
+	glGenRenderbuffers(1, &target.colorBuffer);
+	glGenRenderbuffers(1, &target.depthBuffer);
+
+	glBindRenderbuffer(GL_RENDERBUFFER, target.colorBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, options.width, options.height);
+	glBindRenderbuffer(GL_RENDERBUFFER, target.depthBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, options.width, options.height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	GLState::bindFramebuffer(GL_FRAMEBUFFER, target.FBO);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, target.colorBuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, target.depthBuffer);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		fprintf(stderr, "ERROR::BENCHMARK::Offscreen framebuffer is not complete\n");
+		GLState::bindFramebuffer(GL_FRAMEBUFFER, 0);
+		return false;
+	}
+
+	Window::resize_callback(NULL, options.width, options.height);
+	// there's no headset, so a made up one with an eye in each half of the target
+	Window::set_stereo(options.stereo, HmdDescription::synthetic(HMD_DEFAULT_FOV, HMD_DEFAULT_IPD, options.width / 2, options.height));
+	RenderQueue::setEnabled(!options.immediate);
+	return true;
+}
+
+static void destroyTarget(OffscreenTarget& target)
+{
+	GLState::bindFramebuffer(GL_FRAMEBUFFER, 0);
+	glDeleteRenderbuffers(1, &target.colorBuffer);
+	glDeleteRenderbuffers(1, &target.depthBuffer);
+	GLState::deleteFramebuffers(1, &target.FBO);
+}
+
+void RenderBenchmark::renderFrames(const RenderBenchmarkOptions& options, Model* model, vector<FrameResult>& frames)
+{
+	// a start and an end timestamp for every frame in flight
+	GLuint queries[2 * (BENCH_QUERY_LATENCY + 1)];
+	glGenQueries(2 * (BENCH_QUERY_LATENCY + 1), queries);
+
+	frames.resize(options.frames);
+
+	// don't count the uploads done while loading
+	RenderStats::endFrame();
+
+	for (int i = 0; i < options.frames; ++i)
+	{
+		// orbit the factory once over the whole run
+		float angle = glm::two_pi<float>() * i / options.frames;
+		glm::vec3 eye(BENCH_ORBIT_RADIUS * sin(angle), BENCH_ORBIT_HEIGHT, BENCH_ORBIT_RADIUS * cos(angle));
+		Window::set_camera(eye, glm::vec3(0.0f));
+		if (!model)
+			Window::update_objects();
+
+		GLuint* frameQueries = &queries[2 * (i % (BENCH_QUERY_LATENCY + 1))];
+		BenchClock::time_point submitStart = BenchClock::now();
+		glQueryCounter(frameQueries[0], GL_TIMESTAMP);
+		if (model)
+			Window::render_model(*model);
+		else
+			Window::render_frame(1.0f);
+		glQueryCounter(frameQueries[1], GL_TIMESTAMP);
+		frames[i].cpuMs = elapsedMs(submitStart);
+		frames[i].gpuMs = -1.0;
+
+		RenderStats::endFrame();
+		frames[i].stats = RenderStats::lastFrame;
+
+		// the frame from BENCH_QUERY_LATENCY frames ago should be done by now
+		if (i >= BENCH_QUERY_LATENCY)
+			frames[i - BENCH_QUERY_LATENCY].gpuMs = readGpuMs(&queries[2 * ((i - BENCH_QUERY_LATENCY) % (BENCH_QUERY_LATENCY + 1))]);
+	}
+
+	// wait for the last frames and collect their times
+	glFinish();
+	for (int i = max(0, options.frames - BENCH_QUERY_LATENCY); i < options.frames; ++i)
+		frames[i].gpuMs = readGpuMs(&queries[2 * (i % (BENCH_QUERY_LATENCY + 1))]);
+
+	glDeleteQueries(2 * (BENCH_QUERY_LATENCY + 1), queries);
+}
+
+int RenderBenchmark::run(const RenderBenchmarkOptions& options)
+{
+	OffscreenTarget target;
+	if (!createTarget(options, target))
+		return EXIT_FAILURE;
+
+	printf("Rendering %d benchmark frames at %dx%d, stereo %s, %s...\n", options.frames, options.width, options.height, stereoNames[options.stereo],
+		options.immediate ? "immediate" : "render queue");
+	vector<FrameResult> frames;
+	BenchClock::time_point runStart = BenchClock::now();
+	renderFrames(options, NULL, frames);
+	double wallMs = elapsedMs(runStart);
+
+	destroyTarget(target);
+
+	if (!writeReport(options, frames, wallMs))
+		return EXIT_FAILURE;
+
+	printf("Wrote %s\n", options.reportPath.c_str());
+	return EXIT_SUCCESS;
+}
+
+int RenderBenchmark::runVertexFormats(const RenderBenchmarkOptions& options)
+{
+	OffscreenTarget target;
+	if (!createTarget(options, target))
+		return EXIT_FAILURE;
+
+	const char* paths[] = { FACTORY_PATH, BENCH_NANOSUIT_PATH };
+	// packed last, so that's what stays cooked
+	const VertexFormat formats[] = { VERTEX_FLOAT, VERTEX_PACKED };
+
+	vector<VertexFormatResult> results;
+	for (size_t p = 0; p < sizeof(paths) / sizeof(paths[0]); ++p)
+	{
+		for (size_t f = 0; f < sizeof(formats) / sizeof(formats[0]); ++f)
+		{
+			if (!Model::cook(paths[p], formats[f]))
+			{
+				destroyTarget(target);
+				return EXIT_FAILURE;
+			}
+
+			VertexFormatResult result;
+			result.path = paths[p];
+			result.format = formats[f];
+
+			// loads the file that was just cooked, so the buffers hold exactly what's on disk
+			size_t uploaded = RenderStats::current.geometryBytesUploaded;
+			Model model(paths[p]);
+			result.geometryBytes = RenderStats::current.geometryBytesUploaded - uploaded;
+
+			printf("Rendering %d frames of %s with %s vertices...\n", options.frames, paths[p],
+				formats[f] == VERTEX_PACKED ? "packed" : "float");
+			renderFrames(options, &model, result.frames);
+
+			vector<double> gpuTimes = getGpuTimes(result.frames);
+			sort(gpuTimes.begin(), gpuTimes.end());
+			if (gpuTimes.empty())
+				printf("  %zu bytes of geometry, no GPU times came back\n", result.geometryBytes);
+			else
+				printf("  %zu bytes of geometry, median GPU time %.3f ms\n", result.geometryBytes, gpuTimes[gpuTimes.size() / 2]);
+			results.push_back(result);
+		}
+	}
+
+	destroyTarget(target);
+
+	if (!writeVertexFormatReport(options, results))
+		return EXIT_FAILURE;
+
+	printf("Wrote %s\n", options.reportPath.c_str());
+	return EXIT_SUCCESS;
+}
+
+// a JSON string, quotes included
+static void writeString(FILE* file, const char* text)
+{
+	fputc('"', file);
+	for (const unsigned char* c = (const unsigned char*)text; *c; ++c)
+	{
+		if (*c == '"' || *c == '\\')
+			fprintf(file, "\\%c", *c);
+		else if (*c < 0x20)
+			fprintf(file, "\\u%04x", *c);
+		else
+			fputc(*c, file);
+	}
+	fputc('"', file);
+}
+
+// mean, median, 95th percentile and max of a list of times, as a JSON object
+static void writeTimes(FILE* file, vector<double> times)
+{
+	if (times.empty())
+	{
+		fprintf(file, "{ \"mean\": null, \"median\": null, \"p95\": null, \"max\": null }");
+		return;
+	}
+
+	sort(times.begin(), times.end());
+	double total = 0.0;
+	for (size_t i = 0; i < times.size(); ++i)
+		total += times[i];
+
+	fprintf(file, "{ \"mean\": %.4f, \"median\": %.4f, \"p95\": %.4f, \"max\": %.4f }",
+		total / times.size(), times[times.size() / 2], times[(times.size() * 95) / 100], times.back());
+}
+
+static void writeSummary(FILE* file, const char* name, const vector<double>& times)
+{
+	fprintf(file, "  \"%s\": ", name);
+	writeTimes(file, times);
+	fprintf(file, ",\n");
+}
+
+bool RenderBenchmark::writeReport(const RenderBenchmarkOptions& options, const vector<FrameResult>& frames, double wallMs)
+{
+	FILE* file = fopen(options.reportPath.c_str(), "w");
+	if (!file)
+	{
+		fprintf(stderr, "ERROR::BENCHMARK::Can't write %s\n", options.reportPath.c_str());
+		return false;
+	}
+
+	vector<double> cpuTimes;
+	for (size_t i = 0; i < frames.size(); ++i)
+		cpuTimes.push_back(frames[i].cpuMs);
+
+	fprintf(file, "{\n");
+	fprintf(file, "  \"benchmark\": \"render\",\n");
+	fprintf(file, "  \"renderer\": ");
+	writeString(file, (const char*)glGetString(GL_RENDERER));
+	fprintf(file, ",\n");
+	fprintf(file, "  \"width\": %d,\n", options.width);
+	fprintf(file, "  \"height\": %d,\n", options.height);
+	fprintf(file, "  \"stereo\": \"%s\",\n", stereoNames[options.stereo]);
+	fprintf(file, "  \"render_queue\": %s,\n", options.immediate ? "false" : "true");
+	fprintf(file, "  \"frames\": %d,\n", options.frames);
+	fprintf(file, "  \"wall_ms\": %.3f,\n", wallMs);
+	writeSummary(file, "cpu_submit_ms", cpuTimes);
+	writeSummary(file, "gpu_ms", getGpuTimes(frames));
+	fprintf(file, "  \"per_frame\": [\n");
+	for (size_t i = 0; i < frames.size(); ++i)
+	{
+		const FrameStats& stats = frames[i].stats;
+		fprintf(file, "    { \"frame\": %u, \"cpu_submit_ms\": %.4f, \"gpu_ms\": %.4f, \"draw_calls\": %u, \"triangles\": %u, \"culled\": %u, "
+			"\"state_changes\": %u, \"program_binds\": %u, \"vertex_array_binds\": %u, \"buffer_binds\": %u, \"texture_binds\": %u, "
+			"\"render_state_changes\": %u, \"uniform_updates\": %u, \"redundant_state_calls\": %u, \"stream_bytes\": %u }%s\n",
+			(unsigned)i, frames[i].cpuMs, frames[i].gpuMs, (unsigned)stats.drawCalls, (unsigned)stats.trianglesDrawn,
+			(unsigned)stats.objectsCulled, (unsigned)stats.stateChanges(), (unsigned)stats.programBinds, (unsigned)stats.vertexArrayBinds, (unsigned)stats.bufferBinds,
+			(unsigned)stats.textureBinds, (unsigned)stats.renderStateChanges, (unsigned)stats.uniformUpdates, (unsigned)stats.redundantStateCalls,
+			(unsigned)stats.streamBytesUploaded, i + 1 < frames.size() ? "," : "");
+	}
+	fprintf(file, "  ]\n");
+	fprintf(file, "}\n");
+
+	fclose(file);
+	return true;
+}
+
+vector<double> RenderBenchmark::getGpuTimes(const vector<FrameResult>& frames)
+{
+	vector<double> times;
+	for (size_t i = 0; i < frames.size(); ++i)
+	{
+		if (frames[i].gpuMs >= 0.0)
+			times.push_back(frames[i].gpuMs);
+	}
+	return times;
+}
+
+bool RenderBenchmark::writeVertexFormatReport(const RenderBenchmarkOptions& options, const vector<VertexFormatResult>& results)
+{
+	FILE* file = fopen(options.reportPath.c_str(), "w");
+	if (!file)
+	{
+		fprintf(stderr, "ERROR::BENCHMARK::Can't write %s\n", options.reportPath.c_str());
+		return false;
+	}
+
+	fprintf(file, "{\n");
+	fprintf(file, "  \"benchmark\": \"vertex_formats\",\n");
+	fprintf(file, "  \"renderer\": ");
+	writeString(file, (const char*)glGetString(GL_RENDERER));
+	fprintf(file, ",\n");
+	fprintf(file, "  \"width\": %d,\n", options.width);
+	fprintf(file, "  \"height\": %d,\n", options.height);
+	fprintf(file, "  \"frames\": %d,\n", options.frames);
+	fprintf(file, "  \"models\": [\n");
+	for (size_t i = 0; i < results.size(); ++i)
+	{
+		const VertexFormatResult& result = results[i];
+		vector<double> cpuTimes;
+		for (size_t j = 0; j < result.frames.size(); ++j)
+			cpuTimes.push_back(result.frames[j].cpuMs);
+
+		fprintf(file, "    { \"path\": ");
+		writeString(file, result.path.c_str());
+		fprintf(file, ", \"vertex_format\": \"%s\", \"vertex_size\": %d, \"geometry_bytes\": %u, \"triangles\": %u,\n",
+			result.format == VERTEX_PACKED ? "packed" : "float", (int)Mesh::getVertexSize(result.format),
+			(unsigned)result.geometryBytes, (unsigned)result.frames[0].stats.trianglesDrawn);
+		fprintf(file, "      \"cpu_submit_ms\": ");
+		writeTimes(file, cpuTimes);
+		fprintf(file, ",\n      \"gpu_ms\": ");
+		writeTimes(file, getGpuTimes(result.frames));
+		fprintf(file, " }%s\n", i + 1 < results.size() ? "," : "");
+	}
+	fprintf(file, "  ]\n");
+	fprintf(file, "}\n");
+
+	fclose(file);
+	return true;
+}
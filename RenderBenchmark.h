@@ -0,0 +1,96 @@
+#ifndef _RENDER_BENCHMARK_H
+#define _RENDER_BENCHMARK_H
+
+#include <string>
+#include <vector>
+
+#define GLFW_INCLUDE_GLEXT
+#ifdef __APPLE__
+#define GLFW_INCLUDE_GLCOREARB
+#else
+#include <GL/glew.h>
+#endif
+#include <GLFW/glfw3.h>
+
+#include "RenderStats.h"
+#include "mesh.h"
+#include "StereoCamera.h"
+
+using namespace std;
+
+#define BENCH_DEFAULT_FRAMES 600
+#define BENCH_DEFAULT_WIDTH 1280
+#define BENCH_DEFAULT_HEIGHT 720
+#define BENCH_DEFAULT_REPORT "render_benchmark.json"
+#define BENCH_VERTEX_FORMAT_REPORT "vertex_format_benchmark.json"
+// the vertex format benchmark draws this as well as the factory, it's by far the heaviest model we have
+#define BENCH_NANOSUIT_PATH "../Assets/nanosuit/nanosuit.obj"
+#define BENCH_SEED 1
+// frames between issuing the GPU timestamp queries and reading them back, so reading never stalls
+#define BENCH_QUERY_LATENCY 3
+// distance and height of the scripted camera orbit around the factory
+#define BENCH_ORBIT_RADIUS 20.0f
+#define BENCH_ORBIT_HEIGHT 5.0f
+
+struct RenderBenchmarkOptions
+{
+	int frames;
+	int width, height;
+	string reportPath;
+	bool vertexFormats;	// run the vertex format comparison instead of the scene
+	StereoMode stereo;	// with a synthetic headset whose eyes split the size between them
+	bool immediate;		// draw straight to GL instead of through the RenderQueue
+};
+
+class Model;
+
+// Renders the factory scene into an offscreen framebuffer for a fixed number of frames with a
+// scripted camera and one simulation tick per frame, so every run draws exactly the same frames.
+// Writes the CPU submit time, GPU time and draw/state counts of each frame to a JSON report.
+//
+// The context is a hidden GLFW window with vsync off, or a surfaceless EGL context when built with
+// USE_EGL (GLEW has to be built with GLEW_EGL for that), which runs on Mesa's llvmpipe on machines without a GPU.
+class RenderBenchmark
+{
+public:
+	// true if the command line asks for the benchmark: --bench-render [frames] [--size WxH] [--out report.json]
+	// [--stereo | --stereo-multipass] [--immediate], or --bench-vertex-formats [frames] with the same options
+	static bool parseArgs(int argc, char** argv, RenderBenchmarkOptions& options);
+
+	// creates and makes current the offscreen context. Returns the hidden window, which is NULL with EGL.
+	static bool createContext(const RenderBenchmarkOptions& options, GLFWwindow*& window);
+	static void destroyContext(GLFWwindow* window);
+
+	// runs the frames on the scene Window set up, then writes the report. Returns the exit code.
+	static int run(const RenderBenchmarkOptions& options);
+	// Cooks the factory and the nanosuit with float and then packed vertices and draws each
+	// one on its own with the same orbit, to show what halving the vertex size does.
+	// Leaves both cooked with packed vertices. Returns the exit code.
+	static int runVertexFormats(const RenderBenchmarkOptions& options);
+
+private:
+	struct FrameResult
+	{
+		double cpuMs;
+		double gpuMs;		// negative if the GPU time never came back
+		FrameStats stats;
+	};
+
+	struct VertexFormatResult
+	{
+		string path;
+		VertexFormat format;
+		size_t geometryBytes;	// vertex and index buffers of the whole model
+		vector<FrameResult> frames;
+	};
+
+	// Renders options.frames frames orbiting the scene, or only model if it's given. The GPU
+	// times are read back a few frames late so reading never stalls.
+	static void renderFrames(const RenderBenchmarkOptions& options, Model* model, vector<FrameResult>& frames);
+	static bool writeReport(const RenderBenchmarkOptions& options, const vector<FrameResult>& frames, double wallMs);
+	// the GPU times of frames, without the ones that never came back
+	static vector<double> getGpuTimes(const vector<FrameResult>& frames);
+	static bool writeVertexFormatReport(const RenderBenchmarkOptions& options, const vector<VertexFormatResult>& results);
+};
+
+#endif
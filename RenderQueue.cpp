@@ -0,0 +1,184 @@
+#include "RenderQueue.h"
+#include "mesh.h"
+#include "shader.h"
+#include "RenderStats.h"
+#include "GLState.h"
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+// how many bits each field of the key has, and where it starts
+#define KEY_PROGRAM_SHIFT 60
+#define KEY_PROGRAM_MASK 0xFull
+#define KEY_BAND_SHIFT 57
+#define KEY_BAND_MASK 0x7ull
+#define KEY_VERTEX_ARRAY_SHIFT 41
+#define KEY_VERTEX_ARRAY_MASK 0xFFFFull
+#define KEY_MATERIAL_SHIFT 33
+#define KEY_MATERIAL_MASK 0xFFull
+#define KEY_DEPTH_SHIFT 9
+#define KEY_DEPTH_MASK 0xFFFFFFull
+
+// the radix sort goes through the keys a byte at a time
+#define RADIX_BITS 8
+#define RADIX_BUCKETS (1 << RADIX_BITS)
+#define RADIX_PASSES (64 / RADIX_BITS)
+
+bool RenderQueue::enabled = true;
+glm::vec4 RenderQueue::depthRow = glm::vec4(0.0f, 0.0f, -1.0f, 0.0f);
+vector<DrawPacket> RenderQueue::packets;
+vector<RenderQueue::SortItem> RenderQueue::items;
+vector<RenderQueue::SortItem> RenderQueue::sortScratch;
+vector<GLuint> RenderQueue::programs;
+
+void RenderQueue::begin(const glm::mat4& view)
+{
+	packets.clear();
+	items.clear();
+	// the camera looks down -z
+	depthRow = -glm::vec4(view[0][2], view[1][2], view[2][2], view[3][2]);
+}
+
+void RenderQueue::submit(const DrawPacket& packet, const glm::vec3& position)
+{
+	float depth = glm::dot(depthRow, glm::vec4(position, 1.0f));
+
+	SortItem item;
+	item.key = makeKey(packet, depth);
+	item.packet = (uint32_t)packets.size();
+	items.push_back(item);
+	packets.push_back(packet);
+}
+
+// Fields that don't fit are cut down to the bits the key has for them. Packets that end up
+// with the same key are still drawn right, just not grouped as well.
+uint64_t RenderQueue::makeKey(const DrawPacket& packet, float depth)
+{
+	size_t program = find(programs.begin(), programs.end(), packet.program) - programs.begin();
+	if (program == programs.size())
+		programs.push_back(packet.program);
+
+	// the bands are 0 to 1, 1 to 2, 2 to 4 and so on, and everything past the last one
+	depth = min(max(depth, 0.0f), RENDER_QUEUE_MAX_DEPTH);
+	unsigned band = 0;
+	if (depth >= 1.0f)
+		band = min((unsigned)RENDER_QUEUE_DEPTH_BANDS - 1, (unsigned)log2f(depth) + 1);
+	uint64_t fineDepth = (uint64_t)(depth / RENDER_QUEUE_MAX_DEPTH * KEY_DEPTH_MASK);
+
+	return ((uint64_t)program & KEY_PROGRAM_MASK) << KEY_PROGRAM_SHIFT
+		| ((uint64_t)band & KEY_BAND_MASK) << KEY_BAND_SHIFT
+		| ((uint64_t)packet.mesh->getVertexArray() & KEY_VERTEX_ARRAY_MASK) << KEY_VERTEX_ARRAY_SHIFT
+		| ((uint64_t)packet.materialIndex & KEY_MATERIAL_MASK) << KEY_MATERIAL_SHIFT
+		| (fineDepth & KEY_DEPTH_MASK) << KEY_DEPTH_SHIFT;
+}
+
+// Least significant byte first, each pass stable, so what the earlier passes sorted by stays
+// in order among keys with the same byte. Passes over a byte every key has the same value in,
+// like the unused bottom of the key, are skipped.
+void RenderQueue::sort()
+{
+	size_t count = items.size();
+	if (count < 2)
+		return;
+
+	// the counts for every pass in one go over the keys
+	static size_t offsets[RADIX_PASSES][RADIX_BUCKETS];
+	memset(offsets, 0, sizeof(offsets));
+	for (size_t i = 0; i < count; ++i)
+	{
+		uint64_t key = items[i].key;
+		for (unsigned pass = 0; pass < RADIX_PASSES; ++pass)
+			offsets[pass][(key >> (pass * RADIX_BITS)) & (RADIX_BUCKETS - 1)]++;
+	}
+
+	sortScratch.resize(count);
+	SortItem* from = &items[0];
+	SortItem* to = &sortScratch[0];
+	for (unsigned pass = 0; pass < RADIX_PASSES; ++pass)
+	{
+		unsigned shift = pass * RADIX_BITS;
+		size_t* bucket = offsets[pass];
+		if (bucket[(from[0].key >> shift) & (RADIX_BUCKETS - 1)] == count)
+			continue;
+
+		// counts to where each bucket starts
+		size_t start = 0;
+		for (unsigned b = 0; b < RADIX_BUCKETS; ++b)
+		{
+			size_t bucketCount = bucket[b];
+			bucket[b] = start;
+			start += bucketCount;
+		}
+		for (size_t i = 0; i < count; ++i)
+			to[bucket[(from[i].key >> shift) & (RADIX_BUCKETS - 1)]++] = from[i];
+		swap(from, to);
+	}
+
+	// an odd number of passes leaves the sorted keys in the scratch buffer
+	if (from != &items[0])
+		items.swap(sortScratch);
+}
+
+void RenderQueue::execute()
+{
+	if (packets.empty())
+		return;
+	sort();
+
+	// the uniforms the packets drawn so far left behind, nothing is known about what came
+	// before them. GLState drops the program and VAO binds that don't change anything.
+	GLuint program = 0;
+	const ShaderUniforms* uniforms = NULL;
+	const Mesh* vertexUniformsOf = NULL;
+	const glm::mat4* model = NULL;
+	GLint instanced = -1;
+	GLint materialIndex = -1;
+	for (size_t i = 0; i < items.size(); ++i)
+	{
+		const DrawPacket& packet = packets[items[i].packet];
+		if (packet.program != program || !uniforms)
+		{
+			GLState::useProgram(packet.program);
+			program = packet.program;
+			uniforms = &GetShaderUniforms(program);
+			// every program has its own uniforms
+			vertexUniformsOf = NULL;
+			model = NULL;
+			instanced = -1;
+			materialIndex = -1;
+		}
+
+		GLState::bindVertexArray(packet.mesh->getVertexArray());
+		if (packet.mesh != vertexUniformsOf)
+		{
+			vertexUniformsOf = packet.mesh;
+			packet.mesh->setVertexUniforms(*uniforms);
+			RenderStats::current.uniformUpdates += 3;
+		}
+		if (packet.model != model)
+		{
+			model = packet.model;
+			glUniformMatrix4fv(uniforms->model, 1, GL_FALSE, &(*model)[0][0]);
+			RenderStats::current.uniformUpdates++;
+		}
+		GLint packetInstanced = packet.instanceCount > 0 ? GL_TRUE : GL_FALSE;
+		if (packetInstanced != instanced)
+		{
+			instanced = packetInstanced;
+			glUniform1i(uniforms->instanced, instanced);
+			RenderStats::current.uniformUpdates++;
+		}
+		if (packet.materialIndex != materialIndex)
+		{
+			materialIndex = packet.materialIndex;
+			glUniform1i(uniforms->materialIndex, materialIndex);
+			RenderStats::current.uniformUpdates++;
+		}
+
+		packet.mesh->drawBound(packet.lod, packet.instanceCount, packet.firstInstance);
+	}
+
+	packets.clear();
+	items.clear();
+}
@@ -0,0 +1,75 @@
+#ifndef _RENDER_QUEUE_H
+#define _RENDER_QUEUE_H
+
+#include <vector>
+#include <stdint.h>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+using namespace std;
+
+class Mesh;
+
+// Opaque packets are drawn front to back within bands of view depth that double in size,
+// this many of them, and by state inside a band
+#define RENDER_QUEUE_DEPTH_BANDS 8
+// depth past this, the far plane, sorts as if it were this
+#define RENDER_QUEUE_MAX_DEPTH 1000.0f
+
+// Everything one draw needs, with nothing bound yet
+struct DrawPacket
+{
+	GLuint program;
+	Mesh* mesh;				// its VAO and the index range of lod
+	unsigned lod;
+	GLint materialIndex;
+	const glm::mat4* model;	// toWorld, or toModel for instanced draws. Has to stay put until execute().
+	GLsizei instanceCount;	// 0 for a draw that isn't instanced
+	GLuint firstInstance;
+};
+
+// Collects the draws of a frame instead of drawing them right away, and draws them in the order
+// of a 64 bit key per packet:
+//
+//   63..60 program   59..57 depth band   56..41 VAO   40..33 material   32..9 depth
+//
+// The keys are radix sorted, and while the packets are drawn in that order a uniform is only
+// set when it's different from what the packet before left behind. GLState does the same for
+// the program and VAO.
+// Needs the camera of the frame being drawn, like LodSelector.
+class RenderQueue
+{
+public:
+	// Without the queue every draw goes straight to GL. Models and the MoleculeRenderer check
+	// this to know which way to draw.
+	static bool isEnabled() { return enabled; }
+	static void setEnabled(bool enabled) { RenderQueue::enabled = enabled; }
+
+	// Empties the queue for a frame seen through view
+	static void begin(const glm::mat4& view);
+	// position is where in the world the packet's depth is measured from
+	static void submit(const DrawPacket& packet, const glm::vec3& position);
+	// sorts and draws everything submitted since begin(), and empties the queue
+	static void execute();
+
+	static size_t getPacketCount() { return packets.size(); }
+
+private:
+	struct SortItem
+	{
+		uint64_t key;
+		uint32_t packet;
+	};
+
+	static bool enabled;
+	static glm::vec4 depthRow;	// the row of the view matrix that gives a point's distance in front of the camera
+	static vector<DrawPacket> packets;
+	static vector<SortItem> items, sortScratch;
+	static vector<GLuint> programs;	// the key has an index into this instead of the program name
+
+	static uint64_t makeKey(const DrawPacket& packet, float depth);
+	static void sort();
+};
+
+#endif
@@ -0,0 +1,10 @@
+#include "RenderStats.h"
+
+FrameStats RenderStats::current = FrameStats();
+FrameStats RenderStats::lastFrame = FrameStats();
+
+void RenderStats::endFrame()
+{
+	lastFrame = current;
+	current = FrameStats();
+}
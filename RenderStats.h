@@ -0,0 +1,41 @@
+#ifndef _RENDER_STATS_H
+#define _RENDER_STATS_H
+
+#include <cstddef>
+
+// Counters for the GL work done each frame. Code that talks to GL adds to the
+// current frame's counters; Window calls endFrame() once the frame is submitted.
+struct FrameStats
+{
+	size_t geometryBytesUploaded;	// vertex and index data sent by Mesh
+	size_t streamBytesUploaded;		// per-frame data like instance matrices
+	size_t textureBytesUploaded;	// decoded images sent by the AssetLoader
+
+	size_t drawCalls;
+	size_t trianglesDrawn;			// every instance counts
+	size_t objectsCulled;			// meshes and instances the frustum test kept from being drawn
+
+	// state changes, unbinds included
+	size_t programBinds;
+	size_t vertexArrayBinds;
+	size_t bufferBinds;
+	size_t textureBinds;			// active texture changes too
+	size_t renderStateChanges;		// enables, depth, blend and cull state, viewports and framebuffers
+	size_t uniformUpdates;			// glUniform* calls
+
+	// state changes GLState didn't pass on to GL, because they wouldn't have changed anything
+	size_t redundantStateCalls;
+
+	size_t stateChanges() const { return programBinds + vertexArrayBinds + bufferBinds + textureBinds + renderStateChanges + uniformUpdates; }
+};
+
+class RenderStats
+{
+public:
+	static FrameStats current;
+	static FrameStats lastFrame;
+
+	static void endFrame();
+};
+
+#endif
@@ -0,0 +1,34 @@
+#include "SimClock.h"
+
+SimClock::SimClock(double tickRate, int maxTicksPerFrame)
+{
+	this->tickSeconds = 1.0 / tickRate;
+	this->maxTicksPerFrame = maxTicksPerFrame;
+	reset();
+}
+
+void SimClock::reset()
+{
+	lastTime = clock::now();
+	accumulator = 0.0;
+	tickCount = 0;
+}
+
+int SimClock::advance()
+{
+	clock::time_point now = clock::now();
+	accumulator += std::chrono::duration<double>(now - lastTime).count();
+	lastTime = now;
+
+	int ticks = (int)(accumulator / tickSeconds);
+	if (ticks > maxTicksPerFrame)
+	{
+		// we can't keep up, drop the time we are behind instead of trying to catch up with it
+		ticks = maxTicksPerFrame;
+		accumulator = ticks * tickSeconds;
+	}
+
+	accumulator -= ticks * tickSeconds;
+	tickCount += ticks;
+	return ticks;
+}
@@ -0,0 +1,36 @@
+#ifndef _SIM_CLOCK_H
+#define _SIM_CLOCK_H
+
+#include <chrono>
+
+// The molecule speeds were tuned for one update per frame at 60Hz
+#define SIM_TICK_RATE 60.0
+// Never run more ticks than this in one frame, so a slow frame can't make the next one even slower
+#define MAX_TICKS_PER_FRAME 5
+
+// Fixed timestep clock for the simulation. Every frame, advance() says how many fixed ticks to
+// run to catch up with the wall clock, and getAlpha() says how far rendering is between the last two ticks.
+class SimClock
+{
+public:
+	SimClock(double tickRate = SIM_TICK_RATE, int maxTicksPerFrame = MAX_TICKS_PER_FRAME);
+
+	int advance();
+	void reset();
+
+	float getAlpha() const { return (float)(accumulator / tickSeconds); }
+	double getTickSeconds() const { return tickSeconds; }
+	unsigned long long getTickCount() const { return tickCount; }
+
+private:
+	// steady_clock is monotonic, unlike std::clock() (CPU time) or the system clock
+	typedef std::chrono::steady_clock clock;
+
+	clock::time_point lastTime;
+	double accumulator;
+	double tickSeconds;
+	int maxTicksPerFrame;
+	unsigned long long tickCount;
+};
+
+#endif
@@ -0,0 +1,115 @@
+#include "Simulation.h"
+
+#include <iostream>
+
+using namespace std;
+
+Simulation::Simulation(JobSystem* jobs, size_t capacity) : molecules(capacity), collisionGrid(COLLISION_CELL_SIZE)
+{
+	this->jobs = jobs;
+	numContacts = 0;
+	gameWon = false;
+	gameLost = false;
+
+	// Create the first five molecules
+	numCO2Molecules = NUM_MOL_INIT;
+	for (int i = 0; i < NUM_MOL_INIT; ++i)
+	{
+		Molecule::spawn(molecules);
+	}
+
+	ticksSinceEmit = 0;
+}
+
+void Simulation::update()
+{
+	// YOU WIN!
+	if (!gameWon && numCO2Molecules <= 0)
+	{
+		gameWon = true;
+
+		// the molecules stop here, so stop interpolating them
+		molecules.resetHistory();
+
+		cout << "*************** YOU WIN!!!! *****************" << endl;
+	}
+
+	// Emit a new CO2 molecule every second
+	else if (!gameWon && numCO2Molecules <= MAX_MOLS)
+	{
+		if (++ticksSinceEmit >= SECS_BTWN_EMIT * SIM_TICK_RATE)
+		{
+			Molecule::spawn(molecules);
+			++numCO2Molecules;
+			ticksSinceEmit = 0;
+		}
+
+		step();
+	}
+
+	// YOU LOSE
+	else if (!gameLost && !gameWon)
+	{
+		// spawn a bunch of molecules because you hate the environment
+		for (int i = 0; i < MOLS_ON_LOSE; ++i)
+		{
+			Molecule molecule = Molecule::spawn(molecules);
+			if (molecule.isAlive())
+				molecule.randomizePosition();
+		}
+		gameLost = true;
+		molecules.resetHistory();
+
+		cout << "*************** YOU LOSE!!!! *****************" << endl;
+	}
+}
+
+void Simulation::step()
+{
+	updateMolecules();
+	collideMolecules();
+}
+
+void Simulation::updateMolecules()
+{
+	if (!jobs)
+	{
+		// one linear pass over the molecule arrays
+		molecules.update();
+		return;
+	}
+
+	// every molecule moves independently, so the arrays can be split into chunks across the workers
+	MoleculeStore& store = molecules;
+	jobs->parallelFor(molecules.size(), MOLS_PER_UPDATE_JOB, [&store](size_t begin, size_t end)
+	{
+		store.update(begin, end);
+	});
+}
+
+void Simulation::collideMolecules()
+{
+	collisionGrid.build(molecules.posX.data(), molecules.posY.data(), molecules.posZ.data(), molecules.size());
+	numContacts = molecules.collide(collisionGrid);
+}
+
+// called after game win/loss and user presses a button
+void Simulation::restart()
+{
+	cout << "\n\n\nRestarting game..." << endl << endl;
+
+	numCO2Molecules = NUM_MOL_INIT;
+
+	// the store keeps its memory, so restarting doesn't allocate anything
+	molecules.clear();
+	gameWon = false;
+	gameLost = false;
+
+	// recreate the first five molecules
+	for (int i = 0; i < NUM_MOL_INIT; ++i)
+	{
+		Molecule::spawn(molecules);
+	}
+
+	ticksSinceEmit = 0;
+}
@@ -0,0 +1,62 @@
+#ifndef _SIMULATION_H
+#define _SIMULATION_H
+
+#include "Molecule.h"
+#include "MoleculeStore.h"
+#include "SimClock.h"
+#include "JobSystem.h"
+#include "SpatialHash.h"
+
+#define NUM_MOL_INIT 5
+#define SECS_BTWN_EMIT 1
+#define MAX_MOLS 10
+#define MOLS_ON_LOSE 50
+// most molecules there can be at once: emission stops one past MAX_MOLS, then losing adds MOLS_ON_LOSE
+#define MOLECULE_CAPACITY (MAX_MOLS + 1 + MOLS_ON_LOSE)
+// fewer molecules than this aren't worth handing to another thread
+#define MOLS_PER_UPDATE_JOB 1024
+
+// The game itself: the molecules, emitting them, and winning or losing.
+// Doesn't touch GL, so it runs the same with or without a window (Factory draws it).
+class Simulation
+{
+public:
+	// with no job system every update runs on the calling thread.
+	// More capacity than MOLECULE_CAPACITY is only useful for stress testing through spawn().
+	Simulation(JobSystem* jobs = NULL, size_t capacity = MOLECULE_CAPACITY);
+
+	// advances the game by one fixed simulation tick
+	void update();
+	// moves and collides the molecules for one tick, without any of the game rules
+	void step();
+	void restart();
+
+	// adds a CO2 molecule outside of the game rules
+	Molecule spawn() { return Molecule::spawn(molecules); }
+
+	int getNumCO2Molecules() const { return numCO2Molecules; }
+	const MoleculeStore& getMolecules() const { return molecules; }
+	// molecule-molecule contacts in the last tick
+	size_t getNumContacts() const { return numContacts; }
+	bool isWon() const { return gameWon; }
+	bool isLost() const { return gameLost; }
+
+private:
+	void updateMolecules();
+	void collideMolecules();
+
+	MoleculeStore molecules;
+	// broad phase for the molecule-molecule collisions, rebuilt every tick
+	SpatialHash collisionGrid;
+	JobSystem* jobs;
+	int numCO2Molecules;
+	size_t numContacts;
+
+	// simulation ticks since the last molecule was emitted
+	int ticksSinceEmit;
+
+	bool gameWon;
+	bool gameLost;
+};
+
+#endif
@@ -0,0 +1,46 @@
+#include "SpatialHash.h"
+
+SpatialHash::SpatialHash(float cellSize)
+{
+	this->cellSize = cellSize;
+	this->invCellSize = 1.0f / cellSize;
+	this->bucketMask = 0;
+}
+
+void SpatialHash::build(const float* x, const float* y, const float* z, size_t count)
+{
+	// about two buckets per point keeps collisions between cells rare
+	unsigned int tableSize = 64;
+	while (tableSize < count * 2)
+		tableSize *= 2;
+	bucketMask = tableSize - 1;
+
+	bucketStart.assign(tableSize + 1, 0);
+	entries.resize(count);
+	pointBucket.resize(count);
+
+	// count the points in each bucket
+	for (size_t i = 0; i < count; ++i)
+	{
+		unsigned int bucket = bucketOf(cellCoord(x[i]), cellCoord(y[i]), cellCoord(z[i]));
+		pointBucket[i] = bucket;
+		++bucketStart[bucket + 1];
+	}
+
+	// prefix sum, so every bucket knows where its entries start
+	for (unsigned int b = 0; b < tableSize; ++b)
+		bucketStart[b + 1] += bucketStart[b];
+
+	// scatter the points into their buckets, using the end of each bucket as a cursor
+	vector<unsigned int>& cursor = pointBucket;
+	for (size_t i = 0; i < count; ++i)
+	{
+		unsigned int bucket = cursor[i];
+		entries[bucketStart[bucket]++] = (unsigned int)i;
+	}
+
+	// the cursors moved every start to the start of the next bucket, shift them back
+	for (unsigned int b = tableSize; b > 0; --b)
+		bucketStart[b] = bucketStart[b - 1];
+	bucketStart[0] = 0;
+}
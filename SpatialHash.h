@@ -0,0 +1,89 @@
+#ifndef _SPATIAL_HASH_H
+#define _SPATIAL_HASH_H
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <assert.h>
+
+#include <glm/glm.hpp>
+
+using namespace std;
+
+// Uniform grid over unbounded space, with the cells hashed into a fixed size table.
+// Rebuilt from scratch every tick with a counting sort, so building is O(n) and the
+// points of each bucket end up next to each other in memory.
+class SpatialHash
+{
+public:
+	// neighbors can be looked up in a radius of up to cellSize, but twice the radius is the sweet spot.
+	// A bigger radius asserts, and without asserts it's cut down to cellSize.
+	SpatialHash(float cellSize);
+
+	void build(const float* x, const float* y, const float* z, size_t count);
+
+	// Calls visit(index) for every point in the cells overlapping the box around p that is radius
+	// out on every side. Points in those cells can be further away than radius (and points of other
+	// cells can share a bucket), so the caller still has to check the actual distance.
+	// With radius at most half the cell size this is at most 2 x 2 x 2 cells.
+	template <typename Visitor>
+	void forEachNeighbor(const glm::vec3& p, float radius, Visitor visit) const;
+
+	float getCellSize() const { return cellSize; }
+
+private:
+	unsigned int bucketOf(int cx, int cy, int cz) const;
+	int cellCoord(float v) const { return (int)floor(v * invCellSize); }
+
+	float cellSize, invCellSize;
+	unsigned int bucketMask;		// the table size is a power of two
+
+	vector<unsigned int> bucketStart;	// entries of bucket b are [bucketStart[b], bucketStart[b + 1])
+	vector<unsigned int> entries;		// point indices sorted by bucket
+	vector<unsigned int> pointBucket;	// scratch, the bucket of every point
+};
+
+inline unsigned int SpatialHash::bucketOf(int cx, int cy, int cz) const
+{
+	// large primes from Teschner et al., "Optimized Spatial Hashing for Collision Detection of Deformable Objects"
+	return ((unsigned int)cx * 73856093u ^ (unsigned int)cy * 19349663u ^ (unsigned int)cz * 83492791u) & bucketMask;
+}
+
+template <typename Visitor>
+void SpatialHash::forEachNeighbor(const glm::vec3& p, float radius, Visitor visit) const
+{
+	if (entries.empty())
+		return;
+
+	assert(radius <= cellSize);
+	radius = min(radius, cellSize);
+
+	// Up to cellSize the box spans at most 3 cells on each axis. Rounding could still make it 4,
+	// so the box is clamped too, visited can't hold more than 3 x 3 x 3 buckets.
+	int minX = cellCoord(p.x - radius), maxX = min(cellCoord(p.x + radius), minX + 2);
+	int minY = cellCoord(p.y - radius), maxY = min(cellCoord(p.y + radius), minY + 2);
+	int minZ = cellCoord(p.z - radius), maxZ = min(cellCoord(p.z + radius), minZ + 2);
+
+	// different cells can hash to the same bucket, only visit each bucket once
+	unsigned int visited[27];
+	int numVisited = 0;
+
+	for (int cz = minZ; cz <= maxZ; ++cz)
+		for (int cy = minY; cy <= maxY; ++cy)
+			for (int cx = minX; cx <= maxX; ++cx)
+			{
+				unsigned int bucket = bucketOf(cx, cy, cz);
+
+				bool seen = false;
+				for (int i = 0; i < numVisited; ++i)
+					seen |= visited[i] == bucket;
+				if (seen)
+					continue;
+				visited[numVisited++] = bucket;
+
+				for (unsigned int e = bucketStart[bucket]; e < bucketStart[bucket + 1]; ++e)
+					visit(entries[e]);
+			}
+}
+
+#endif
@@ -0,0 +1,59 @@
+#include "StereoCamera.h"
+
+#include <math.h>
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/constants.hpp>
+
+HmdDescription HmdDescription::synthetic(float verticalFov, float ipd, int eyeWidth, int eyeHeight)
+{
+	HmdDescription hmd;
+	float up = tanf(verticalFov * 0.5f * glm::pi<float>() / 180.0f);
+	float side = up * eyeWidth / eyeHeight;
+	for (int eye = 0; eye < ovrEye_Count; ++eye)
+	{
+		hmd.eyeFov[eye].UpTan = up;
+		hmd.eyeFov[eye].DownTan = up;
+		hmd.eyeFov[eye].LeftTan = side;
+		hmd.eyeFov[eye].RightTan = side;
+	}
+	hmd.ipd = ipd;
+	hmd.eyeSize.w = eyeWidth;
+	hmd.eyeSize.h = eyeHeight;
+	return hmd;
+}
+
+HmdDescription HmdDescription::fromHmd(const ovrHmdDesc& desc, float ipd)
+{
+	HmdDescription hmd;
+	for (int eye = 0; eye < ovrEye_Count; ++eye)
+		hmd.eyeFov[eye] = desc.DefaultEyeFov[eye];
+	hmd.ipd = ipd;
+	// the panel's resolution is for both eyes
+	hmd.eyeSize.w = desc.Resolution.w / 2;
+	hmd.eyeSize.h = desc.Resolution.h;
+	return hmd;
+}
+
+glm::mat4 StereoCamera::getProjection(const HmdDescription& hmd, ovrEyeType eye, float nearPlane, float farPlane)
+{
+	// the tangents are where the edges are one unit in front of the eye
+	const ovrFovPort& fov = hmd.eyeFov[eye];
+	return glm::frustum(-fov.LeftTan * nearPlane, fov.RightTan * nearPlane, -fov.DownTan * nearPlane, fov.UpTan * nearPlane,
+		nearPlane, farPlane);
+}
+
+glm::mat4 StereoCamera::getView(const HmdDescription& hmd, ovrEyeType eye, const glm::mat4& headView)
+{
+	// moving the eye left moves the world right
+	float offset = eye == ovrEye_Left ? hmd.ipd * 0.5f : -hmd.ipd * 0.5f;
+	return glm::translate(glm::mat4(1.0f), glm::vec3(offset, 0.0f, 0.0f)) * headView;
+}
+
+glm::mat4 StereoCamera::toSideBySide(const glm::mat4& projection, ovrEyeType eye)
+{
+	// half as wide, then moved over to the left or right half
+	glm::mat4 squeeze = glm::scale(glm::mat4(1.0f), glm::vec3(0.5f, 1.0f, 1.0f));
+	glm::mat4 shift = glm::translate(glm::mat4(1.0f), glm::vec3(eye == ovrEye_Left ? -0.5f : 0.5f, 0.0f, 0.0f));
+	return shift * squeeze * projection;
+}
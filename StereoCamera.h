@@ -0,0 +1,50 @@
+#ifndef _STEREO_CAMERA_H
+#define _STEREO_CAMERA_H
+
+#include <glm/glm.hpp>
+#include <OVR_CAPI.h>
+
+// The headset used when there isn't one attached, about the shape of a Rift's eyes
+#define HMD_DEFAULT_FOV 90.0f		// vertical, in degrees
+#define HMD_DEFAULT_IPD 0.064f		// in meters, which is what world units are
+#define HMD_DEFAULT_EYE_WIDTH 1080
+#define HMD_DEFAULT_EYE_HEIGHT 1200
+
+// How a frame is drawn for a headset
+enum StereoMode
+{
+	STEREO_OFF,
+	STEREO_INSTANCED,	// both eyes in one pass, every draw call instanced once per eye
+	STEREO_MULTIPASS	// the whole scene submitted once per eye, to compare against
+};
+
+// What drawing for a headset needs to know about it: each eye's field of view, as the tangents
+// of its half angles like LibOVR gives them, how far apart the eyes are and how big each
+// eye's image is.
+struct HmdDescription
+{
+	ovrFovPort eyeFov[ovrEye_Count];
+	float ipd;
+	ovrSizei eyeSize;
+
+	// A headset that doesn't exist, so stereo can be drawn and measured without one. Both eyes
+	// look straight ahead with the aspect of their image.
+	static HmdDescription synthetic(float verticalFov, float ipd, int eyeWidth, int eyeHeight);
+	// the recommended fields of view of a real one, ipd comes from its eye render descriptions
+	static HmdDescription fromHmd(const ovrHmdDesc& desc, float ipd);
+};
+
+// Turns the head's camera into one per eye, for both eyes drawn next to each other in one
+// target twice as wide as an eye
+class StereoCamera
+{
+public:
+	static glm::mat4 getProjection(const HmdDescription& hmd, ovrEyeType eye, float nearPlane, float farPlane);
+	// the eyes sit half the ipd to either side of the head
+	static glm::mat4 getView(const HmdDescription& hmd, ovrEyeType eye, const glm::mat4& headView);
+	// Squeezes projection into the eye's half of the side by side target. The vertex shader
+	// clips what's outside of it.
+	static glm::mat4 toSideBySide(const glm::mat4& projection, ovrEyeType eye);
+};
+
+#endif
@@ -0,0 +1,178 @@
+#include "StreamBuffer.h"
+#include "GLState.h"
+#include "RenderStats.h"
+
+#include <iostream>
+
+// how long to wait for a fence before checking again, in nanoseconds
+#define FENCE_WAIT_NS 1000000000ull
+
+GLuint StreamBuffer::buffer = 0;
+GLsizeiptr StreamBuffer::frameSize = 0;
+bool StreamBuffer::persistent = false;
+char* StreamBuffer::mapped = NULL;
+unsigned StreamBuffer::frame = 0;
+GLintptr StreamBuffer::head = 0;
+GLsync StreamBuffer::fences[STREAM_BUFFER_FRAMES];
+vector<GLuint> StreamBuffer::retired;
+unsigned StreamBuffer::generation = 0;
+
+void StreamBuffer::beginFrame()
+{
+	if (buffer == 0)
+		create(STREAM_BUFFER_FRAME_SIZE);
+
+	frame = (frame + 1) % STREAM_BUFFER_FRAMES;
+	waitFor(fences[frame]);
+	head = frame * frameSize;
+}
+
+void StreamBuffer::endFrame()
+{
+	if (buffer == 0)
+		return;
+
+	if (fences[frame])
+		glDeleteSync(fences[frame]);
+	fences[frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+	// everything drawn from the buffers that were replaced is submitted now, GL keeps them
+	// alive until it's done
+	if (!retired.empty())
+	{
+		GLState::deleteBuffers((GLsizei)retired.size(), &retired[0]);
+		retired.clear();
+	}
+}
+
+StreamChunk StreamBuffer::allocate(GLsizeiptr size, GLsizeiptr alignment)
+{
+	if (buffer == 0)
+		create(STREAM_BUFFER_FRAME_SIZE);
+
+	GLintptr start = (head + alignment - 1) / alignment * alignment;
+	if (start + size > (GLintptr)(frame + 1) * frameSize)
+	{
+		// Doesn't fit, so the rest of the frame goes into a bigger buffer. The old one can't be
+		// deleted until what's drawn from it this frame is submitted.
+		GLsizeiptr grown = frameSize * 2;
+		while (grown < size + alignment)
+			grown *= 2;
+		retired.push_back(buffer);
+		// the fences are for regions of the old buffer
+		for (int i = 0; i < STREAM_BUFFER_FRAMES; ++i)
+		{
+			if (fences[i])
+				glDeleteSync(fences[i]);
+			fences[i] = 0;
+		}
+		create(grown);
+		start = (head + alignment - 1) / alignment * alignment;
+	}
+	head = start + size;
+
+	StreamChunk chunk;
+	chunk.buffer = buffer;
+	chunk.offset = start;
+	chunk.size = size;
+	chunk.generation = generation;
+	if (persistent)
+	{
+		chunk.data = mapped + start;
+	}
+	else
+	{
+		// the fences already keep the GPU out of this region, so don't let the driver wait for it too
+		GLState::bindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+		chunk.data = glMapBufferRange(GL_COPY_WRITE_BUFFER, start, size, GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+		if (!chunk.data)
+			cerr << "ERROR::STREAM_BUFFER::Can't map " << size << " bytes" << endl;
+	}
+	RenderStats::current.streamBytesUploaded += size;
+	return chunk;
+}
+
+void StreamBuffer::commit(const StreamChunk& chunk)
+{
+	if (persistent || !chunk.data)
+		return;
+	GLState::bindBuffer(GL_COPY_WRITE_BUFFER, chunk.buffer);
+	if (glUnmapBuffer(GL_COPY_WRITE_BUFFER) == GL_FALSE)
+		cerr << "ERROR::STREAM_BUFFER::Chunk got corrupted while it was mapped" << endl;
+}
+
+GLsizeiptr StreamBuffer::getUniformAlignment()
+{
+	static GLint alignment = 0;
+	if (alignment == 0)
+	{
+		glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+		if (alignment < STREAM_BUFFER_ALIGNMENT)
+			alignment = STREAM_BUFFER_ALIGNMENT;
+	}
+	return alignment;
+}
+
+void StreamBuffer::cleanup()
+{
+	for (int i = 0; i < STREAM_BUFFER_FRAMES; ++i)
+	{
+		if (fences[i])
+			glDeleteSync(fences[i]);
+		fences[i] = 0;
+	}
+	if (!retired.empty())
+		GLState::deleteBuffers((GLsizei)retired.size(), &retired[0]);
+	retired.clear();
+	// deleting it unmaps it too
+	GLState::deleteBuffers(1, &buffer);
+	buffer = 0;
+	mapped = NULL;
+	frameSize = 0;
+	head = 0;
+}
+
+void StreamBuffer::create(GLsizeiptr frameSize)
+{
+	GLsizeiptr size = frameSize * STREAM_BUFFER_FRAMES;
+	StreamBuffer::frameSize = frameSize;
+	head = frame * frameSize;
+	mapped = NULL;
+	generation++;
+
+	glGenBuffers(1, &buffer);
+	GLState::bindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+	persistent = GLEW_ARB_buffer_storage != 0;
+	if (persistent)
+	{
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_COPY_WRITE_BUFFER, size, NULL, flags);
+		mapped = (char*)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, size, flags);
+		if (!mapped)
+		{
+			// immutable storage can't be given to glBufferData, so start over with a new buffer
+			cerr << "ERROR::STREAM_BUFFER::Can't map the buffer persistently, mapping every chunk instead" << endl;
+			GLState::deleteBuffers(1, &buffer);
+			glGenBuffers(1, &buffer);
+			GLState::bindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+			persistent = false;
+		}
+	}
+	if (!persistent)
+		glBufferData(GL_COPY_WRITE_BUFFER, size, NULL, GL_STREAM_DRAW);
+}
+
+void StreamBuffer::waitFor(GLsync& fence)
+{
+	if (!fence)
+		return;
+
+	GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_WAIT_NS);
+	while (result == GL_TIMEOUT_EXPIRED)
+		result = glClientWaitSync(fence, 0, FENCE_WAIT_NS);
+	if (result == GL_WAIT_FAILED)
+		cerr << "ERROR::STREAM_BUFFER::Waiting for the GPU failed" << endl;
+
+	glDeleteSync(fence);
+	fence = 0;
+}
@@ -0,0 +1,77 @@
+#ifndef _STREAM_BUFFER_H
+#define _STREAM_BUFFER_H
+
+#include <vector>
+
+#include <GL/glew.h>
+
+using namespace std;
+
+// frames the CPU can be ahead of the GPU before it has to wait for it
+#define STREAM_BUFFER_FRAMES 3
+// bytes each frame gets to start with, it doubles whenever a frame needs more
+#define STREAM_BUFFER_FRAME_SIZE (1 << 20)
+// chunks start at least this aligned, enough for vec4s and matrices
+#define STREAM_BUFFER_ALIGNMENT 16
+
+// Where a piece of this frame's data goes. data is written by the CPU, buffer and offset are
+// what GL reads it from.
+struct StreamChunk
+{
+	GLuint buffer;
+	GLintptr offset;
+	GLsizeiptr size;
+	void* data;
+	// Changes whenever a new buffer takes over. GL can give a new buffer the name of one that's
+	// been deleted, so the name alone doesn't say whether something still points at the old one.
+	unsigned generation;
+};
+
+// One buffer for everything that's written once a frame and thrown away, like instance
+// matrices and the per-frame uniforms. It's split into a region per frame in flight, and the
+// chunks handed out in a frame come one after the other from its region. A region is only
+// used again once the fence put after the frame that last used it has passed, so writing never
+// waits on the GPU or makes the driver copy anything.
+//
+// With ARB_buffer_storage the whole buffer stays mapped, persistent and coherent, and chunks
+// are written straight into it. Without it, GL 3.3 only, every chunk is mapped unsynchronized
+// on its own until commit(). The fences make that safe too.
+class StreamBuffer
+{
+public:
+	// Moves on to the next region, and waits for the GPU if it's still reading it. Everything
+	// from the frame before has to be drawn by now.
+	static void beginFrame();
+	// puts the fence after everything drawn from the frame's region
+	static void endFrame();
+
+	// Size bytes at an offset that's a multiple of alignment. If the frame's region is full a
+	// bigger buffer takes over, so chunks from one frame can be in different buffers.
+	static StreamChunk allocate(GLsizeiptr size, GLsizeiptr alignment = STREAM_BUFFER_ALIGNMENT);
+	// Has to be called once chunk is written, before anything draws from it or the next
+	// allocate(). Does nothing when the buffer is mapped persistently.
+	static void commit(const StreamChunk& chunk);
+
+	// what uniform buffer ranges have to be aligned to
+	static GLsizeiptr getUniformAlignment();
+	static bool isPersistent() { return persistent; }
+
+	// deletes the buffer, needs the GL context it was created in
+	static void cleanup();
+
+private:
+	static GLuint buffer;
+	static GLsizeiptr frameSize;
+	static bool persistent;
+	static char* mapped;	// the whole buffer, when it's mapped persistently
+	static unsigned frame;	// the region being written
+	static GLintptr head;	// next free byte in it
+	static GLsync fences[STREAM_BUFFER_FRAMES];
+	static vector<GLuint> retired;	// replaced this frame, deleted once everything from them is drawn
+	static unsigned generation;	// of buffer, never reset
+
+	static void create(GLsizeiptr frameSize);
+	static void waitFor(GLsync& fence);
+};
+
+#endif
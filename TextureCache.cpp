@@ -0,0 +1,240 @@
+#include "TextureCache.h"
+#include "AssetLoader.h"
+#include "DDSCache.h"
+#include "RenderStats.h"
+#include "GLState.h"
+
+#include <ctype.h>
+#include <vector>
+#include <iostream>
+
+#include <SOIL.h>
+
+unordered_map<string, TextureCache::Entry> TextureCache::entries;
+unordered_map<GLuint, string> TextureCache::keys;
+list<string> TextureCache::unusedOrder;
+size_t TextureCache::budget = TEXTURE_CACHE_BUDGET_BYTES;
+TextureCacheStats TextureCache::stats = TextureCacheStats();
+
+GLuint TextureCache::acquire(const string& path, unsigned flags, AssetLoader* loader)
+{
+	string key = normalizePath(path) + '#' + to_string(flags);
+
+	unordered_map<string, Entry>::iterator found = entries.find(key);
+	if (found != entries.end())
+	{
+		Entry& entry = found->second;
+		// it's in use again, so it can't be evicted any more
+		if (entry.refs++ == 0)
+		{
+			unusedOrder.erase(entry.unused);
+			stats.texturesReferenced++;
+		}
+		stats.hits++;
+		return entry.texture;
+	}
+	stats.misses++;
+
+	Entry entry;
+	entry.refs = 1;
+	entry.bytes = 0;
+	entry.loading = loader != NULL;
+	entry.texture = loader ? loader->loadTexture(path, flags) : load(path, flags, entry.bytes);
+	entry.unused = unusedOrder.end();
+
+	entries[key] = entry;
+	keys[entry.texture] = key;
+	stats.texturesResident++;
+	stats.texturesReferenced++;
+	stats.bytesResident += entry.bytes;
+
+	if (stats.bytesResident > budget)
+		trim(budget);
+	return entry.texture;
+}
+
+void TextureCache::release(GLuint texture)
+{
+	unordered_map<GLuint, string>::iterator key = keys.find(texture);
+	if (key == keys.end())
+	{
+		cerr << "ERROR::TEXTURE_CACHE::Releasing texture " << texture << " that isn't cached" << endl;
+		return;
+	}
+
+	Entry& entry = entries[key->second];
+	if (--entry.refs == 0)
+	{
+		// stays resident in case someone wants it again, until memory gets tight
+		entry.unused = unusedOrder.insert(unusedOrder.end(), key->second);
+		stats.texturesReferenced--;
+		if (stats.bytesResident > budget)
+			trim(budget);
+	}
+}
+
+void TextureCache::trim(size_t maxBytes)
+{
+	list<string>::iterator next = unusedOrder.begin();
+	while (stats.bytesResident > maxBytes && next != unusedOrder.end())
+	{
+		unordered_map<string, Entry>::iterator entry = entries.find(*next++);
+		if (!entry->second.loading)
+			evict(entry);
+	}
+}
+
+void TextureCache::setBudget(size_t bytes)
+{
+	budget = bytes;
+	trim(budget);
+}
+
+void TextureCache::cleanup()
+{
+	for (unordered_map<string, Entry>::iterator i = entries.begin(); i != entries.end(); ++i)
+		GLState::deleteTextures(1, &i->second.texture);
+
+	entries.clear();
+	keys.clear();
+	unusedOrder.clear();
+	stats.bytesResident = 0;
+	stats.texturesResident = 0;
+	stats.texturesReferenced = 0;
+}
+
+string TextureCache::normalizePath(const string& path)
+{
+	string normalized = path;
+	for (size_t i = 0; i < normalized.size(); ++i)
+	{
+		if (normalized[i] == '\\')
+			normalized[i] = '/';
+#ifdef _WIN32
+		// Windows paths aren't case sensitive
+		normalized[i] = (char)tolower((unsigned char)normalized[i]);
+#endif
+	}
+
+	// split into segments, dropping empty and "." ones and letting ".." cancel the one before it
+	bool absolute = !normalized.empty() && normalized[0] == '/';
+	vector<string> segments;
+	size_t start = 0;
+	while (start <= normalized.size())
+	{
+		size_t end = normalized.find('/', start);
+		if (end == string::npos)
+			end = normalized.size();
+		string segment = normalized.substr(start, end - start);
+		start = end + 1;
+
+		if (segment.empty() || segment == ".")
+			continue;
+		if (segment == ".." && !segments.empty() && segments.back() != "..")
+			segments.pop_back();
+		else
+			segments.push_back(segment);
+	}
+
+	string result = absolute ? "/" : "";
+	for (size_t i = 0; i < segments.size(); ++i)
+	{
+		if (i > 0)
+			result += '/';
+		result += segments[i];
+	}
+	return result;
+}
+
+GLuint TextureCache::createTexture(unsigned flags)
+{
+	GLint wrap = flags & TEXTURE_CLAMP ? GL_CLAMP_TO_EDGE : GL_REPEAT;
+	GLint minFilter = flags & TEXTURE_NO_MIPMAPS ? GL_LINEAR : GL_LINEAR_MIPMAP_LINEAR;
+
+	GLuint texture;
+	glGenTextures(1, &texture);
+	GLState::bindTexture(0, GL_TEXTURE_2D, texture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrap);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrap);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, minFilter);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	GLState::bindTexture(0, GL_TEXTURE_2D, 0);
+	return texture;
+}
+
+size_t TextureCache::uploadImage(GLuint texture, const unsigned char* pixels, int width, int height, unsigned flags)
+{
+	GLenum format = flags & TEXTURE_ALPHA ? GL_RGBA : GL_RGB;
+	size_t bytes = (size_t)width * height * (flags & TEXTURE_ALPHA ? 4 : 3);
+
+	GLState::bindTexture(0, GL_TEXTURE_2D, texture);
+	// SOIL's RGB rows aren't padded to 4 bytes
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, pixels);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	RenderStats::current.textureBytesUploaded += bytes;
+
+	if (!(flags & TEXTURE_NO_MIPMAPS))
+	{
+		glGenerateMipmap(GL_TEXTURE_2D);
+		// the whole mip chain adds another third
+		bytes += bytes / 3;
+	}
+	GLState::bindTexture(0, GL_TEXTURE_2D, 0);
+	return bytes;
+}
+
+void TextureCache::finishLoading(GLuint texture, size_t bytes)
+{
+	unordered_map<GLuint, string>::iterator key = keys.find(texture);
+	if (key == keys.end())
+		return;
+
+	Entry& entry = entries[key->second];
+	stats.bytesResident += bytes - entry.bytes;
+	entry.bytes = bytes;
+	entry.loading = false;
+	if (stats.bytesResident > budget)
+		trim(budget);
+}
+
+GLuint TextureCache::load(const string& path, unsigned flags, size_t& bytes)
+{
+	GLuint texture = createTexture(flags);
+
+	// the cooked DXT copy is a fraction of the size and already has its mips
+	if (DDSCache::isSupported())
+	{
+		DDSCache dds;
+		if (dds.load(path, flags))
+		{
+			bytes = dds.upload(texture, flags);
+			return texture;
+		}
+	}
+
+	int width, height;
+	unsigned char* image = SOIL_load_image(path.c_str(), &width, &height, 0, flags & TEXTURE_ALPHA ? SOIL_LOAD_RGBA : SOIL_LOAD_RGB);
+	if (!image)
+	{
+		cerr << "ERROR::TEXTURE_CACHE::Failed to load " << path << endl;
+		bytes = 0;
+		return texture;
+	}
+
+	bytes = uploadImage(texture, image, width, height, flags);
+	SOIL_free_image_data(image);
+	return texture;
+}
+
+void TextureCache::evict(unordered_map<string, Entry>::iterator entry)
+{
+	GLState::deleteTextures(1, &entry->second.texture);
+	stats.bytesResident -= entry->second.bytes;
+	stats.texturesResident--;
+	stats.evictions++;
+
+	unusedOrder.erase(entry->second.unused);
+	keys.erase(entry->second.texture);
+	entries.erase(entry);
+}
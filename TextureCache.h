@@ -0,0 +1,86 @@
+#ifndef _TEXTURE_CACHE_H
+#define _TEXTURE_CACHE_H
+
+#include <string>
+#include <list>
+#include <unordered_map>
+
+#include <GL/glew.h>
+
+using namespace std;
+
+// Unreferenced textures are only evicted once everything resident adds up to more than this
+#define TEXTURE_CACHE_BUDGET_BYTES (256 * 1024 * 1024)
+
+// How a texture is loaded. Loading the same image with different flags gives a different texture.
+enum TextureFlags
+{
+	TEXTURE_DEFAULT = 0,
+	TEXTURE_ALPHA = 1 << 0,			// keep the alpha channel, RGB otherwise
+	TEXTURE_NO_MIPMAPS = 1 << 1,
+	TEXTURE_CLAMP = 1 << 2			// clamp to edge instead of repeating
+};
+
+struct TextureCacheStats
+{
+	size_t bytesResident;		// every cached texture, mips included, referenced or not
+	size_t texturesResident;
+	size_t texturesReferenced;
+	size_t hits;
+	size_t misses;
+	size_t evictions;
+};
+
+class AssetLoader;
+
+// Every texture loaded from a file, shared by every Model that uses it. Textures are found by
+// their normalized path and flags, and reference counted: acquire() once per user, release()
+// once per acquire(). Textures nobody references stay cached until memory gets tight.
+// Render thread only.
+class TextureCache
+{
+public:
+	// Returns the texture for path, loading it if it isn't cached. With a loader the image
+	// is decoded in the background and the texture shows a placeholder until then.
+	static GLuint acquire(const string& path, unsigned flags = TEXTURE_DEFAULT, AssetLoader* loader = NULL);
+	static void release(GLuint texture);
+
+	// Deletes unreferenced textures, least recently released first, until at most maxBytes are resident
+	static void trim(size_t maxBytes);
+	static void setBudget(size_t bytes);
+	static TextureCacheStats getStats() { return stats; }
+	// deletes every texture, referenced or not
+	static void cleanup();
+
+	// Lowercase on Windows, forward slashes, no "." or ".." and no doubled separators, so
+	// every spelling of the same file finds the same texture
+	static string normalizePath(const string& path);
+
+	// The GL side of loading a texture, also used by AssetLoader. createTexture sets the
+	// parameters for flags, uploadImage fills it in and returns the bytes it takes up.
+	static GLuint createTexture(unsigned flags);
+	static size_t uploadImage(GLuint texture, const unsigned char* pixels, int width, int height, unsigned flags);
+	// called once a background load is done with a texture, bytes is 0 if it failed
+	static void finishLoading(GLuint texture, size_t bytes);
+
+private:
+	struct Entry
+	{
+		GLuint texture;
+		unsigned refs;
+		size_t bytes;
+		bool loading;					// the loader still has to fill it in, so it can't be deleted yet
+		list<string>::iterator unused;	// position in unusedOrder while refs is 0
+	};
+
+	static unordered_map<string, Entry> entries;
+	static unordered_map<GLuint, string> keys;	// texture name back to its entry
+	static list<string> unusedOrder;			// unreferenced textures, least recently released first
+	static size_t budget;
+	static TextureCacheStats stats;
+
+	static GLuint load(const string& path, unsigned flags, size_t& bytes);
+	static void evict(unordered_map<string, Entry>::iterator entry);
+};
+
+#endif
@@ -0,0 +1,79 @@
+#include "TransformHierarchy.h"
+
+#include <iostream>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+glm::mat4 Transform::toMatrix() const
+{
+	// the rotation's columns scaled, with the translation as the last column
+	glm::mat4 matrix = glm::mat4_cast(rotation);
+	matrix[0] *= scale.x;
+	matrix[1] *= scale.y;
+	matrix[2] *= scale.z;
+	matrix[3] = glm::vec4(translation, 1.0f);
+	return matrix;
+}
+
+unsigned TransformHierarchy::add(int parent, const Transform& local)
+{
+	unsigned node = (unsigned)parents.size();
+	if (parent >= (int)node)
+	{
+		cerr << "ERROR::TRANSFORM_HIERARCHY::Node " << node << " added before its parent " << parent << endl;
+		parent = TRANSFORM_NO_PARENT;
+	}
+
+	parents.push_back(parent);
+	locals.push_back(local);
+	worlds.push_back(glm::mat4(1.0f));
+	dirty.push_back(1);
+	changed.push_back(0);
+	return node;
+}
+
+void TransformHierarchy::clear()
+{
+	parents.clear();
+	locals.clear();
+	worlds.clear();
+	dirty.clear();
+	changed.clear();
+}
+
+void TransformHierarchy::setLocal(unsigned node, const Transform& local)
+{
+	locals[node] = local;
+	dirty[node] = 1;
+}
+
+void TransformHierarchy::setTranslation(unsigned node, const glm::vec3& translation)
+{
+	locals[node].translation = translation;
+	dirty[node] = 1;
+}
+
+void TransformHierarchy::setRotation(unsigned node, const glm::quat& rotation)
+{
+	locals[node].rotation = rotation;
+	dirty[node] = 1;
+}
+
+size_t TransformHierarchy::update()
+{
+	// parents come first, so their changed flags are already set when their children get here
+	size_t recomputed = 0;
+	for (size_t i = 0; i < parents.size(); ++i)
+	{
+		int parent = parents[i];
+		changed[i] = dirty[i] || (parent != TRANSFORM_NO_PARENT && changed[parent]);
+		if (!changed[i])
+			continue;
+
+		glm::mat4 local = locals[i].toMatrix();
+		worlds[i] = parent == TRANSFORM_NO_PARENT ? local : worlds[parent] * local;
+		dirty[i] = 0;
+		recomputed++;
+	}
+	return recomputed;
+}
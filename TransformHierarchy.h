@@ -0,0 +1,60 @@
+#ifndef _TRANSFORM_HIERARCHY_H
+#define _TRANSFORM_HIERARCHY_H
+
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+// the parent of root nodes
+#define TRANSFORM_NO_PARENT -1
+
+using namespace std;
+
+// A node's place relative to its parent: scaled first, then rotated, then translated
+struct Transform
+{
+	glm::vec3 translation;
+	glm::quat rotation;
+	glm::vec3 scale;
+
+	Transform() : translation(0.0f), rotation(1.0f, 0.0f, 0.0f, 0.0f), scale(1.0f) {}
+	Transform(const glm::vec3& translation, const glm::quat& rotation, const glm::vec3& scale)
+		: translation(translation), rotation(rotation), scale(scale) {}
+
+	glm::mat4 toMatrix() const;
+};
+
+// A tree of transforms kept in flat arrays, every parent before its children. Changing a
+// node only marks it dirty; update() then brings every world matrix up to date in one pass
+// from the front, recomputing just the dirty nodes and whatever is below them.
+class TransformHierarchy
+{
+public:
+	// parent has to be added already, or be TRANSFORM_NO_PARENT
+	unsigned add(int parent, const Transform& local);
+	void clear();
+	size_t size() const { return parents.size(); }
+
+	void setLocal(unsigned node, const Transform& local);
+	void setTranslation(unsigned node, const glm::vec3& translation);
+	void setRotation(unsigned node, const glm::quat& rotation);
+	const Transform& getLocal(unsigned node) const { return locals[node]; }
+	int getParent(unsigned node) const { return parents[node]; }
+
+	// returns how many world matrices were recomputed
+	size_t update();
+	// only up to date after update()
+	const glm::mat4& getWorld(unsigned node) const { return worlds[node]; }
+	// whether the node's world matrix changed in the last update()
+	bool hasChanged(unsigned node) const { return changed[node] != 0; }
+
+private:
+	vector<int> parents;
+	vector<Transform> locals;
+	vector<glm::mat4> worlds;
+	vector<unsigned char> dirty;	// the local transform changed since the last update
+	vector<unsigned char> changed;
+};
+
+#endif
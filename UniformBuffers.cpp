@@ -0,0 +1,78 @@
+#include "UniformBuffers.h"
+#include "RenderStats.h"
+#include "StreamBuffer.h"
+#include "GLState.h"
+
+#include <string.h>
+#include <iostream>
+
+GLint FrameUniforms::eyeCount = 1;
+
+vector<MaterialData> MaterialTable::materials;
+bool MaterialTable::dirty = false;
+GLuint MaterialTable::UBO = 0;
+
+void FrameUniforms::update(const FrameData& data)
+{
+	// every update gets its own copy, so the eyes of a multipass frame don't overwrite each other
+	StreamChunk chunk = StreamBuffer::allocate(sizeof(FrameData), StreamBuffer::getUniformAlignment());
+	memcpy(chunk.data, &data, sizeof(FrameData));
+	StreamBuffer::commit(chunk);
+	GLState::bindBufferRange(GL_UNIFORM_BUFFER, FRAME_BLOCK_BINDING, chunk.buffer, chunk.offset, sizeof(FrameData));
+	eyeCount = data.eyeCount;
+}
+
+GLint MaterialTable::add(glm::vec3 ambient, glm::vec3 diffuse, glm::vec3 specular, float shininess)
+{
+	MaterialData material;
+	material.ambient = glm::vec4(ambient, 1.0f);
+	material.diffuse = glm::vec4(diffuse, 1.0f);
+	material.specular = glm::vec4(specular, shininess);
+
+	// meshes from the same model usually share materials, so reuse an identical one if we have it
+	for (size_t i = 0; i < materials.size(); ++i)
+	{
+		if (materials[i].ambient == material.ambient && materials[i].diffuse == material.diffuse &&
+			materials[i].specular == material.specular)
+		{
+			return (GLint)i;
+		}
+	}
+
+	if (materials.size() >= MAX_MATERIALS)
+	{
+		cerr << "ERROR::MATERIALS::Material table is full, reusing material 0" << endl;
+		return 0;
+	}
+
+	materials.push_back(material);
+	dirty = true;
+	return (GLint)materials.size() - 1;
+}
+
+void MaterialTable::upload()
+{
+	if (!dirty)
+		return;
+
+	if (UBO == 0)
+	{
+		// allocate the whole table up front, the shader always sees MAX_MATERIALS entries
+		glGenBuffers(1, &UBO);
+		GLState::bindBuffer(GL_UNIFORM_BUFFER, UBO);
+		glBufferData(GL_UNIFORM_BUFFER, MAX_MATERIALS * sizeof(MaterialData), NULL, GL_STATIC_DRAW);
+		GLState::bindBufferBase(GL_UNIFORM_BUFFER, MATERIAL_BLOCK_BINDING, UBO);
+	}
+
+	GLState::bindBuffer(GL_UNIFORM_BUFFER, UBO);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, materials.size() * sizeof(MaterialData), &materials[0]);
+	dirty = false;
+}
+
+void MaterialTable::cleanup()
+{
+	GLState::deleteBuffers(1, &UBO);
+	UBO = 0;
+	materials.clear();
+	dirty = false;
+}
@@ -0,0 +1,74 @@
+#ifndef _UNIFORM_BUFFERS_H
+#define _UNIFORM_BUFFERS_H
+
+#include <vector>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+using namespace std;
+
+// Binding points of the uniform blocks in shader.vert/shader.frag. LoadShaders attaches the blocks to these.
+#define FRAME_BLOCK_BINDING 0
+#define MATERIAL_BLOCK_BINDING 1
+
+// Must match the size of the materials array in shader.frag. 256 materials fit in the 16KB
+// every GL implementation guarantees for a uniform block.
+#define MAX_MATERIALS 256
+
+// Must match the size of the per-eye arrays in the FrameData block
+#define FRAME_MAX_EYES 2
+
+// std140 layout of the FrameData block. vec3s are stored as vec4s so the C++ and GLSL layouts line up.
+// There's a camera per eye, a mono frame only uses the first one.
+struct FrameData
+{
+	glm::mat4 projection[FRAME_MAX_EYES];
+	glm::mat4 view[FRAME_MAX_EYES];
+	glm::vec4 lightPosition;
+	glm::vec4 lightAmbient;
+	glm::vec4 lightDiffuse;
+	glm::vec4 lightSpecular;
+	glm::vec4 viewPos[FRAME_MAX_EYES];
+	GLint eyeCount;		// every draw is repeated once per eye, by instancing
+	GLint padding[3];
+};
+
+// std140 layout of one entry in the Materials block. The shininess is kept in specular.w.
+struct MaterialData
+{
+	glm::vec4 ambient;
+	glm::vec4 diffuse;
+	glm::vec4 specular;
+};
+
+// Everything that is the same for every draw in a frame, written once per frame
+class FrameUniforms
+{
+public:
+	// The block is written to the StreamBuffer, so this has to be between its beginFrame()
+	// and endFrame()
+	static void update(const FrameData& data);
+	// of the last update, draws multiply their instance counts by it
+	static GLint getEyeCount() { return eyeCount; }
+
+private:
+	static GLint eyeCount;
+};
+
+// Every material used by any mesh. Meshes keep an index into this table instead of their
+// own material uniforms, and the table is only uploaded again when a material is added.
+class MaterialTable
+{
+public:
+	static GLint add(glm::vec3 ambient, glm::vec3 diffuse, glm::vec3 specular, float shininess);
+	static void upload();
+	static void cleanup();
+
+private:
+	static vector<MaterialData> materials;
+	static bool dirty;
+	static GLuint UBO;
+};
+
+#endif
@@ -1,14 +1,36 @@
 #include "window.h"
 #include "Factory.h"
+#include "RenderStats.h"
+#include "UniformBuffers.h"
+#include "SimClock.h"
+#include "JobSystem.h"
+#include "Profiler.h"
+#include "AssetLoader.h"
+#include "TextureCache.h"
+#include "LodSelector.h"
+#include "FrustumCuller.h"
+#include "OVRUtils.h"
+#include "DynamicResolution.h"
+#include "RenderQueue.h"
+#include "GLState.h"
+#include "StreamBuffer.h"
 
 const char* window_title = "CO2RemovalVR";
 Factory * factory;
 GLint shaderProgram;
+SimClock simClock;
+JobSystem* jobSystem;
+AssetLoader* assetLoader;
+Profiler profiler;
+DynamicResolution* resolution;
 
 // On some systems you need to change this to the absolute path
 #define VERTEX_SHADER_PATH "../shader.vert"
 #define FRAGMENT_SHADER_PATH "../shader.frag"
 
+#define NEAR_PLANE 0.1f
+#define FAR_PLANE 1000.0f
+
 // Default camera parameters
 glm::vec3 cam_pos(0.0f, 0.0f, 20.0f);		// e  | Position of camera
 glm::vec3 cam_look_at(0.0f, 0.0f, 0.0f);	// d  | This is where the camera looks at
@@ -22,23 +44,51 @@ glm::vec3 lightSpecular(1.0f, 1.0f, 1.0f);
 
 int Window::width;
 int Window::height;
+int Window::render_width;
+int Window::render_height;
 
 glm::mat4 Window::P;
 glm::mat4 Window::V;
 
+StereoMode Window::stereo = STEREO_OFF;
+HmdDescription Window::hmd;
+
 void Window::initialize_objects()
 {
-	factory = new Factory();
+	jobSystem = new JobSystem();
+	assetLoader = new AssetLoader();
+	// the models stream in while the game is already running
+	factory = new Factory(jobSystem, assetLoader);
 
 	// Load the shader program. Make sure you have the correct filepath up top
 	shaderProgram = LoadShaders(VERTEX_SHADER_PATH, FRAGMENT_SHADER_PATH);
+
+	// don't count the loading time as simulation time
+	simClock.reset();
+}
+
+void Window::finish_loading()
+{
+	assetLoader->finish();
 }
 
 // Treat this as a destructor function. Delete dynamically allocated memory here.
 void Window::clean_up()
 {
 	delete(factory); // also deletes the CO2 molecules
-	glDeleteProgram(shaderProgram);
+	delete(assetLoader);
+	delete(jobSystem);
+	GLState::deleteProgram(shaderProgram);
+	profiler.cleanup();
+	if (resolution)
+	{
+		resolution->cleanup();
+		delete resolution;
+		resolution = NULL;
+	}
+	StreamBuffer::cleanup();
+	MaterialTable::cleanup();
+	TextureCache::cleanup();
 }
 
 GLFWwindow* Window::create_window(int width, int height)
@@ -50,8 +100,9 @@ GLFWwindow* Window::create_window(int width, int height)
 		return NULL;
 	}
 
-	// 4x antialiasing
-	glfwWindowHint(GLFW_SAMPLES, 4);
+	// no antialiasing here, the scene is drawn into a 4x multisampled target of its own and copied
+	// in, see DynamicResolution
+	glfwWindowHint(GLFW_SAMPLES, 0);
 
 #ifdef __APPLE__ // Because Apple hates comforming to standards
 	// Ensure that minimum OpenGL version is 3.3
@@ -92,45 +143,203 @@ void Window::resize_callback(GLFWwindow* window, int width, int height)
 {
 	Window::width = width;
 	Window::height = height;
+	Window::render_width = width;
+	Window::render_height = height;
 	// Set the viewport size. This is the only matrix that OpenGL maintains for us in modern OpenGL!
-	glViewport(0, 0, width, height);
+	GLState::viewport(0, 0, width, height);
+	if (resolution)
+		resolution->resize(width, height);
 
 	if (height > 0)
 	{
-		P = glm::perspective(45.0f, (float)width / (float)height, 0.1f, 1000.0f);
+		P = glm::perspective(45.0f, (float)width / (float)height, NEAR_PLANE, FAR_PLANE);
 		V = glm::lookAt(cam_pos, cam_look_at, cam_up);
 	}
 }
 
 void Window::idle_callback()
 {
-	// update the scene objects
+	// the frame starts with the simulation, then display_callback renders and presents it
+	profiler.recordSample(Profiler::Sample_FrameStart);
+
+	// update the scene objects in fixed ticks, however long the frame took
+	int ticks = simClock.advance();
+	for (int i = 0; i < ticks; ++i)
+	{
+		update_objects();
+	}
+
+	// hand whatever the loader finished to GL, without letting a big model stall the frame
+	assetLoader->processUploads(ASSET_UPLOAD_BUDGET_MS);
+
+	profiler.recordSample(Profiler::Sample_AfterGameProcessing);
+}
+
+void Window::update_objects()
+{
 	factory->update();
 }
 
-void Window::display_callback(GLFWwindow* window)
+void Window::set_camera(const glm::vec3& position, const glm::vec3& look_at)
 {
-	// Clear the color and depth buffers
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	cam_pos = position;
+	cam_look_at = look_at;
+	V = glm::lookAt(cam_pos, cam_look_at, cam_up);
+}
 
-	// Use the shader of programID
-	glUseProgram(shaderProgram);
+void Window::set_stereo(StereoMode mode, const HmdDescription& hmd)
+{
+	Window::stereo = mode;
+	Window::hmd = hmd;
 
-	// Setup the light properties
-	glUniform3fv(glGetUniformLocation(shaderProgram, "light.position"), 1, &lightPos[0]);
-	glUniform3fv(glGetUniformLocation(shaderProgram, "light.ambient"), 1, &lightAmbient[0]);
-	glUniform3fv(glGetUniformLocation(shaderProgram, "light.diffuse"), 1, &lightDiffuse[0]);
-	glUniform3fv(glGetUniformLocation(shaderProgram, "light.specular"), 1, &lightSpecular[0]);
+	// the multipass eyes each set their own half
+	GLState::viewport(0, 0, render_width, render_height);
+	// keeps each instanced eye in its half of the target
+	if (mode == STEREO_INSTANCED)
+		GLState::setEnabled(GL_CLIP_DISTANCE0, true);
+	else
+		GLState::setEnabled(GL_CLIP_DISTANCE0, false);
+}
 
-	glUniform3fv(glGetUniformLocation(shaderProgram, "viewPos"), 1, &cam_pos[0]);
+void Window::display_callback(GLFWwindow* window)
+{
+	// only the window draws through the scaled target, the benchmark draws at a fixed size
+	if (!resolution)
+	{
+		resolution = new DynamicResolution();
+		resolution->resize(width, height);
+	}
 
-	// Render the objects
-	factory->draw(shaderProgram);
+	// draw at whatever resolution the GPU kept up with lately, and stretch that over the window
+	profiler.setResolutionScale(resolution->update(profiler));
+	resolution->bind(render_width, render_height);
+	render_frame(simClock.getAlpha());
+	resolution->present(0, width, height);
 
 	// Gets events, including input such as keyboard and mouse or window resizing
 	glfwPollEvents();
 	// Swap buffers
 	glfwSwapBuffers(window);
+	profiler.recordSample(Profiler::Sample_AfterPresent);
+
+#ifdef GL_STATE_DEBUG
+	GLState::validate();
+#endif
+	RenderStats::endFrame();
+}
+
+void Window::render_frame(float alpha)
+{
+	// the per-frame data of the frame STREAM_BUFFER_FRAMES ago has to be read by now
+	StreamBuffer::beginFrame();
+	if (stereo == STEREO_MULTIPASS)
+	{
+		// everything is culled and submitted all over again for the second eye
+		ovr::for_each_eye([alpha](ovrEyeType eye)
+		{
+			begin_frame(eye);
+			factory->draw(shaderProgram, alpha);
+			RenderQueue::execute();
+		});
+	}
+	else
+	{
+		begin_frame();
+
+		// Render the objects
+		factory->draw(shaderProgram, alpha);
+		RenderQueue::execute();
+	}
+	StreamBuffer::endFrame();
+	profiler.recordSample(Profiler::Sample_AfterSceneRender);
+}
+
+void Window::render_model(Model& model)
+{
+	StreamBuffer::beginFrame();
+	if (stereo == STEREO_MULTIPASS)
+	{
+		ovr::for_each_eye([&model](ovrEyeType eye)
+		{
+			begin_frame(eye);
+			model.draw(shaderProgram);
+			RenderQueue::execute();
+		});
+	}
+	else
+	{
+		begin_frame();
+		model.draw(shaderProgram);
+		RenderQueue::execute();
+	}
+	StreamBuffer::endFrame();
+}
+
+void Window::begin_frame(ovrEyeType eye)
+{
+	// Clear the color and depth buffers, the right eye of a multipass frame shares them with the left
+	if (eye != ovrEye_Right)
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	// Use the shader of programID, which is only bound again if something else was since
+	GLState::useProgram(shaderProgram);
+
+	// Setup the camera and light properties, shared by every draw this frame
+	FrameData frame;
+	frame.lightPosition = glm::vec4(lightPos, 1.0f);
+	frame.lightAmbient = glm::vec4(lightAmbient, 1.0f);
+	frame.lightDiffuse = glm::vec4(lightDiffuse, 1.0f);
+	frame.lightSpecular = glm::vec4(lightSpecular, 1.0f);
+	frame.eyeCount = 1;
+	if (stereo == STEREO_OFF)
+	{
+		frame.projection[0] = P;
+		frame.view[0] = V;
+		frame.viewPos[0] = glm::vec4(cam_pos, 1.0f);
+		// levels of detail are picked and culling is done against the same camera
+		LodSelector::setView(P, V, render_height);
+		FrustumCuller::setView(P * V);
+		RenderQueue::begin(V);
+	}
+	else
+	{
+		glm::mat4 eyeProjections[ovrEye_Count], eyeViews[ovrEye_Count];
+		ovr::for_each_eye([&](ovrEyeType e)
+		{
+			eyeProjections[e] = StereoCamera::getProjection(hmd, e, NEAR_PLANE, FAR_PLANE);
+			eyeViews[e] = StereoCamera::getView(hmd, e, V);
+		});
+
+		if (eye == ovrEye_Count)
+		{
+			// both eyes in one pass, each squeezed into its half of the target
+			ovr::for_each_eye([&](ovrEyeType e)
+			{
+				frame.projection[e] = StereoCamera::toSideBySide(eyeProjections[e], e);
+				frame.view[e] = eyeViews[e];
+				frame.viewPos[e] = glm::inverse(eyeViews[e])[3];
+			});
+			frame.eyeCount = ovrEye_Count;
+			FrustumCuller::setStereoView(eyeProjections[ovrEye_Left] * eyeViews[ovrEye_Left], eyeProjections[ovrEye_Right] * eyeViews[ovrEye_Right]);
+		}
+		else
+		{
+			GLState::viewport(eye * render_width / 2, 0, render_width / 2, render_height);
+			frame.projection[0] = eyeProjections[eye];
+			frame.view[0] = eyeViews[eye];
+			frame.viewPos[0] = glm::inverse(eyeViews[eye])[3];
+			FrustumCuller::setView(eyeProjections[eye] * eyeViews[eye]);
+		}
+		// front to back from between the eyes, or from the eye drawn this pass
+		RenderQueue::begin(eye == ovrEye_Count ? V : eyeViews[eye]);
+		// from between the eyes, so both get the same levels
+		LodSelector::setView(eyeProjections[ovrEye_Left], V, render_height);
+	}
+	FrameUniforms::update(frame);
+
+	// only does anything when meshes with new materials were loaded
+	MaterialTable::upload();
+	profiler.recordSample(Profiler::Sample_AfterUniformSetup);
 }
 
 void Window::key_callback(GLFWwindow* window, int key, int scancode, int action, int mods)
@@ -144,5 +353,52 @@ void Window::key_callback(GLFWwindow* window, int key, int scancode, int action,
 			// Close the window. This causes the program to also terminate.
 			glfwSetWindowShouldClose(window, GL_TRUE);
 		}
+		// dump the profiler history
+		else if (key == GLFW_KEY_P)
+		{
+			dump_profile();
+		}
+		// go through the stereo modes with a made up headset, both eyes side by side in the window
+		else if (key == GLFW_KEY_I)
+		{
+			StereoMode next = (StereoMode)((stereo + 1) % (STEREO_MULTIPASS + 1));
+			set_stereo(next, HmdDescription::synthetic(HMD_DEFAULT_FOV, HMD_DEFAULT_IPD, width / 2, height));
+		}
+		// switch between sorted and immediate drawing, to compare their state changes
+		else if (key == GLFW_KEY_Q)
+		{
+			RenderQueue::setEnabled(!RenderQueue::isEnabled());
+			cout << "Render queue " << (RenderQueue::isEnabled() ? "on" : "off") << ", " << RenderStats::lastFrame.stateChanges()
+				<< " state changes last frame" << endl;
+		}
+	}
+}
+
+void Window::dump_profile()
+{
+	double cpuMs[Profiler::Sample_LAST], gpuMs[Profiler::Sample_LAST];
+	profiler.getAverages(cpuMs, gpuMs);
+
+	cout << "\nAverage frame times (CPU / GPU):" << endl;
+	for (int i = 0; i < Profiler::Sample_LAST; ++i)
+	{
+		cout << "  " << Profiler::getSampleName((Profiler::SampleType)i) << ": " << cpuMs[i] << " ms / " << gpuMs[i] << " ms" << endl;
 	}
+
+	TextureCacheStats textures = TextureCache::getStats();
+	cout << "Textures: " << textures.texturesResident << " resident (" << textures.texturesReferenced << " in use), "
+		<< textures.bytesResident / 1024 << " KB, " << textures.hits << " hits, " << textures.misses << " misses, "
+		<< textures.evictions << " evictions" << endl;
+
+	const FrameStats& stats = RenderStats::lastFrame;
+	cout << "State changes last frame: " << stats.stateChanges() << " (" << stats.uniformUpdates << " uniforms), "
+		<< stats.redundantStateCalls << " redundant ones dropped" << endl;
+
+	if (resolution)
+		cout << "Resolution scale: " << resolution->getScale() << " (" << render_width << "x" << render_height << ")" << endl;
+
+	if (profiler.dumpCSV(PROFILER_CSV_PATH) && profiler.dumpJSON(PROFILER_JSON_PATH))
+		cout << "Wrote " << PROFILER_CSV_PATH << " and " << PROFILER_JSON_PATH << endl;
+	else
+		cerr << "ERROR::PROFILER::Can't write the profile" << endl;
 }
\ No newline at end of file
@@ -14,21 +14,49 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <OVR_CAPI.h>
 #include "shader.h"
+#include "StereoCamera.h"
+
+class Model;
 
 class Window
 {
 public:
 	static int width;
 	static int height;
+	// what the scene is drawn at, less than width and height when the GPU can't keep up
+	static int render_width;
+	static int render_height;
 	static glm::mat4 P; // P for projection
 	static glm::mat4 V; // V for view
 	static void initialize_objects();
+	// blocks until every model and texture requested so far is uploaded
+	static void finish_loading();
 	static void clean_up();
 	static GLFWwindow* create_window(int width, int height);
 	static void resize_callback(GLFWwindow* window, int width, int height);
 	static void idle_callback();
 	static void display_callback(GLFWwindow*);
+	// draws the scene into the current framebuffer, alpha is how far we are between the last two ticks
+	static void render_frame(float alpha);
+	// draws only model, with the same camera and light as the scene
+	static void render_model(Model& model);
+	// advances the scene by exactly one simulation tick
+	static void update_objects();
+	static void set_camera(const glm::vec3& position, const glm::vec3& look_at);
+	// Draws every frame from now on for hmd, with both eyes next to each other in the current
+	// framebuffer. The camera is where the head is.
+	static void set_stereo(StereoMode mode, const HmdDescription& hmd);
+	// prints the profiler's stage averages and texture cache stats, and writes the profiler history to CSV and JSON
+	static void dump_profile();
 	static void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
+
+private:
+	static StereoMode stereo;
+	static HmdDescription hmd;
+
+	// Clears the framebuffer and sets up the program and uniforms every draw shares. Sets up
+	// every eye at once, or only eye when the eyes are drawn one after the other.
+	static void begin_frame(ovrEyeType eye = ovrEye_Count);
 };
 
 #endif
@@ -0,0 +1,35 @@
+#include "WorkSignal.h"
+
+void WorkSignal::post(size_t count)
+{
+	{
+		lock_guard<mutex> locker(lock);
+		queued += (ptrdiff_t)count;
+	}
+	if (count == 1)
+		changed.notify_one();
+	else
+		changed.notify_all();
+}
+
+void WorkSignal::take(size_t count)
+{
+	lock_guard<mutex> locker(lock);
+	queued -= (ptrdiff_t)count;
+}
+
+bool WorkSignal::wait()
+{
+	unique_lock<mutex> locker(lock);
+	changed.wait(locker, [this] { return quit || queued > 0; });
+	return !quit;
+}
+
+void WorkSignal::shutdown()
+{
+	{
+		lock_guard<mutex> locker(lock);
+		quit = true;
+	}
+	changed.notify_all();
+}
@@ -0,0 +1,35 @@
+#ifndef _WORK_SIGNAL_H
+#define _WORK_SIGNAL_H
+
+#include <stddef.h>
+#include <mutex>
+#include <condition_variable>
+
+using namespace std;
+
+// What worker threads sleep on while there's nothing queued. It counts the queued items
+// itself, so a post() can't get lost between a worker looking at its queue and going to sleep.
+// The count has to follow the queue: post() after pushing, take() after popping.
+class WorkSignal
+{
+public:
+	WorkSignal() : queued(0), quit(false) {}
+
+	// count items were just queued
+	void post(size_t count = 1);
+	// an item was just taken off the queue
+	void take(size_t count = 1);
+	// Sleeps until something's queued or shutdown() was called. Returns false on shutdown.
+	bool wait();
+	// wakes every waiting worker for good
+	void shutdown();
+
+private:
+	mutex lock;
+	condition_variable changed;
+	// can dip below 0 when an item is taken before its post() comes in
+	ptrdiff_t queued;
+	bool quit;
+};
+
+#endif
@@ -1,4 +1,5 @@
 #include "main.h"
+#include "GLState.h"
 
 GLFWwindow* window;
 
@@ -40,14 +41,14 @@ void setup_opengl_settings()
 	setup_glew();
 #endif
 	// Enable depth buffering
-	glEnable(GL_DEPTH_TEST);
+	GLState::setEnabled(GL_DEPTH_TEST, true);
 	// Related to shaders and z value comparisons for the depth buffer
-	glDepthFunc(GL_LEQUAL);
+	GLState::depthFunc(GL_LEQUAL);
 	// Set polygon drawing mode to fill front and back of each polygon
 	// You can also use the paramter of GL_LINE instead of GL_FILL to see wireframes
 	glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 	// Disable backface culling to render both sides of polygons
-	glDisable(GL_CULL_FACE);
+	GLState::setEnabled(GL_CULL_FACE, false);
 	// Set clear color to dark blue
 	glClearColor(0.0f, 0.0f, 0.5f, 1.0f);
 }
@@ -64,8 +65,68 @@ void print_versions()
 #endif
 }
 
-int main(void)
+// Renders a fixed number of offscreen frames and writes a report instead of opening the game window
+int run_render_benchmark(const RenderBenchmarkOptions& options)
 {
+	if (!RenderBenchmark::createContext(options, window))
+		exit(EXIT_FAILURE);
+	print_versions();
+	// no callbacks, nothing is shown and there's no input
+	setup_opengl_settings();
+	Window::initialize_objects();
+	// every frame has to draw the same thing, not placeholders
+	Window::finish_loading();
+
+	int result = options.vertexFormats ? RenderBenchmark::runVertexFormats(options) : RenderBenchmark::run(options);
+
+	Window::clean_up();
+	RenderBenchmark::destroyContext(window);
+	return result;
+}
+
+// Cooks the given models and images, or every model the game loads, so the next launch
+// can skip Assimp and texture compression. Prints the vertex cache numbers of every model,
+// "--cook ../Assets/*/*.obj" reports on all of them. Models are cooked with packed vertices
+// unless --float-vertices comes first.
+int cook_assets(int argc, char** argv)
+{
+	const char* defaultPaths[] = { FACTORY_PATH, CO2_PATH, O2_PATH };
+
+	int first = 2;
+	VertexFormat format = MESH_DEFAULT_VERTEX_FORMAT;
+	if (argc > first && strcmp(argv[first], "--float-vertices") == 0)
+	{
+		format = VERTEX_FLOAT;
+		first++;
+	}
+
+	int failures = 0;
+	if (argc > first)
+	{
+		for (int i = first; i < argc; ++i)
+		{
+			size_t length = strlen(argv[i]);
+			bool model = length > 4 && strcmp(argv[i] + length - 4, ".obj") == 0;
+			failures += model ? !Model::cook(argv[i], format) : !DDSCache::cook(argv[i], TEXTURE_DEFAULT);
+		}
+	}
+	else
+	{
+		for (size_t i = 0; i < sizeof(defaultPaths) / sizeof(defaultPaths[0]); ++i)
+			failures += !Model::cook(defaultPaths[i], format);
+	}
+	return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc > 1 && strcmp(argv[1], "--cook") == 0)
+		exit(cook_assets(argc, argv));
+
+	RenderBenchmarkOptions benchmarkOptions;
+	if (RenderBenchmark::parseArgs(argc, argv, benchmarkOptions))
+		exit(run_render_benchmark(benchmarkOptions));
+
 	// Create the GLFW window
 	window = Window::create_window(640, 480);
 	// Print OpenGL and GLSL versions
@@ -80,10 +141,10 @@ int main(void)
 	// Loop while GLFW window should stay open
 	while (!glfwWindowShouldClose(window))
 	{
-		// Main render display callback. Rendering of objects is done here.
-		Window::display_callback(window);
 		// Idle callback. Updating objects, etc. can be done here.
 		Window::idle_callback();
+		// Main render display callback. Rendering of objects is done here.
+		Window::display_callback(window);
 	}
 
 	Window::clean_up();
@@ -10,6 +10,12 @@
 #include <GLFW/glfw3.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include "window.h"
+#include "RenderBenchmark.h"
+#include "Factory.h"
+#include "MoleculeRenderer.h"
+#include "DDSCache.h"
+#include "TextureCache.h"
 
 #endif
\ No newline at end of file
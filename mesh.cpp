@@ -1,38 +1,183 @@
 #include "mesh.h"
-#include "Window.h"
+#include "shader.h"
+#include "RenderStats.h"
+#include "UniformBuffers.h"
+#include "GLState.h"
+
+#include <math.h>
+#include <algorithm>
+#include <iostream>
 
 Mesh::Mesh(vector<Vertex> vertices, vector<GLuint> indices, vector<Texture> textures,
-		   glm::vec3 ambient, glm::vec3 diffuse, glm::vec3 specular, float shininess)
+		   glm::vec3 ambient, glm::vec3 diffuse, glm::vec3 specular, float shininess,
+		   MeshUsage usage)
 {
-	this->vertices = vertices;
-	this->indices = indices;
-	this->textures = textures;
+	this->vertices = std::move(vertices);
+	this->indices = std::move(indices);
+	this->textures = std::move(textures);
+	this->indexCount = (GLsizei)this->indices.size();
+	this->vertexFormat = VERTEX_FLOAT;
+	this->positionScale = glm::vec3(1.0f);
+	this->positionOffset = glm::vec3(0.0f);
+	this->usage = usage;
+	this->setMaterial(ambient, diffuse, specular, shininess);
+
+	// just the one level, these meshes are built at runtime and never simplified
+	MeshLod lod = { 0, (GLuint)this->vertices.size(), 0, (GLuint)this->indexCount, 0.0f };
+	this->setLods(&lod, 1, computeBounds(this->vertices.data(), this->vertices.size()));
 
+	// half the index bandwidth for every mesh small enough, which is nearly all of them
+	if (fitsShortIndices(this->vertices.size()))
+	{
+		vector<GLushort> shortIndices(this->indices.begin(), this->indices.end());
+		this->indexType = GL_UNSIGNED_SHORT;
+		this->setupMesh(this->vertices.data(), (GLsizei)this->vertices.size(), shortIndices.data());
+	}
+	else
+	{
+		this->indexType = GL_UNSIGNED_INT;
+		this->setupMesh(this->vertices.data(), (GLsizei)this->vertices.size(), this->indices.data());
+	}
+}
+
+Mesh::Mesh(const MeshSource& source, glm::vec3 ambient, glm::vec3 diffuse, glm::vec3 specular, float shininess)
+{
+	this->indexCount = source.indexCount;
+	this->indexType = source.indexType;
+	this->vertexFormat = source.vertexFormat;
+	this->positionScale = source.positionScale;
+	this->positionOffset = source.positionOffset;
+	this->usage = MESH_STATIC;
+
+	this->setMaterial(ambient, diffuse, specular, shininess);
+	// a source without an LOD chain is just the full mesh
+	MeshLod full = { 0, (GLuint)source.vertexCount, 0, (GLuint)source.indexCount, 0.0f };
+	if (source.lodCount > 0)
+		this->setLods(source.lods, source.lodCount, source.bounds);
+	else
+		this->setLods(&full, 1, source.bounds);
+	this->setupMesh(source.vertices, source.vertexCount, source.indices);
+}
+
+void Mesh::setMaterial(glm::vec3 ambient, glm::vec3 diffuse, glm::vec3 specular, float shininess)
+{
 	this->ambient = ambient;
 	this->diffuse = diffuse;
 	this->specular = specular;
 	this->shininess = shininess;
+	this->materialIndex = MaterialTable::add(ambient, diffuse, specular, shininess);
 
 	this->toWorld = glm::mat4(1.0f);
 	this->toWorld = glm::scale(toWorld, glm::vec3(0.5f, 0.5f, 0.5f));
 	this->toWorld = glm::translate(toWorld, origin);
+	this->toModel = glm::mat4(1.0f);
+	this->node = 0;
+	this->lodLevel = 0;
+	this->instanceVBO = 0;
+	this->instanceGeneration = 0;
+	this->instanceOffset = 0;
+	this->pointedOffset = MESH_NOT_POINTED;
+	this->instanceDivisor = 1;
+}
+
+void Mesh::setLods(const MeshLod* lods, GLsizei lodCount, const MeshBounds& bounds)
+{
+	this->lods.assign(lods, lods + lodCount);
+
+	lodChain.levels = (unsigned)lodCount;
+	for (GLsizei i = 0; i < lodCount; ++i)
+		lodChain.errors[i] = lods[i].error;
+	lodChain.center = bounds.center;
+	lodChain.radius = bounds.radius;
+	this->bounds = bounds;
+}
+
+MeshBounds Mesh::computeBounds(const Vertex* vertices, size_t vertexCount)
+{
+	// the box around the mesh, and the furthest vertex from its middle
+	MeshBounds bounds;
+	bounds.min = bounds.max = glm::vec3(0.0f);
+	for (size_t i = 0; i < vertexCount; ++i)
+	{
+		bounds.min = i ? glm::min(bounds.min, vertices[i].position) : vertices[i].position;
+		bounds.max = i ? glm::max(bounds.max, vertices[i].position) : vertices[i].position;
+	}
+	bounds.center = (bounds.min + bounds.max) * 0.5f;
+
+	float radiusSquared = 0.0f;
+	for (size_t i = 0; i < vertexCount; ++i)
+	{
+		glm::vec3 offset = vertices[i].position - bounds.center;
+		radiusSquared = max(radiusSquared, glm::dot(offset, offset));
+	}
+	bounds.radius = sqrtf(radiusSquared);
+	return bounds;
+}
 
-	this->setupMesh();
+Mesh::Mesh(Mesh&& other) noexcept
+	: VAO(0), VBO(0), EBO(0)
+{
+	*this = std::move(other);
+}
+
+Mesh& Mesh::operator=(Mesh&& other) noexcept
+{
+	if (this != &other)
+	{
+		// release whatever we owned before taking over the other mesh's buffers
+		GLState::deleteVertexArrays(1, &VAO);
+		GLState::deleteBuffers(1, &VBO);
+		GLState::deleteBuffers(1, &EBO);
+
+		vertices = std::move(other.vertices);
+		indices = std::move(other.indices);
+		textures = std::move(other.textures);
+		ambient = other.ambient;
+		diffuse = other.diffuse;
+		specular = other.specular;
+		shininess = other.shininess;
+		materialIndex = other.materialIndex;
+		toWorld = other.toWorld;
+		toModel = other.toModel;
+		node = other.node;
+		usage = other.usage;
+		indexCount = other.indexCount;
+		indexType = other.indexType;
+		lods = std::move(other.lods);
+		lodChain = other.lodChain;
+		bounds = other.bounds;
+		lodLevel = other.lodLevel;
+		instanceVBO = other.instanceVBO;
+		instanceGeneration = other.instanceGeneration;
+		instanceOffset = other.instanceOffset;
+		pointedOffset = other.pointedOffset;
+		instanceDivisor = other.instanceDivisor;
+		vertexFormat = other.vertexFormat;
+		positionScale = other.positionScale;
+		positionOffset = other.positionOffset;
+
+		VAO = other.VAO;
+		VBO = other.VBO;
+		EBO = other.EBO;
+		// the moved-from mesh must not delete the buffers in its destructor
+		other.VAO = other.VBO = other.EBO = 0;
+	}
+	return *this;
 }
 
 Mesh::~Mesh()
 {
-	// clean up buffers
-	glDeleteVertexArrays(1, &VAO);
-	glDeleteBuffers(1, &VBO);
-	glDeleteBuffers(1, &EBO);
+	// clean up buffers, deleting 0 is silently ignored
+	GLState::deleteVertexArrays(1, &VAO);
+	GLState::deleteBuffers(1, &VBO);
+	GLState::deleteBuffers(1, &EBO);
 
 	vertices.clear();
 	indices.clear();
 	textures.clear();
 }
 
-void Mesh::setupMesh()
+void Mesh::setupMesh(const GLvoid* vertexData, GLsizei vertexCount, const GLvoid* indexData)
 {
 	// Create array object and buffers
 	glGenVertexArrays(1, &VAO);
@@ -40,42 +185,155 @@ void Mesh::setupMesh()
 	glGenBuffers(1, &EBO);
 
 	// Bind the vertex array object (VAO) first, then bind the associated buffers to it.
-	glBindVertexArray(VAO);
-	setupGLBuffers();
-	glBindVertexArray(0);
-}
+	// Everything set here is remembered by the VAO, so drawing only has to bind it again.
+	GLState::bindVertexArray(VAO);
 
-void Mesh::setupGLBuffers()
-{
 	// copy vertices into vertex buffer for OpenGL to use
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+	GLsizei vertexSize = getVertexSize(vertexFormat);
+	GLState::bindBuffer(GL_ARRAY_BUFFER, VBO);
+	createBuffer(GL_ARRAY_BUFFER, (GLsizeiptr)vertexCount * vertexSize, vertexData);
 
 	// copy the face indices unto element buffer for OpenGL to use
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), &indices[0], GL_STATIC_DRAW);
+	GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+	createBuffer(GL_ELEMENT_ARRAY_BUFFER, indexCount * (indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint)), indexData);
 
-	// Pass the vertex position data to OpenGL
 	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(
-		0,				// same as number in "layout (location = x)" in vertex shader
-		3,				// x, y, z components per vertex
-		GL_FLOAT,		// component type
-		GL_FALSE,		// don't normalize
-		sizeof(Vertex),	// offset between consecutive indices
-		(GLvoid*)0		// offset of the vertex's component
-	);
-
-	// vertex normals
 	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, normal));
-
-	// Vertex Texture coords
 	glEnableVertexAttribArray(2);
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, texCoords));
+	if (vertexFormat == VERTEX_PACKED)
+	{
+		// the shader sees the same three attributes either way, it only has to scale the
+		// position back up and decode the normal
+		glVertexAttribPointer(0, 3, GL_SHORT, GL_TRUE, vertexSize, (GLvoid*)offsetof(PackedVertex, position));
+		glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, vertexSize, (GLvoid*)offsetof(PackedVertex, normal));
+		glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, vertexSize, (GLvoid*)offsetof(PackedVertex, texCoords));
+	}
+	else
+	{
+		// Pass the vertex position data to OpenGL
+		glVertexAttribPointer(
+			0,				// same as number in "layout (location = x)" in vertex shader
+			3,				// x, y, z components per vertex
+			GL_FLOAT,		// component type
+			GL_FALSE,		// don't normalize
+			vertexSize,		// offset between consecutive indices
+			(GLvoid*)0		// offset of the vertex's component
+		);
+
+		// vertex normals
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, vertexSize, (GLvoid*)offsetof(Vertex, normal));
+
+		// Vertex Texture coords
+		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, vertexSize, (GLvoid*)offsetof(Vertex, texCoords));
+	}
+
+	GLState::bindVertexArray(0);
+	// NOTE: the element array buffer binding is part of the VAO, so only the array buffer gets unbound
+	GLState::bindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void Mesh::createBuffer(GLenum target, GLsizeiptr size, const GLvoid* data)
+{
+	if (GLEW_ARB_buffer_storage)
+	{
+		// immutable storage: the size can never change, and static meshes can't be written to at all
+		glBufferStorage(target, size, data, usage == MESH_DYNAMIC ? GL_DYNAMIC_STORAGE_BIT : 0);
+	}
+	else
+	{
+		glBufferData(target, size, data, usage == MESH_DYNAMIC ? GL_DYNAMIC_DRAW : GL_STATIC_DRAW);
+	}
+	RenderStats::current.geometryBytesUploaded += size;
+}
+
+void Mesh::attachInstanceBuffer(GLuint instanceVBO, GLintptr offset, unsigned generation)
+{
+	// a new buffer has to be pointed at even if the offset is the same
+	if (instanceVBO != this->instanceVBO || generation != instanceGeneration)
+		pointedOffset = MESH_NOT_POINTED;
+	this->instanceVBO = instanceVBO;
+	this->instanceGeneration = generation;
+	this->instanceOffset = offset;
 }
 
-void Mesh::draw(GLuint shaderProgram)
+// the VAO has to be bound already
+void Mesh::pointInstanceAttributes(GLintptr offset, GLuint divisor)
+{
+	// a mat4 attribute takes up four consecutive locations, one per column
+	GLState::bindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+	for (GLuint i = 0; i < 4; i++)
+	{
+		glEnableVertexAttribArray(3 + i);
+		glVertexAttribPointer(3 + i, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4),
+			(GLvoid*)(offset + sizeof(glm::vec4) * i));
+		// advance once per instance (and eye) instead of once per vertex
+		glVertexAttribDivisor(3 + i, divisor);
+	}
+
+	this->pointedOffset = offset;
+	this->instanceDivisor = divisor;
+}
+
+// Rounds to the nearest snorm16 under the GL 4.2 rule, c / 32767, so 32767 is 1 and -32767 is -1.
+// The 3.3 context we ask for may decode with (2c + 1) / 65535 instead, which shifts every value by
+// half a step and never gives exactly 0. That's 1/65535 of the range, far below what shows.
+static GLshort toSnorm16(float value)
+{
+	return (GLshort)glm::round(glm::clamp(value, -1.0f, 1.0f) * 32767.0f);
+}
+
+PackedVertex Mesh::packVertex(const Vertex& vertex, const glm::vec3& positionScale, const glm::vec3& positionOffset)
+{
+	PackedVertex packed;
+
+	glm::vec3 position = vertex.position - positionOffset;
+	for (int i = 0; i < 3; ++i)
+		packed.position[i] = positionScale[i] > 0.0f ? toSnorm16(position[i] / positionScale[i]) : 0;
+	packed.position[3] = 0;
+
+	// project the normal onto the octahedron |x| + |y| + |z| = 1, then fold its lower half
+	// out over the corners of the upper half's square
+	glm::vec3 normal = vertex.normal;
+	float length = fabs(normal.x) + fabs(normal.y) + fabs(normal.z);
+	normal = length > 0.0f ? normal / length : glm::vec3(0.0f, 0.0f, 1.0f);
+	glm::vec2 octahedral(normal.x, normal.y);
+	if (normal.z < 0.0f)
+	{
+		octahedral.x = (1.0f - fabs(normal.y)) * (normal.x >= 0.0f ? 1.0f : -1.0f);
+		octahedral.y = (1.0f - fabs(normal.x)) * (normal.y >= 0.0f ? 1.0f : -1.0f);
+	}
+	packed.normal[0] = toSnorm16(octahedral.x);
+	packed.normal[1] = toSnorm16(octahedral.y);
+
+	glm::uint texCoords = glm::packHalf2x16(vertex.texCoords);
+	packed.texCoords[0] = (GLushort)(texCoords & 0xffff);
+	packed.texCoords[1] = (GLushort)(texCoords >> 16);
+	return packed;
+}
+
+void Mesh::updateVertices(const vector<Vertex>& newVertices)
+{
+	if (usage != MESH_DYNAMIC)
+	{
+		cerr << "ERROR::MESH::Attempting to update the vertices of a static mesh" << endl;
+		return;
+	}
+	if (newVertices.size() != vertices.size())
+	{
+		cerr << "ERROR::MESH::Dynamic mesh updates can't change the vertex count" << endl;
+		return;
+	}
+
+	vertices = newVertices;
+
+	GLsizeiptr size = vertices.size() * sizeof(Vertex);
+	GLState::bindBuffer(GL_ARRAY_BUFFER, VBO);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, size, &vertices[0]);
+	GLState::bindBuffer(GL_ARRAY_BUFFER, 0);
+	RenderStats::current.geometryBytesUploaded += size;
+}
+
+void Mesh::draw(GLuint shaderProgram, unsigned lod)
 {
 	GLuint diffuseNum = 1;
 	GLuint specularNum = 1;
@@ -93,31 +351,20 @@ void Mesh::draw(GLuint shaderProgram)
 	//	glBindTexture(GL_TEXTURE_2D, this->textures[i].id);
 	//}
 
-	// calculate the modelview
-	glm::mat4 modelview = Window::V * toWorld;
+	// the projection, view and light come from the per-frame uniform block,
+	// so only the model matrix and the material index change per draw
+	const ShaderUniforms& uniforms = GetShaderUniforms(shaderProgram);
+	glUniformMatrix4fv(uniforms.model, 1, GL_FALSE, &toWorld[0][0]);
+	glUniform1i(uniforms.instanced, GL_FALSE);
+	glUniform1i(uniforms.materialIndex, materialIndex);
+	setVertexUniforms(uniforms);
 
-	// propagate matrices to the shader program
-	GLuint projLoc = glGetUniformLocation(shaderProgram, "projection");
-	GLuint mvLoc = glGetUniformLocation(shaderProgram, "modelview");
-	glUniformMatrix4fv(projLoc, 1, GL_FALSE, &Window::P[0][0]);
-	glUniformMatrix4fv(mvLoc, 1, GL_FALSE, &modelview[0][0]);
+	// draw the mesh, the VAO already knows where all its data is. It's left bound, GLState
+	// skips binding it again if the next draw is the same mesh.
+	GLState::bindVertexArray(VAO);
+	drawBound(lod);
 
-	// pass the material properties to the shader
-	GLint matAmbientLoc = glGetUniformLocation(shaderProgram, "material.ambient");
-	GLint matDiffuseLoc = glGetUniformLocation(shaderProgram, "material.diffuse");
-	GLint matSpecularLoc = glGetUniformLocation(shaderProgram, "material.specular");
-	GLint matShineLoc = glGetUniformLocation(shaderProgram, "material.shininess");
-
-	glUniform3fv(matAmbientLoc, 1, &ambient[0]);
-	glUniform3fv(matDiffuseLoc, 1, &diffuse[0]);
-	glUniform3fv(matSpecularLoc, 1, &specular[0]);
-	glUniform1f(matShineLoc, shininess);
-
-	// draw the mesh
-	glBindVertexArray(VAO);
-	setupGLBuffers();
-	glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-	glBindVertexArray(0);
+	RenderStats::current.uniformUpdates += 6;
 
 	// Always good practice to set everything back to defaults once configured.
 	// NOTE: this is not needed in this assignment, but may be later
@@ -126,4 +373,64 @@ void Mesh::draw(GLuint shaderProgram)
 	//	glActiveTexture(GL_TEXTURE0 + i);
 	//	glBindTexture(GL_TEXTURE_2D, 0);
 	//}
-}
\ No newline at end of file
+}
+
+// Draws instanceCount copies of this mesh in one call. Each instance's toWorld matrix
+// is read from the buffer given to attachInstanceBuffer() and replaces the model's place in
+// the world, so this mesh's own toWorld is ignored but its toModel isn't.
+void Mesh::drawInstanced(GLuint shaderProgram, GLsizei instanceCount, unsigned lod, GLuint firstInstance)
+{
+	if (instanceCount <= 0)
+		return;
+
+	const ShaderUniforms& uniforms = GetShaderUniforms(shaderProgram);
+	glUniformMatrix4fv(uniforms.model, 1, GL_FALSE, &toModel[0][0]);
+	glUniform1i(uniforms.instanced, GL_TRUE);
+	glUniform1i(uniforms.materialIndex, materialIndex);
+	setVertexUniforms(uniforms);
+
+	GLState::bindVertexArray(VAO);
+	drawBound(lod, instanceCount, firstInstance);
+
+	RenderStats::current.uniformUpdates += 6;
+}
+
+void Mesh::drawBound(unsigned lod, GLsizei instanceCount, GLuint firstInstance)
+{
+	const MeshLod& level = lods[min(lod, (unsigned)lods.size() - 1)];
+	// in stereo the shader picks the eye from the instance, so everything is drawn once per
+	// eye and an instance's matrix is read once per eye as well
+	GLuint eyeCount = (GLuint)FrameUniforms::getEyeCount();
+	if (instanceCount <= 0)
+	{
+		if (eyeCount == 1)
+			glDrawElementsBaseVertex(GL_TRIANGLES, level.indexCount, indexType, getIndexOffset(level), level.firstVertex);
+		else
+			glDrawElementsInstancedBaseVertex(GL_TRIANGLES, level.indexCount, indexType, getIndexOffset(level), eyeCount, level.firstVertex);
+		RenderStats::current.trianglesDrawn += level.indexCount / 3 * eyeCount;
+	}
+	else
+	{
+		// GL 3.3 has no base instance, so the instance attributes are moved to the first one instead
+		GLintptr offset = instanceOffset + firstInstance * sizeof(glm::mat4);
+		if (offset != pointedOffset || eyeCount != instanceDivisor)
+			pointInstanceAttributes(offset, eyeCount);
+		glDrawElementsInstancedBaseVertex(GL_TRIANGLES, level.indexCount, indexType, getIndexOffset(level), instanceCount * eyeCount, level.firstVertex);
+		RenderStats::current.trianglesDrawn += level.indexCount / 3 * instanceCount * eyeCount;
+	}
+	RenderStats::current.drawCalls++;
+}
+
+// where level's indices start in the element buffer
+const GLvoid* Mesh::getIndexOffset(const MeshLod& level) const
+{
+	return (const GLvoid*)(level.firstIndex * (indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint)));
+}
+
+// how the vertex shader gets from this mesh's vertex format back to floats
+void Mesh::setVertexUniforms(const ShaderUniforms& uniforms) const
+{
+	glUniform3fv(uniforms.positionScale, 1, &positionScale[0]);
+	glUniform3fv(uniforms.positionOffset, 1, &positionOffset[0]);
+	glUniform1i(uniforms.octahedralNormals, vertexFormat == VERTEX_PACKED);
+}
@@ -10,10 +10,19 @@
 
 #include <assimp/scene.h>
 
+#include "LodSelector.h"
+
 using namespace std;
 
+struct ShaderUniforms;
+
 static glm::vec3 origin = glm::vec3(0.0f, -5.0f, 0.0f);
 
+// meshes with at most this many vertices are drawn with 16 bit indices
+#define MESH_MAX_SHORT_INDEXED_VERTICES 65536
+// the instance attributes of a mesh that wasn't drawn instanced yet
+#define MESH_NOT_POINTED ((GLintptr)-1)
+
 struct Vertex
 {
 	glm::vec3 position;
@@ -21,6 +30,58 @@ struct Vertex
 	glm::vec2 texCoords;
 };
 
+// How a mesh's vertices are laid out in its vertex buffer, picked when the model is cooked
+enum VertexFormat
+{
+	VERTEX_FLOAT,	// Vertex, 32 bytes
+	VERTEX_PACKED	// PackedVertex, 16 bytes
+};
+
+// Half the size of Vertex. The position is snorm16 inside the box the mesh's positionScale and
+// positionOffset describe, the normal is octahedral encoded into two snorm16s and the
+// texture coordinates are half floats.
+struct PackedVertex
+{
+	GLshort position[4];	// w is only padding
+	GLshort normal[2];
+	GLushort texCoords[2];
+};
+
+// One level of detail in a mesh's buffers. Every level has its own run of vertices and
+// indices, and its indices count from its own first vertex.
+struct MeshLod
+{
+	GLuint firstVertex;
+	GLuint vertexCount;
+	GLuint firstIndex;
+	GLuint indexCount;
+	float error;	// how far this level strays from the full mesh, in object space
+};
+
+// Object space bounds of a mesh, for culling and picking levels of detail
+struct MeshBounds
+{
+	glm::vec3 center;	// of the box, the sphere is around it too
+	float radius;
+	glm::vec3 min, max;
+};
+
+// Vertex and index data a mesh uploads without owning it, like a mapped cooked file
+struct MeshSource
+{
+	const GLvoid* vertices;
+	VertexFormat vertexFormat;
+	GLsizei vertexCount;
+	const GLvoid* indices;
+	GLenum indexType;	// GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+	GLsizei indexCount;
+	// a packed position is position * positionScale + positionOffset
+	glm::vec3 positionScale, positionOffset;
+	const MeshLod* lods;	// lodCount levels, the first one is the full mesh
+	GLsizei lodCount;
+	MeshBounds bounds;	// of the full mesh
+};
+
 struct Texture
 {
 	GLuint id;
@@ -28,6 +89,14 @@ struct Texture
 	aiString path;
 };
 
+// Static meshes are uploaded once and can never change. Dynamic meshes can be rewritten with updateVertices().
+enum MeshUsage
+{
+	MESH_STATIC,
+	MESH_DYNAMIC
+};
+
+// A Mesh owns its GL buffers, so it can be moved but not copied
 class Mesh
 {
 public:
@@ -37,19 +106,83 @@ public:
 
 	glm::vec3 ambient, diffuse, specular;
 	float shininess;
+	GLint materialIndex;	// into the MaterialTable
 
 	glm::mat4 toWorld;
+	// where the mesh sits in its model, instanced draws put each instance's toWorld in front of it
+	glm::mat4 toModel;
+	unsigned node;	// in its model's TransformHierarchy
+	unsigned lodLevel;	// drawn at last time, LodSelector needs it for its hysteresis
 
 	Mesh(vector<Vertex> vertices, vector<GLuint> indices, vector<Texture> textures,
-		 glm::vec3 ambient, glm::vec3 diffuse, glm::vec3 specular, float shininess);
+		 glm::vec3 ambient, glm::vec3 diffuse, glm::vec3 specular, float shininess,
+		 MeshUsage usage = MESH_STATIC);
+	// Uploads straight from source, in whichever vertex format it's in. No CPU copy of the
+	// vertices or indices is kept, so the mesh is always static.
+	Mesh(const MeshSource& source, glm::vec3 ambient, glm::vec3 diffuse, glm::vec3 specular, float shininess);
+	Mesh(Mesh&& other) noexcept;
+	Mesh& operator=(Mesh&& other) noexcept;
+	Mesh(const Mesh&) = delete;
+	Mesh& operator=(const Mesh&) = delete;
 	~Mesh();
 
-	void draw(GLuint shaderProgram);
+	// Levels past the end of the LOD chain draw its coarsest level. Draws every eye of the
+	// frame at once, see FrameUniforms::getEyeCount.
+	void draw(GLuint shaderProgram, unsigned lod = 0);
+	// Draws the instances from firstInstance on in the buffer given to attachInstanceBuffer(),
+	// each at its toWorld * toModel and once per eye
+	void drawInstanced(GLuint shaderProgram, GLsizei instanceCount, unsigned lod = 0, GLuint firstInstance = 0);
+
+	// For the RenderQueue, which binds the VAO and sets the uniforms itself, only when they change
+	GLuint getVertexArray() const { return VAO; }
+	void setVertexUniforms(const ShaderUniforms& uniforms) const;
+	// Draws lod with the VAO already bound, instanceCount instances from firstInstance on or
+	// not instanced at all when it's 0. Every eye of the frame at once either way.
+	void drawBound(unsigned lod, GLsizei instanceCount = 0, GLuint firstInstance = 0);
+
+	// Where the per-instance toWorld matrices are, from offset bytes into instanceVBO. The
+	// attributes are pointed there by the next instanced draw. A different generation means a
+	// different buffer even if GL gave it the same name, see StreamChunk.
+	void attachInstanceBuffer(GLuint instanceVBO, GLintptr offset = 0, unsigned generation = 0);
+
+	const LodChain& getLodChain() const { return lodChain; }
+	const MeshBounds& getBounds() const { return bounds; }
+	// the box around every vertex, and a sphere around that that's not the smallest one but close
+	static MeshBounds computeBounds(const Vertex* vertices, size_t vertexCount);
+
+	// Replaces the vertex data of a MESH_DYNAMIC mesh. The vertex count can't change.
+	void updateVertices(const vector<Vertex>& newVertices);
+
+	// whether a mesh with this many vertices can use 16 bit indices
+	static bool fitsShortIndices(size_t vertexCount) { return vertexCount <= MESH_MAX_SHORT_INDEXED_VERTICES; }
+
+	static GLsizei getVertexSize(VertexFormat format) { return format == VERTEX_PACKED ? sizeof(PackedVertex) : sizeof(Vertex); }
+	// Packs vertices into the box given by positionScale and positionOffset, which every
+	// position has to be inside of
+	static PackedVertex packVertex(const Vertex& vertex, const glm::vec3& positionScale, const glm::vec3& positionOffset);
 
 private:
 	GLuint VAO, VBO, EBO;
-	void setupMesh();
-	void setupGLBuffers();
+	GLsizei indexCount;
+	GLenum indexType;	// of the element buffer, indices always stays 32 bit
+	VertexFormat vertexFormat;	// of the vertex buffer, vertices are always floats
+	glm::vec3 positionScale, positionOffset;
+	MeshUsage usage;
+	vector<MeshLod> lods;
+	LodChain lodChain;
+	MeshBounds bounds;
+	GLuint instanceVBO;
+	unsigned instanceGeneration;	// given with instanceVBO
+	GLintptr instanceOffset;	// of the first instance in instanceVBO
+	GLintptr pointedOffset;		// the instance attributes point at, MESH_NOT_POINTED before the first instanced draw
+	GLuint instanceDivisor;	// of the instance attributes, the eye count they were pointed for
+
+	void setMaterial(glm::vec3 ambient, glm::vec3 diffuse, glm::vec3 specular, float shininess);
+	void setupMesh(const GLvoid* vertexData, GLsizei vertexCount, const GLvoid* indexData);
+	void setLods(const MeshLod* lods, GLsizei lodCount, const MeshBounds& bounds);
+	void pointInstanceAttributes(GLintptr offset, GLuint divisor);
+	const GLvoid* getIndexOffset(const MeshLod& level) const;
+	void createBuffer(GLenum target, GLsizeiptr size, const GLvoid* data);
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -1,68 +1,399 @@
 #include "model.h"
+#include "AssetLoader.h"
+#include "TextureCache.h"
+#include "DDSCache.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "FrustumCuller.h"
+#include "RenderQueue.h"
+
+#include <stdio.h>
+#include <algorithm>
 #include <iostream>
 
-Model::Model(GLchar* path)
+// half the size of the placeholder cube drawn while a model is loading
+#define PLACEHOLDER_EXTENT 1.0f
+
+Model::Model(const string& path, AssetLoader* loader)
+	: resident(false), loader(loader), loadTicket(0)
 {
-	this->loadModel(path);
+	// retrieve the directory path of the file
+	this->directory = path.substr(0, path.find_last_of('/'));
+	// just the root until the model's own nodes are loaded
+	this->buildTransforms(vector<ModelNode>());
+
+	if (loader)
+	{
+		this->createPlaceholder();
+		this->loadTicket = loader->loadModel(this, path);
+	}
+	else
+	{
+		this->loadModel(path);
+	}
 }
 
 Model::~Model()
 {
+	// the loader must not hand meshes to a model that's gone
+	if (loader && loadTicket)
+		loader->cancel(loadTicket);
+
 	meshes.clear();
+	placeholder.clear();
+	for (size_t i = 0; i < textures_loaded.size(); ++i)
+		TextureCache::release(textures_loaded[i].id);
 	textures_loaded.clear();
 }
 
 void Model::draw(GLuint shaderProgram)
 {
-	// draw all meshes associated with this model
-	for (GLuint i = 0; i < this->meshes.size(); i++)
+	this->updateTransforms();
+
+	// find the meshes that are in view before touching GL
+	vector<Mesh>& drawn = this->getMeshes();
+	cullCenters.resize(drawn.size());
+	cullExtents.resize(drawn.size());
+	cullVisible.resize(drawn.size());
+	for (size_t i = 0; i < drawn.size(); ++i)
+	{
+		const MeshBounds& bounds = drawn[i].getBounds();
+		FrustumCuller::getWorldBox(bounds.min, bounds.max, drawn[i].toWorld, cullCenters[i], cullExtents[i]);
+	}
+	if (!drawn.empty())
+		FrustumCuller::cullBoxes(&cullCenters[0], &cullExtents[0], drawn.size(), &cullVisible[0]);
+
+	// and draw those, each at the detail its size on screen needs
+	for (GLuint i = 0; i < drawn.size(); i++)
+	{
+		if (!cullVisible[i])
+			continue;
+		drawn[i].lodLevel = LodSelector::select(drawn[i].getLodChain(), drawn[i].toWorld, drawn[i].lodLevel);
+		if (RenderQueue::isEnabled())
+		{
+			DrawPacket packet = { shaderProgram, &drawn[i], drawn[i].lodLevel, drawn[i].materialIndex, &drawn[i].toWorld, 0, 0 };
+			RenderQueue::submit(packet, cullCenters[i]);
+		}
+		else
+			drawn[i].draw(shaderProgram, drawn[i].lodLevel);
+	}
+}
+
+void Model::updateTransforms()
+{
+	if (transforms.update() == 0)
+		return;
+
+	// toModel leaves out where the root puts the model, so instances can bring their own
+	glm::mat4 fromRoot = glm::inverse(transforms.getWorld(MODEL_ROOT_NODE));
+	vector<Mesh>& updated = this->getMeshes();
+	for (size_t i = 0; i < updated.size(); ++i)
+	{
+		if (!transforms.hasChanged(updated[i].node))
+			continue;
+		updated[i].toWorld = transforms.getWorld(updated[i].node);
+		updated[i].toModel = fromRoot * updated[i].toWorld;
+	}
+}
+
+void Model::buildTransforms(const vector<ModelNode>& nodes)
+{
+	// meshes have always been drawn at half size, around origin
+	Transform root(origin * 0.5f, glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(0.5f));
+	if (transforms.size() > 0)
+		root = transforms.getLocal(MODEL_ROOT_NODE);
+
+	// every node is new, so the next update recomputes them all
+	transforms.clear();
+	transforms.add(TRANSFORM_NO_PARENT, root);
+	for (size_t i = 0; i < nodes.size(); ++i)
+		transforms.add(nodes[i].parent == TRANSFORM_NO_PARENT ? MODEL_ROOT_NODE : MODEL_ROOT_NODE + 1 + nodes[i].parent, nodes[i].local);
+}
+
+LodChain Model::getLodChain() const
+{
+	// the coarsest any mesh gets, around all of them where they sit in the model
+	const vector<Mesh>& drawn = this->getMeshes();
+	LodChain chain = LodChain();
+	for (size_t i = 0; i < drawn.size(); ++i)
 	{
-		this->meshes[i].draw(shaderProgram);
+		LodChain mesh = drawn[i].getLodChain();
+		glm::vec4 sphere = FrustumCuller::getWorldSphere(mesh.center, mesh.radius, drawn[i].toModel);
+		mesh.center = glm::vec3(sphere);
+		mesh.radius = sphere.w;
+		if (i == 0)
+		{
+			chain = mesh;
+			continue;
+		}
+
+		for (unsigned l = 0; l < mesh.levels; ++l)
+			chain.errors[l] = l < chain.levels ? max(chain.errors[l], mesh.errors[l]) : mesh.errors[l];
+		// levels a mesh doesn't have are as good as its last one
+		for (unsigned l = mesh.levels; l < chain.levels; ++l)
+			chain.errors[l] = max(chain.errors[l], mesh.errors[mesh.levels - 1]);
+		chain.levels = max(chain.levels, mesh.levels);
+
+		float distance = glm::length(mesh.center - chain.center);
+		if (distance + mesh.radius > chain.radius)
+		{
+			float radius = (distance + mesh.radius + chain.radius) / 2.0f;
+			if (distance > 0.0f)
+				chain.center += (mesh.center - chain.center) * ((radius - chain.radius) / distance);
+			chain.radius = radius;
+		}
 	}
+	return chain;
 }
 
 void Model::loadModel(string path)
+{
+	MeshCache cache;
+	vector<MeshData> meshData;
+	vector<ModelNode> nodes;
+	if (!readMeshes(path, cache, meshData, nodes))
+		return;
+
+	unsigned meshCount = cache.isOpen() ? cache.getMeshCount() : (unsigned)meshData.size();
+	this->meshes.reserve(meshCount);
+	for (unsigned i = 0; i < meshCount; ++i)
+		this->meshes.push_back(createMesh(cache, meshData, i));
+	this->buildTransforms(nodes);
+	this->resident = true;
+}
+
+bool Model::readMeshes(const string& path, MeshCache& cache, vector<MeshData>& meshData, vector<ModelNode>& nodes)
+{
+	uint64_t sourceHash, sourceSize;
+	if (!MeshCache::hashFile(path, sourceHash, sourceSize))
+	{
+		cerr << "ERROR::MODEL::Can't read " << path << endl;
+		return false;
+	}
+
+	// the cooked copy is only used if it was made from exactly this source file
+	string cookedPath = MeshCache::getCookedPath(path);
+	if (cache.open(cookedPath, sourceHash, sourceSize))
+	{
+		for (unsigned i = 0; i < cache.getNodeCount(); ++i)
+			nodes.push_back(cache.getNode(i));
+		return true;
+	}
+
+	// cache miss, do the full import and cook it for next time
+	if (!import(path, meshData, nodes))
+		return false;
+	// draw what was just cooked, so the first launch uses the same vertex format as every
+	// other one. If it couldn't be written the imported floats still work.
+	if (MeshCache::write(cookedPath, sourceHash, sourceSize, meshData, nodes, MESH_DEFAULT_VERTEX_FORMAT) &&
+		cache.open(cookedPath, sourceHash, sourceSize))
+	{
+		meshData.clear();
+	}
+	return true;
+}
+
+Mesh Model::createMesh(const MeshCache& cache, vector<MeshData>& meshData, unsigned i)
+{
+	if (!cache.isOpen())
+	{
+		// the cooked copy couldn't be written, so upload the imported floats as they are
+		MeshData& data = meshData[i];
+		MeshSource source;
+		source.vertices = data.vertices.data();
+		source.vertexFormat = VERTEX_FLOAT;
+		source.vertexCount = (GLsizei)data.vertices.size();
+		source.indices = data.indices.data();
+		source.indexType = GL_UNSIGNED_INT;
+		source.indexCount = (GLsizei)data.indices.size();
+		source.positionScale = glm::vec3(1.0f);
+		source.positionOffset = glm::vec3(0.0f);
+		source.lods = data.lods.data();
+		source.lodCount = (GLsizei)data.lods.size();
+		source.bounds = data.bounds;
+
+		Mesh mesh(source, data.ambient, data.diffuse, data.specular, data.shininess);
+		mesh.node = MODEL_ROOT_NODE + 1 + data.node;
+		// GL has its own copy now
+		data = MeshData();
+		return mesh;
+	}
+
+	// GL copies the vertices and indices straight out of the mapped file
+	const CookedMeshRecord& record = cache.getMesh(i);
+	Mesh mesh(cache.getSource(i),
+		glm::vec3(record.ambient[0], record.ambient[1], record.ambient[2]),
+		glm::vec3(record.diffuse[0], record.diffuse[1], record.diffuse[2]),
+		glm::vec3(record.specular[0], record.specular[1], record.specular[2]),
+		record.shininess);
+	mesh.node = MODEL_ROOT_NODE + 1 + record.node;
+	return mesh;
+}
+
+void Model::createPlaceholder()
+{
+	// a plain grey cube, one vertex per corner is enough for something this temporary
+	vector<Vertex> vertices;
+	for (int i = 0; i < 8; ++i)
+	{
+		Vertex vertex;
+		vertex.position = glm::vec3(i & 1 ? PLACEHOLDER_EXTENT : -PLACEHOLDER_EXTENT,
+			i & 2 ? PLACEHOLDER_EXTENT : -PLACEHOLDER_EXTENT,
+			i & 4 ? PLACEHOLDER_EXTENT : -PLACEHOLDER_EXTENT);
+		vertex.normal = glm::normalize(vertex.position);
+		vertex.texCoords = glm::vec2(0.0f, 0.0f);
+		vertices.push_back(vertex);
+	}
+
+	const GLuint faces[] =
+	{
+		0, 2, 3, 0, 3, 1,	// -z
+		4, 5, 7, 4, 7, 6,	// +z
+		0, 4, 6, 0, 6, 2,	// -x
+		1, 3, 7, 1, 7, 5,	// +x
+		0, 1, 5, 0, 5, 4,	// -y
+		2, 6, 7, 2, 7, 3	// +y
+	};
+	vector<GLuint> indices(faces, faces + sizeof(faces) / sizeof(faces[0]));
+
+	glm::vec3 grey(0.5f, 0.5f, 0.5f);
+	placeholder.push_back(Mesh(vertices, indices, vector<Texture>(), grey, grey, glm::vec3(0.0f), 1.0f));
+}
+
+bool Model::cook(const string& path, VertexFormat format)
+{
+	uint64_t sourceHash, sourceSize;
+	if (!MeshCache::hashFile(path, sourceHash, sourceSize))
+	{
+		cerr << "ERROR::MODEL::Can't read " << path << endl;
+		return false;
+	}
+
+	vector<MeshData> meshData;
+	vector<ModelNode> nodes;
+	vector<string> texturePaths;
+	MeshOptimizerStats stats = MeshOptimizerStats();
+	if (!import(path, meshData, nodes, &texturePaths, &stats) ||
+		!MeshCache::write(MeshCache::getCookedPath(path), sourceHash, sourceSize, meshData, nodes, format))
+		return false;
+
+	// how much less vertex work the optimizer left, in a FIFO cache of MEASURE_CACHE_SIZE
+	printf("%s: %zu triangles, %zu -> %zu vertices, ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n",
+		path.c_str(), stats.triangles, stats.verticesBefore, stats.verticesAfter,
+		stats.getACMRBefore(), stats.getACMRAfter(), stats.getATVRBefore(), stats.getATVRAfter());
+
+	// and how far the simplifier got, meshes that ran out of levels count with their coarsest
+	for (unsigned l = 1; l < LOD_MAX_LEVELS; ++l)
+	{
+		size_t triangles = 0;
+		float error = 0.0f;
+		bool simplified = false;
+		for (size_t i = 0; i < meshData.size(); ++i)
+		{
+			simplified = simplified || l < meshData[i].lods.size();
+			const MeshLod& lod = meshData[i].lods[min((size_t)l, meshData[i].lods.size() - 1)];
+			triangles += lod.indexCount / 3;
+			error = max(error, lod.error);
+		}
+		if (!simplified)
+			break;
+		printf("  LOD %u: %zu triangles, error %g\n", l, triangles, error);
+	}
+
+	// and compress every texture the materials use, the same way loadMaterialTextures loads them
+	bool cooked = true;
+	for (size_t i = 0; i < texturePaths.size(); ++i)
+		cooked = DDSCache::cook(texturePaths[i], TEXTURE_DEFAULT) && cooked;
+	return cooked;
+}
+
+bool Model::import(const string& path, vector<MeshData>& meshData, vector<ModelNode>& nodes, vector<string>* texturePaths,
+	MeshOptimizerStats* stats)
 {
 	// import the model
+	// NOTE: changing these flags changes what gets cooked, so bump MESH_CACHE_VERSION with them
 	Assimp::Importer import;
 	const aiScene* scene = import.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_GenNormals);
 
 	if (!scene || scene->mFlags == AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
 	{
 		cerr << "ERROR::ASSIMP::" << import.GetErrorString() << endl;
-		return;
+		return false;
 	}
-	
-	// retrieve the directory path of the file
-	this->directory = path.substr(0, path.find_last_of('/'));
 
 	// process the nodes of the model
-	this->processNode(scene->mRootNode, scene);
+	processNode(scene->mRootNode, scene, meshData, nodes);
+
+	// Assimp gives every face corner its own vertex, weld them back together and put
+	// everything in the order the GPU likes best, then simplify it for the distance
+	// NOTE: this changes what gets cooked as well, so bump MESH_CACHE_VERSION with it
+	for (size_t i = 0; i < meshData.size(); ++i)
+	{
+		MeshOptimizerStats meshStats = MeshOptimizer::optimize(meshData[i]);
+		if (stats)
+			stats->add(meshStats);
+		MeshSimplifier::buildLodChain(meshData[i]);
+	}
+
+	if (texturePaths)
+	{
+		string directory = path.substr(0, path.find_last_of('/'));
+		const aiTextureType types[] = { aiTextureType_DIFFUSE, aiTextureType_SPECULAR };
+		for (GLuint i = 0; i < scene->mNumMaterials; i++)
+		{
+			for (int t = 0; t < 2; t++)
+			{
+				for (GLuint j = 0; j < scene->mMaterials[i]->GetTextureCount(types[t]); j++)
+				{
+					aiString str;
+					scene->mMaterials[i]->GetTexture(types[t], j, &str);
+					texturePaths->push_back(directory + '/' + str.C_Str());
+				}
+			}
+		}
+	}
+	return true;
 }
 
-void Model::processNode(aiNode* node, const aiScene* scene)
+void Model::processNode(aiNode* node, const aiScene* scene, vector<MeshData>& meshData, vector<ModelNode>& nodes, int parent)
 {
+	// Keep the node's transform, parents always go in before their children
+	aiVector3D scaling, position;
+	aiQuaternion rotation;
+	node->mTransformation.Decompose(scaling, rotation, position);
+
+	ModelNode modelNode;
+	modelNode.parent = parent;
+	modelNode.local = Transform(glm::vec3(position.x, position.y, position.z),
+		glm::quat(rotation.w, rotation.x, rotation.y, rotation.z), glm::vec3(scaling.x, scaling.y, scaling.z));
+	int index = (int)nodes.size();
+	nodes.push_back(modelNode);
+
 	// Process all the node's meshes (if any)
 	for (GLuint i = 0; i < node->mNumMeshes; i++)
 	{
 		aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-		this->meshes.push_back(this->processMesh(mesh, scene));
+		meshData.push_back(processMesh(mesh, scene));
+		meshData.back().node = (unsigned)index;
 	}
 
 	// Then do the same for each of its children
 	for (GLuint i = 0; i < node->mNumChildren; i++)
 	{
-		this->processNode(node->mChildren[i], scene);
+		processNode(node->mChildren[i], scene, meshData, nodes, index);
 	}
 }
 
-Mesh Model::processMesh(aiMesh* mesh, const aiScene* scene)
+MeshData Model::processMesh(aiMesh* mesh, const aiScene* scene)
 {
-	vector<Vertex> vertices;
-	vector<GLuint> indices;
-	vector<Texture> textures;
+	MeshData data;
+	vector<Vertex>& vertices = data.vertices;
+	vector<GLuint>& indices = data.indices;
 	glm::vec3 ambient, diffuse, specular;
-	float shininess;
+	float shininess = 0.0f;
+
+	vertices.reserve(mesh->mNumVertices);
+	indices.reserve(mesh->mNumFaces * 3);
 
 	// process vertices
 	for (GLuint i = 0; i < mesh->mNumVertices; ++i)
@@ -122,7 +453,8 @@ Mesh Model::processMesh(aiMesh* mesh, const aiScene* scene)
 		diffuse.x = diffuseColor.r; diffuse.y = diffuseColor.g; diffuse.z = diffuseColor.b;
 		specular.x = specularColor.r; specular.y = specularColor.g; specular.z = specularColor.b;
 		
-		// NOTE: this is not needed in this assignment, but may be later
+		// NOTE: this is not needed in this assignment, but may be later. shader.frag doesn't
+		// sample any textures yet, so the loader only streams meshes until this comes back.
 		//// diffuse maps 
 		//vector<Texture> diffuseMaps = this->loadMaterialTextures(material,
 		//	aiTextureType_DIFFUSE, "texture_diffuse");
@@ -134,7 +466,13 @@ Mesh Model::processMesh(aiMesh* mesh, const aiScene* scene)
 		//textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
 	}
 
-	return Mesh(vertices, indices, textures, ambient, diffuse, specular, shininess);
+	data.ambient = ambient;
+	data.diffuse = diffuse;
+	data.specular = specular;
+	data.shininess = shininess;
+	// the culling and LOD selection work from these
+	data.bounds = Mesh::computeBounds(vertices.data(), vertices.size());
+	return data;
 }
 
 vector<Texture> Model::loadMaterialTextures(aiMaterial* mat, aiTextureType type, string typeName)
@@ -145,56 +483,15 @@ vector<Texture> Model::loadMaterialTextures(aiMaterial* mat, aiTextureType type,
 		aiString str;
 		mat->GetTexture(type, i, &str);
 
-		// Check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-		GLboolean skip = false;
-		for (GLuint j = 0; j < textures_loaded.size(); j++)
-		{
-			if (std::strcmp(textures_loaded[j].path.C_Str(), str.C_Str()) == 0)
-			{
-				textures.push_back(textures_loaded[j]);
-				skip = true; // A texture with the same filepath has already been loaded, continue to next one. (optimization)
-				break;
-			}
-		}
+		// the cache shares textures between every model, so an image is only loaded once
+		Texture texture;
+		texture.id = TextureCache::acquire(this->directory + '/' + str.C_Str(), TEXTURE_DEFAULT, loader);
+		texture.type = typeName;
+		texture.path = str;
+		textures.push_back(texture);
 
-		// If texture hasn't been loaded already, load it
-		if (!skip)
-		{   			
-			Texture texture;
-			texture.id = textureFromFile(str.C_Str(), this->directory);
-			texture.type = typeName;
-			texture.path = str;
-			textures.push_back(texture);
-
-			// Store it as texture loaded for entire model, to ensure 
-			// we won't unneccessarily load duplicate textures.
-			this->textures_loaded.push_back(texture);  
-		}
+		// every acquire gets released when the model goes away
+		this->textures_loaded.push_back(texture);
 	}
 	return textures;
 }
-
-GLint Model::textureFromFile(const char* path, string directory)
-{
-	// generate texture ID and load texture data 
-	string filename = string(path);
-	filename = directory + '/' + filename;
-	GLuint textureID;
-	glGenTextures(1, &textureID);
-	int width, height;
-	unsigned char* image = SOIL_load_image(filename.c_str(), &width, &height, 0, SOIL_LOAD_RGB);
-
-	// assign texture to ID
-	glBindTexture(GL_TEXTURE_2D, textureID);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, image);
-	glGenerateMipmap(GL_TEXTURE_2D);
-
-	// set parameters
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glBindTexture(GL_TEXTURE_2D, 0);
-	SOIL_free_image_data(image);
-	return textureID;
-}
@@ -14,34 +14,83 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
-#include <SOIL.h>
-
 #include "mesh.h"
+#include "MeshCache.h"
+#include "TransformHierarchy.h"
+
+// the node that places the whole model in the world, the model file's own nodes hang off it
+#define MODEL_ROOT_NODE 0
 
 using namespace std;
 
+class AssetLoader;
+struct MeshOptimizerStats;
+
 class Model
 {
 public:
-	Model(GLchar* path);
-	Model() {}
+	// With a loader the model is read on a worker thread and draws a placeholder until
+	// the loader has uploaded it. Without one it's loaded right here.
+	Model(const string& path, AssetLoader* loader = NULL);
+	Model() : resident(false), loader(NULL), loadTicket(0) { buildTransforms(vector<ModelNode>()); }
 	~Model();
 
 	void draw(GLuint shaderProgram);
+	// the levels of detail of all the meshes together in model space, for drawing them as one
+	LodChain getLodChain() const;
+
+	// Moving a node moves every mesh below it, moving MODEL_ROOT_NODE moves the whole model.
+	// Nothing is recomputed until updateTransforms(), which draw() does itself.
+	TransformHierarchy& getTransforms() { return transforms; }
+	// brings the toWorld and toModel of the meshes below any node that moved up to date
+	void updateTransforms();
+
+	// the placeholder until the model is resident
+	vector<Mesh>& getMeshes() { return resident ? meshes : placeholder; }
+	const vector<Mesh>& getMeshes() const { return resident ? meshes : placeholder; }
+	bool isResident() const { return resident; }
 
-	vector<Mesh> getMeshes() { return meshes; }
+	// Imports a model with Assimp and writes its cooked copy with the given vertex format,
+	// and cooks the textures it uses, without needing a GL context
+	static bool cook(const string& path, VertexFormat format = MESH_DEFAULT_VERTEX_FORMAT);
+
+	// Everything about loading a model that doesn't need GL, so it can run on any thread.
+	// Either maps the cooked copy into cache, or imports the source into meshData and cooks it.
+	// The node tree goes into nodes either way.
+	static bool readMeshes(const string& path, MeshCache& cache, vector<MeshData>& meshData, vector<ModelNode>& nodes);
+	// Uploads mesh i of whatever readMeshes produced
+	static Mesh createMesh(const MeshCache& cache, vector<MeshData>& meshData, unsigned i);
 
 protected:
 	vector<Mesh> meshes;
-	vector<Texture> textures_loaded;
+	vector<Mesh> placeholder;
+	vector<Texture> textures_loaded;	// every texture this model acquired from the TextureCache
 	string directory;
+	bool resident;
+	TransformHierarchy transforms;
+
+	AssetLoader* loader;
+	unsigned loadTicket;	// of the request the loader is still working on, 0 if there's none
+
+	// world space boxes of the meshes and whether they're in view, refilled every draw
+	vector<glm::vec3> cullCenters, cullExtents;
+	vector<unsigned char> cullVisible;
+
+	friend class AssetLoader;
 
 	void loadModel(string path);
-	void processNode(aiNode* node, const aiScene* scene);
-	Mesh processMesh(aiMesh* mesh, const aiScene* scene);
+	void createPlaceholder();
+	// MODEL_ROOT_NODE where meshes have always been placed, and the model file's nodes below it
+	void buildTransforms(const vector<ModelNode>& nodes);
+	// Also lists the textures the materials use in texturePaths and adds up what the mesh
+	// optimizer did in stats, if they're given
+	static bool import(const string& path, vector<MeshData>& meshData, vector<ModelNode>& nodes,
+		vector<string>* texturePaths = NULL, MeshOptimizerStats* stats = NULL);
+	static void processNode(aiNode* node, const aiScene* scene, vector<MeshData>& meshData, vector<ModelNode>& nodes,
+		int parent = TRANSFORM_NO_PARENT);
+	static MeshData processMesh(aiMesh* mesh, const aiScene* scene);
 	vector<Texture> loadMaterialTextures(aiMaterial* mat, aiTextureType type,
 		string typeName);
-	GLint textureFromFile(const char* path, string directory);
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -8,6 +8,7 @@
 */
 
 #include "image_DXT.h"
+#include "image_helper.h"
 #include <math.h>
 #include <stdlib.h>
 #include <string.h>
@@ -274,6 +275,80 @@ unsigned char* convert_image_to_DXT5(
 	return compressed;
 }
 
+unsigned char* convert_image_to_DXT_mipmapped(
+		const unsigned char *const uncompressed,
+		int width, int height, int channels,
+		int *out_size, int *out_mip_count )
+{
+	unsigned char *compressed = NULL;
+	unsigned char *level = NULL, *next_level = NULL;
+	const unsigned char *source = uncompressed;
+	int total_size = 0, mip_count = 0;
+	/*	error check	*/
+	*out_size = 0;
+	*out_mip_count = 0;
+	if( (width < 1) || (height < 1) ||
+		(NULL == uncompressed) ||
+		(channels < 1) || (channels > 4) )
+	{
+		return NULL;
+	}
+	/*	the next level is never bigger than a quarter of this one	*/
+	level = (unsigned char*)malloc( width * height * channels );
+	next_level = (unsigned char*)malloc( width * height * channels );
+	if( (NULL == level) || (NULL == next_level) )
+	{
+		free( level );
+		free( next_level );
+		return NULL;
+	}
+	while( 1 )
+	{
+		/*	compress this level, odd channel counts have no alpha	*/
+		int level_size;
+		unsigned char *block_data, *grown;
+		if( (channels & 1) == 1 )
+		{
+			block_data = convert_image_to_DXT1( source, width, height, channels, &level_size );
+		} else
+		{
+			block_data = convert_image_to_DXT5( source, width, height, channels, &level_size );
+		}
+		grown = (NULL == block_data) ? NULL :
+			(unsigned char*)realloc( compressed, total_size + level_size );
+		if( NULL == grown )
+		{
+			free( block_data );
+			free( compressed );
+			compressed = NULL;
+			mip_count = total_size = 0;
+			break;
+		}
+		compressed = grown;
+		memcpy( compressed + total_size, block_data, level_size );
+		free( block_data );
+		total_size += level_size;
+		++mip_count;
+		if( (width == 1) && (height == 1) )
+		{
+			break;
+		}
+		/*	box filter down to the next level	*/
+		mipmap_image( source, width, height, channels, next_level, 2, 2 );
+		width = (width > 1) ? (width >> 1) : 1;
+		height = (height > 1) ? (height >> 1) : 1;
+		/*	swap, so the level we just made is the next source	*/
+		source = next_level;
+		next_level = level;
+		level = (unsigned char*)source;
+	}
+	free( level );
+	free( next_level );
+	*out_size = total_size;
+	*out_mip_count = mip_count;
+	return compressed;
+}
+
 /********* Helper Functions *********/
 int convert_bit_range( int c, int from_bits, int to_bits )
 {
@@ -45,6 +45,21 @@ convert_image_to_DXT5
     int *out_size
 );
 
+/**
+	take an image and convert it to DXT1 (channels 1 or 3) or DXT5
+	(channels 2 or 4) along with its whole mip chain, down to 1x1.
+	The levels are stored one after the other, largest first, and
+	each level is half the size of the one before (rounded down).
+	\return the compressed data (release it with free()), or NULL if failed
+**/
+unsigned char*
+convert_image_to_DXT_mipmapped
+(
+    const unsigned char *const uncompressed,
+    int width, int height, int channels,
+    int *out_size, int *out_mip_count
+);
+
 /**	A bunch of DirectDraw Surface structures and flags **/
 typedef struct
 {
@@ -4,6 +4,7 @@
 #include <iostream>
 #include <fstream>
 #include <algorithm>
+#include <map>
 using namespace std;
 
 #define GLFW_INCLUDE_GLEXT
@@ -15,6 +16,16 @@ using namespace std;
 #include <GLFW/glfw3.h>
 
 #include "shader.h"
+#include "UniformBuffers.h"
+
+static map<GLuint, ShaderUniforms> programUniforms;
+
+// Attaches the named uniform block to a fixed binding point, if the program uses it
+static void BindUniformBlock(GLuint ProgramID, const char * blockName, GLuint binding){
+	GLuint BlockIndex = glGetUniformBlockIndex(ProgramID, blockName);
+	if (BlockIndex != GL_INVALID_INDEX)
+		glUniformBlockBinding(ProgramID, BlockIndex, binding);
+}
 
 GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path){
 
@@ -119,5 +130,22 @@ GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path
 	glDeleteShader(VertexShaderID);
 	glDeleteShader(FragmentShaderID);
 
+	// Resolve everything the draw calls need now, so they never have to look anything up by name
+	BindUniformBlock(ProgramID, "FrameData", FRAME_BLOCK_BINDING);
+	BindUniformBlock(ProgramID, "Materials", MATERIAL_BLOCK_BINDING);
+
+	ShaderUniforms Uniforms;
+	Uniforms.model = glGetUniformLocation(ProgramID, "model");
+	Uniforms.instanced = glGetUniformLocation(ProgramID, "instanced");
+	Uniforms.materialIndex = glGetUniformLocation(ProgramID, "materialIndex");
+	Uniforms.positionScale = glGetUniformLocation(ProgramID, "positionScale");
+	Uniforms.positionOffset = glGetUniformLocation(ProgramID, "positionOffset");
+	Uniforms.octahedralNormals = glGetUniformLocation(ProgramID, "octahedralNormals");
+	programUniforms[ProgramID] = Uniforms;
+
 	return ProgramID;
+}
+
+const ShaderUniforms& GetShaderUniforms(GLuint programID){
+	return programUniforms[programID];
 }
\ No newline at end of file
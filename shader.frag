@@ -1,49 +1,61 @@
 #version 330 core
 
+// Same layout as MaterialData in UniformBuffers.h, the shininess is kept in specular.w
 struct Material
 {
-	vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;    
-    float shininess;
-};
-
-struct Light {
-    vec3 position;
-
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
+	vec4 ambient;
+    vec4 diffuse;
+    vec4 specular;
 };
 
 in vec3 FragPos;  
 in vec3 Normal;  
+flat in int Eye;
 //in vec2 TexCoords;
 
 out vec4 color;
 
+// Written once per frame, see FrameData in UniformBuffers.h
+layout (std140) uniform FrameData
+{
+    mat4 projection[2];
+    mat4 view[2];
+    vec4 lightPosition;
+    vec4 lightAmbient;
+    vec4 lightDiffuse;
+    vec4 lightSpecular;
+    vec4 viewPos[2];
+    int eyeCount;
+};
+
+// Every material in the scene, MAX_MATERIALS in UniformBuffers.h
+layout (std140) uniform Materials
+{
+    Material materials[256];
+};
+
 //uniform sampler2D texture_diffuse1;
 //uniform sampler2D texture_specular1;
-uniform vec3 viewPos;
-uniform Material material;
-uniform Light light;
+uniform int materialIndex;
 
 void main()
 {
+    Material material = materials[materialIndex];
+
 	// Ambient
-    vec3 ambient = light.ambient * material.ambient;
+    vec3 ambient = lightAmbient.xyz * material.ambient.xyz;
   	
     // Diffuse 
     vec3 norm = normalize(Normal);
-    vec3 lightDir = normalize(light.position - FragPos);
+    vec3 lightDir = normalize(lightPosition.xyz - FragPos);
     float diff = max(dot(norm, lightDir), 0.0);
-    vec3 diffuse = light.diffuse * (diff * material.diffuse);
+    vec3 diffuse = lightDiffuse.xyz * (diff * material.diffuse.xyz);
     
     // Specular
-    vec3 viewDir = normalize(viewPos - FragPos);
+    vec3 viewDir = normalize(viewPos[Eye].xyz - FragPos);
     vec3 reflectDir = reflect(-lightDir, norm);  
-    float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
-    vec3 specular = light.specular * (spec * material.specular);  
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.specular.w);
+    vec3 specular = lightSpecular.xyz * (spec * material.specular.xyz);  
         
     vec3 result = ambient + diffuse + specular;
     color = vec4(result, 1.0f);
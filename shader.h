@@ -1,6 +1,18 @@
 #ifndef SHADER_HPP
 #define SHADER_HPP
 
+// Locations of the per-draw uniforms, looked up once when the program is linked
+struct ShaderUniforms
+{
+	GLint model;
+	GLint instanced;
+	GLint materialIndex;
+	GLint positionScale;
+	GLint positionOffset;
+	GLint octahedralNormals;
+};
+
 GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path);
+const ShaderUniforms& GetShaderUniforms(GLuint programID);
 
 #endif
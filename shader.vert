@@ -1,22 +1,63 @@
 #version 330 core
 
+// Packed meshes (see PackedVertex in mesh.h) feed snorm16 positions and octahedral normals
+// in .xy through the same locations
 layout (location = 0) in vec3 position;
 layout (location = 1) in vec3 normal;
 layout (location = 2) in vec2 texCoords;
+// Per-instance toWorld matrix, takes up locations 3 to 6 (one per column). With more than one
+// eye it only advances every eyeCount instances.
+layout (location = 3) in mat4 instanceToWorld;
 
-// Uniform variables can be updated by fetching their location and passing values to that location
-uniform mat4 projection;
-uniform mat4 modelview;
+// Written once per frame, see FrameData in UniformBuffers.h
+layout (std140) uniform FrameData
+{
+    mat4 projection[2];
+    mat4 view[2];
+    vec4 lightPosition;
+    vec4 lightAmbient;
+    vec4 lightDiffuse;
+    vec4 lightSpecular;
+    vec4 viewPos[2];
+    int eyeCount;
+};
+
+// Set per draw. Instanced draws put instanceToWorld in front of it, it's only where the
+// mesh sits in its model then.
+uniform mat4 model;
+uniform bool instanced;
+// Set per mesh. Float meshes have a scale of 1 and an offset of 0.
+uniform vec3 positionScale;
+uniform vec3 positionOffset;
+uniform bool octahedralNormals;
 
 out vec3 Normal;
 out vec3 FragPos;
+flat out int Eye;
 //out vec2 TexCoords;
 
+// unfolds a normal from the octahedron it was packed onto, the inverse of Mesh::packVertex
+vec3 decodeOctahedral(vec2 e)
+{
+    vec3 n = vec3(e, 1.0f - abs(e.x) - abs(e.y));
+    if (n.z < 0.0f)
+        n.xy = (1.0f - abs(n.yx)) * vec2(n.x >= 0.0f ? 1.0f : -1.0f, n.y >= 0.0f ? 1.0f : -1.0f);
+    return normalize(n);
+}
+
 void main()
 {
+    // every draw has an instance per eye, both eyes go into one side by side target
+    int eye = gl_InstanceID % eyeCount;
+    mat4 modelview = view[eye] * (instanced ? instanceToWorld * model : model);
+    vec3 objectPos = position * positionScale + positionOffset;
+
     // OpenGL maintains the D matrix so you only need to multiply by P, V (aka C inverse), and M
-    gl_Position = projection * modelview * vec4(position, 1.0f);
-	Normal = normal;
-	FragPos = vec3(modelview * vec4(position, 1.0f));
+    gl_Position = projection[eye] * modelview * vec4(objectPos, 1.0f);
+    // each eye's projection is already squeezed into its half, this keeps it from spilling into the other
+    gl_ClipDistance[0] = eyeCount == 1 ? 1.0f : (eye == 0 ? -gl_Position.x : gl_Position.x);
+    Eye = eye;
+	Normal = octahedralNormals ? decodeOctahedral(normal.xy) : normal;
+	FragPos = vec3(modelview * vec4(objectPos, 1.0f));
 	//TexCoords = texCoords;
 }